@@ -0,0 +1,200 @@
+#include "ClientAccount.h"
+#include "ClientBrain.h"
+#include "ClientBroker.h"
+#include "ClientData.h"
+#include "HalvedPositionSMA.h"
+#include "ReplayDriver.h"
+#include "SMA.h"
+#include "WorkPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <sstream>
+
+using namespace std;
+using namespace ClientSpace;
+
+/// Interval of the harvested bars replayed by default
+constexpr const char* BACKTEST_INTERVAL = "1min";
+/// Cash every parameter set starts with
+constexpr double BACKTEST_CASH = 100000;
+/// Rows of the ranked table printed to the console, the file gets all of them
+constexpr size_t BACKTEST_TOP = 20;
+/// Default grid, the lengths the Trader runs with lie inside it
+constexpr const char* FAST_RANGE = "5:100:5";
+constexpr const char* SLOW_RANGE = "100:500:25";
+
+bool inter = false;
+
+/// Orders of the strategy step a worker is running
+thread_local vector<pair<Contract, Order>> trades;
+
+/// The trading part of the Trader state machine, everything else is replayed
+void ClientBrain::processState()
+{
+    switch( *p_State )
+    {
+        case TRADING:
+            Strategy->ProcessNextTick( static_pointer_cast<BTAccount>( Account ),
+                                       static_pointer_cast<BTBroker>( Broker ), Data,
+                                       trades );
+            *p_State = trades.empty() ? DATA_NEXT : ORDERING;
+            break;
+
+        case ORDERING:
+            for( auto& trade : trades )
+            {
+                Broker->placeOrder( trade );
+            }
+            trades.clear();
+            *p_State = DATA_NEXT;
+            break;
+
+        case DATA_NEXT:
+            if( scheduler.due( *Data ) )
+            {
+                *p_State = TRADING;
+            }
+            break;
+
+        default:
+            *p_State = DATA_NEXT;
+            break;
+    }
+}
+
+/// One point of the parameter grid and how it did
+struct SweepResult
+{
+    int    fast;
+    int    slow;
+    double equity;
+    size_t fills;
+};
+
+/// Parses "from:to:step" into the lengths it covers, both ends included
+vector<int> lengths( const string& range )
+{
+    auto out = vector<int>();
+    int  from = 0;
+    int  to = 0;
+    int  step = 1;
+    char sep = 0;
+    auto fields = istringstream( range );
+    fields >> from >> sep >> to >> sep >> step;
+    if( fields.fail() || from < 1 || to < from || step < 1 )
+    {
+        spdlog::critical( "Could not read the range " + range + ", expected from:to:step" );
+        return out;
+    }
+    for( int length = from; length <= to; length += step )
+    {
+        out.push_back( length );
+    }
+    return out;
+}
+
+/// Replays the shared tape through an HPSMA strategy with its own indicators, account and broker
+SweepResult evaluate( const shared_ptr<const vector<JournalRecord>>& tape, const EvalScheduler& scheduler,
+                      int fast, int slow )
+{
+    auto SMAF = make_unique<SMA>( fast );
+    auto SMAS = make_unique<SMA>( slow );
+    auto indicators = vector<BTIndicator*> { SMAF.get(), SMAS.get() };
+    auto Data = make_shared<ClientData>( indicators );
+    auto client = ClientBrain( Data, make_shared<HPSMA>() );
+    client.evaluate( scheduler );
+    auto driver = ReplayDriver( client );
+    driver.load( tape );
+    driver.setCash( BACKTEST_CASH );
+    driver.run( [&client]() { client.processState(); } );
+    return SweepResult { fast, slow, driver.equity(), driver.fills };
+}
+
+/// Usage: Backtest <history root> [interval] [fast from:to:step] [slow from:to:step] [threads] [eval mode]
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        spdlog::critical( "Usage: Backtest <history root> [interval] [fast from:to:step] "
+                          "[slow from:to:step] [threads] [eval mode]" );
+        return 1;
+    }
+    string root = argv[1];
+    string interval = argc > 2 ? argv[2] : BACKTEST_INTERVAL;
+    auto   fastLengths = lengths( argc > 3 ? argv[3] : FAST_RANGE );
+    auto   slowLengths = lengths( argc > 4 ? argv[4] : SLOW_RANGE );
+    auto   pool = WorkPool( argc > 5 ? (unsigned)stoul( argv[5] ) : 0 );
+    auto   scheduler = EvalScheduler();
+    if( argc > 6 && !EvalScheduler::parse( argv[6], scheduler ) )
+    {
+        spdlog::critical( "Unknown evaluation mode " + string( argv[6] ) +
+                          ", expected tick, bar:<seconds>, timer:<ms> or coalesce:<ms>" );
+        return 1;
+    }
+
+    auto grid = vector<pair<int, int>>();
+    for( int fast : fastLengths )
+    {
+        for( int slow : slowLengths )
+        {
+            if( fast < slow )
+            {
+                grid.emplace_back( fast, slow );
+            }
+        }
+    }
+    if( grid.empty() )
+    {
+        spdlog::critical( "The parameter grid is empty" );
+        return 1;
+    }
+
+    // the history is read and sorted once, every worker replays the same tape
+    auto indicators = vector<BTIndicator*>();
+    auto loader = ClientBrain( make_shared<ClientData>( indicators ), make_shared<HPSMA>() );
+    auto tape = shared_ptr<const vector<JournalRecord>>();
+    {
+        auto driver = ReplayDriver( loader );
+        if( !driver.loadHistory( root, interval ) )
+        {
+            spdlog::critical( "No " + interval + " bars to replay in " + root );
+            return 1;
+        }
+        tape = driver.tape();
+    }
+    spdlog::info( "Sweeping " + to_string( grid.size() ) + " parameter sets over " +
+                  to_string( tape->size() ) + " records on " + to_string( pool.size() ) + " threads" );
+
+    // the callbacks log every order, which would drown out the sweep
+    spdlog::set_level( spdlog::level::err );
+    auto results = vector<SweepResult>( grid.size() );
+    auto start = chrono::steady_clock::now();
+    pool.run( grid.size(), [&]( size_t task, unsigned ) {
+        results[task] = evaluate( tape, scheduler, grid[task].first, grid[task].second );
+    } );
+    auto seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    spdlog::set_level( spdlog::level::info );
+
+    sort( results.begin(), results.end(),
+          []( const SweepResult& a, const SweepResult& b ) { return a.equity > b.equity; } );
+    auto path = "backtest_" + interval + ".csv";
+    auto table = ofstream( path );
+    table << "rank,fast,slow,equity,return,fills\n";
+    printf( "%6s %6s %6s %14s %9s %8s\n", "rank", "fast", "slow", "equity", "return", "fills" );
+    for( size_t i = 0; i < results.size(); i++ )
+    {
+        const auto& r = results[i];
+        double      ret = ( r.equity / BACKTEST_CASH - 1 ) * 100;
+        table << i + 1 << "," << r.fast << "," << r.slow << "," << r.equity << "," << ret << "," << r.fills << "\n";
+        if( i < BACKTEST_TOP )
+        {
+            printf( "%6zu %6d %6d %14.2f %8.2f%% %8zu\n", i + 1, r.fast, r.slow, r.equity, ret, r.fills );
+        }
+    }
+    spdlog::info( "Swept " + to_string( results.size() ) + " parameter sets in " + to_string( seconds ) +
+                  " s, full table in " + path );
+    return 0;
+}
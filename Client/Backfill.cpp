@@ -0,0 +1,344 @@
+#include "Backfill.h"
+#include "EClientSocket.h"
+#include <spdlog/spdlog.h>
+
+using namespace std;
+using namespace ClientSpace;
+
+namespace
+{
+    /// Bars of 30 seconds or less fall under the 60 requests per 10 minutes rule
+    bool smallBar( const string& barSize )
+    {
+        return barSize.find( "sec" ) != string::npos;
+    }
+
+    string requestKey( const HistRequest& req )
+    {
+        return to_string( req.contract.conId ) + req.contract.symbol + "|" + req.duration +
+               "|" + req.barSize + "|" + req.whatToShow + "|" + req.endDateTime;
+    }
+} // namespace
+
+PacingBudget::Clock::duration PacingBudget::wait( const HistRequest& req,
+                                                  Clock::time_point now ) const
+{
+    auto longest = Clock::duration::zero();
+    auto ident = identical.find( requestKey( req ) );
+    if( ident != identical.end() )
+    {
+        longest = max( longest, ident->second + chrono::seconds( PACING_IDENTICAL_WINDOW ) - now );
+    }
+    auto con = contracts.find( req.contract.conId );
+    if( con != contracts.end() && (int)con->second.size() >= PACING_CONTRACT_REQUESTS )
+    {
+        auto oldest = con->second[con->second.size() - PACING_CONTRACT_REQUESTS];
+        longest = max( longest, oldest + chrono::seconds( PACING_CONTRACT_WINDOW ) - now );
+    }
+    if( smallBar( req.barSize ) && (int)smallBars.size() >= PACING_SMALL_BAR_REQUESTS )
+    {
+        auto oldest = smallBars[smallBars.size() - PACING_SMALL_BAR_REQUESTS];
+        longest = max( longest, oldest + chrono::seconds( PACING_SMALL_BAR_WINDOW ) - now );
+    }
+    return longest;
+}
+
+void PacingBudget::acquire( const HistRequest& req )
+{
+    unique_lock<mutex> guard( lock );
+    for( ;; )
+    {
+        auto now = Clock::now();
+        auto delay = wait( req, now );
+        if( delay <= Clock::duration::zero() )
+        {
+            identical[requestKey( req )] = now;
+            auto& con = contracts[req.contract.conId];
+            con.push_back( now );
+            while( con.size() > PACING_CONTRACT_REQUESTS )
+            {
+                con.pop_front();
+            }
+            if( smallBar( req.barSize ) )
+            {
+                smallBars.push_back( now );
+                while( smallBars.size() > PACING_SMALL_BAR_REQUESTS )
+                {
+                    smallBars.pop_front();
+                }
+            }
+            return;
+        }
+        // other connections may book requests for other contracts meanwhile
+        guard.unlock();
+        this_thread::sleep_for( delay );
+        guard.lock();
+    }
+}
+
+BackfillConnection::BackfillConnection()
+    : nextReqId( 1 ), running( false ), ready( false )
+{
+    requests = map<long, HistRequest>();
+    results = map<long, vector<Bar>>();
+    failed = set<long>();
+    pending = set<long>();
+}
+
+BackfillConnection::~BackfillConnection() { close(); }
+
+bool BackfillConnection::open( const char* host, int port, int clientId )
+{
+    if( !p_Client->eConnect( host, port, clientId, *p_ExtraAuth ) )
+    {
+        spdlog::error( "Backfill connection with clientID " + to_string( clientId ) +
+                       " could not connect" );
+        return false;
+    }
+    p_Reader = make_shared<EReader>( p_Client.get(), &m_osSignal );
+    p_Reader->start();
+    running = true;
+    reader = thread( &BackfillConnection::readLoop, this );
+    // requests are only accepted after TWS hands out the next valid order id
+    unique_lock<mutex> guard( lock );
+    changed.wait_for( guard, chrono::seconds( 10 ), [this] { return ready.load(); } );
+    if( !ready )
+    {
+        spdlog::error( "Backfill connection with clientID " + to_string( clientId ) +
+                       " never became ready" );
+    }
+    return ready;
+}
+
+void BackfillConnection::close()
+{
+    running = false;
+    if( reader.joinable() )
+    {
+        reader.join();
+    }
+    if( p_Client->isConnected() )
+    {
+        p_Client->eDisconnect();
+    }
+}
+
+void BackfillConnection::readLoop()
+{
+    while( running && p_Client->isConnected() )
+    {
+        m_osSignal.waitForSignal();
+        errno = 0;
+        p_Reader->processMsgs();
+    }
+}
+
+long BackfillConnection::request( HistRequest& req )
+{
+    long reqId;
+    {
+        lock_guard<mutex> guard( lock );
+        reqId = nextReqId++;
+        requests[reqId] = req;
+        results[reqId] = vector<Bar>();
+        pending.insert( reqId );
+    }
+    p_Client->reqHistoricalData( reqId, req.contract, req.endDateTime, req.duration,
+                                 req.barSize, req.whatToShow, 1, 1, false,
+                                 TagValueListSPtr() );
+    return reqId;
+}
+
+bool BackfillConnection::waitOpen( size_t limit, chrono::seconds timeout )
+{
+    unique_lock<mutex> guard( lock );
+    return changed.wait_for( guard, timeout, [this, limit] {
+        return pending.size() < limit || !p_Client->isConnected();
+    } );
+}
+
+size_t BackfillConnection::abandon()
+{
+    lock_guard<mutex> guard( lock );
+    auto              count = pending.size();
+    failed.insert( pending.begin(), pending.end() );
+    pending.clear();
+    return count;
+}
+
+void BackfillConnection::finish( long reqId )
+{
+    {
+        lock_guard<mutex> guard( lock );
+        pending.erase( reqId );
+    }
+    changed.notify_all();
+}
+
+void BackfillConnection::historicalData( TickerId reqId, const Bar& bar )
+{
+    lock_guard<mutex> guard( lock );
+    auto              entry = results.find( reqId );
+    if( entry != results.end() )
+    {
+        entry->second.push_back( bar );
+    }
+}
+
+void BackfillConnection::historicalDataEnd( int reqId, const std::string& startDateStr,
+                                            const std::string& endDateStr )
+{
+    finish( reqId );
+}
+
+void BackfillConnection::error( int id, int errorCode, const std::string& errorString )
+{
+    bool isRequest;
+    {
+        lock_guard<mutex> guard( lock );
+        isRequest = pending.find( id ) != pending.end();
+        if( isRequest )
+        {
+            failed.insert( id );
+        }
+    }
+    if( isRequest )
+    {
+        spdlog::warn( "Backfill request " + to_string( id ) + " failed with code " +
+                      to_string( errorCode ) + ": " + errorString );
+        finish( id );
+    }
+    else if( errorCode == 504 )
+    {
+        changed.notify_all();
+    }
+}
+
+void BackfillConnection::nextValidId( OrderId orderId )
+{
+    ready = true;
+    changed.notify_all();
+}
+
+void BackfillConnection::connectAck()
+{
+    if( !*p_ExtraAuth && p_Client->asyncEConnect() )
+    {
+        p_Client->startApi();
+    }
+}
+
+void BackfillConnection::connectionClosed()
+{
+    running = false;
+    changed.notify_all();
+}
+
+BackfillCoordinator::BackfillCoordinator( string host, int port, int firstClientId,
+                                          int connectionCount )
+    : host( move( host ) ), port( port ), firstClientId( firstClientId )
+{
+    for( int i = 0; i < connectionCount; i++ )
+    {
+        connections.push_back( make_unique<BackfillConnection>() );
+    }
+}
+
+bool BackfillCoordinator::next( HistRequest& req )
+{
+    lock_guard<mutex> guard( queueLock );
+    if( queue.empty() )
+    {
+        return false;
+    }
+    req = queue.front();
+    queue.pop_front();
+    return true;
+}
+
+void BackfillCoordinator::dispatch( BackfillConnection& con )
+{
+    HistRequest req;
+    while( next( req ) )
+    {
+        if( !con.waitOpen( BACKFILL_OPEN_PER_CONNECTION, chrono::seconds( BACKFILL_TIMEOUT ) ) ||
+            !con.isConnected() )
+        {
+            // give the request back to the connections that are still healthy
+            {
+                lock_guard<mutex> guard( queueLock );
+                queue.push_front( req );
+            }
+            abandon( con );
+            return;
+        }
+        pacing.acquire( req );
+        con.request( req );
+    }
+    con.waitOpen( 1, chrono::seconds( BACKFILL_TIMEOUT ) );
+    abandon( con );
+}
+
+void BackfillCoordinator::abandon( BackfillConnection& con )
+{
+    // a request without its end never covered its window, the catalog must not record it
+    auto count = con.abandon();
+    if( count > 0 )
+    {
+        spdlog::error( to_string( count ) + " backfill requests were not answered in time" );
+    }
+}
+
+size_t BackfillCoordinator::run( const vector<HistRequest>& plan )
+{
+    queue = deque<HistRequest>( plan.begin(), plan.end() );
+    auto start = chrono::steady_clock::now();
+    auto workers = vector<thread>();
+    for( size_t i = 0; i < connections.size(); i++ )
+    {
+        auto& con = *connections[i];
+        if( !con.open( host.c_str(), port, firstClientId + (int)i ) )
+        {
+            continue;
+        }
+        workers.emplace_back( &BackfillCoordinator::dispatch, this, ref( con ) );
+    }
+    for( auto& worker : workers )
+    {
+        worker.join();
+    }
+    size_t answered = 0;
+    for( auto& con : connections )
+    {
+        con->close();
+        for( const auto& entry : con->requests )
+        {
+            answered += con->failed.find( entry.first ) == con->failed.end() ? 1 : 0;
+        }
+    }
+    auto elapsed = chrono::duration_cast<chrono::seconds>( chrono::steady_clock::now() - start );
+    spdlog::info( "Backfill answered " + to_string( answered ) + " of " +
+                  to_string( plan.size() ) + " requests over " + to_string( workers.size() ) +
+                  " connections in " + to_string( elapsed.count() ) + " seconds" );
+    if( !queue.empty() )
+    {
+        spdlog::error( to_string( queue.size() ) + " backfill requests were never sent" );
+    }
+    return answered;
+}
+
+void BackfillCoordinator::merge( ClientData& data )
+{
+    for( auto& con : connections )
+    {
+        for( auto& entry : con->requests )
+        {
+            if( con->failed.find( entry.first ) != con->failed.end() )
+            {
+                continue;
+            }
+            data.addHistory( entry.second, con->results[entry.first] );
+        }
+        con->results.clear();
+    }
+}
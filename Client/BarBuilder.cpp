@@ -0,0 +1,111 @@
+#include "BarBuilder.h"
+#include <algorithm>
+
+using namespace std;
+
+constexpr int64_t NS_PER_SECOND = 1000000000;
+
+/// IB tick types the builder listens to
+constexpr int TICK_BID = 1;
+constexpr int TICK_ASK = 2;
+constexpr int TICK_LAST = 4;
+constexpr int TICK_LAST_SIZE = 5;
+
+BarBuilder::BarBuilder( const vector<int>& newSeconds, BarSource newSource )
+{
+    seconds = vector<int>();
+    spans = vector<int64_t>();
+    for( int length : newSeconds )
+    {
+        if( length > 0 )
+        {
+            seconds.push_back( length );
+            spans.push_back( (int64_t)length * NS_PER_SECOND );
+        }
+    }
+    bars = vector<StreamBar>( seconds.size(), StreamBar { 0, 0, 0, 0, 0, 0, false } );
+    source = newSource;
+    bid = 0;
+    ask = 0;
+}
+
+void BarBuilder::tick( int64_t time, int field, double value, vector<ClosedBar>& closed )
+{
+    roll( time, closed );
+    switch( field )
+    {
+        case TICK_BID:
+        case TICK_ASK:
+            ( field == TICK_BID ? bid : ask ) = value;
+            if( source == BarSource::Midpoint && bid > 0 && ask > 0 )
+            {
+                price( time, ( bid + ask ) / 2 );
+            }
+            break;
+        case TICK_LAST:
+            if( source == BarSource::Trades )
+            {
+                price( time, value );
+            }
+            break;
+        case TICK_LAST_SIZE:
+            for( auto& bar : bars )
+            {
+                if( bar.active )
+                {
+                    bar.volume += (int64_t)value;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void BarBuilder::advance( int64_t time, vector<ClosedBar>& closed ) { roll( time, closed ); }
+
+const StreamBar& BarBuilder::current( size_t length ) const { return bars[length]; }
+
+const vector<int>& BarBuilder::lengths() const { return seconds; }
+
+string BarBuilder::interval( int length )
+{
+    if( length % 3600 == 0 )
+    {
+        return to_string( length / 3600 ) + ( length == 3600 ? "hour" : "hours" );
+    }
+    if( length % 60 == 0 )
+    {
+        return to_string( length / 60 ) + ( length == 60 ? "min" : "mins" );
+    }
+    return to_string( length ) + "secs";
+}
+
+void BarBuilder::roll( int64_t time, vector<ClosedBar>& closed )
+{
+    for( size_t i = 0; i < bars.size(); i++ )
+    {
+        auto& bar = bars[i];
+        if( bar.active && time >= bar.start + spans[i] )
+        {
+            closed.push_back( ClosedBar { i, bar } );
+            bar.active = false;
+        }
+    }
+}
+
+void BarBuilder::price( int64_t time, double value )
+{
+    for( size_t i = 0; i < bars.size(); i++ )
+    {
+        auto& bar = bars[i];
+        if( !bar.active )
+        {
+            bar = StreamBar { time - time % spans[i], value, value, value, value, 0, true };
+            continue;
+        }
+        bar.high = max( bar.high, value );
+        bar.low = min( bar.low, value );
+        bar.close = value;
+    }
+}
@@ -21,6 +21,7 @@
 #include "Order.h"
 #include "OrderSamples.h"
 #include "OrderState.h"
+#include "OutboundScheduler.h"
 #include "PercentChangeCondition.h"
 #include "PriceCondition.h"
 #include "ScannerSubscription.h"
@@ -63,7 +64,8 @@ namespace ClientSpace
  */
     Client::Client()
         : m_osSignal( 2000 ), p_Client( make_shared<EClientSocket>( this, &m_osSignal ) ),
-          p_State( make_shared<State>( CONNECT ) ), m_sleepDeadline( 0 ),
+          p_State( make_shared<State>( CONNECT ) ), p_Outbound( make_shared<OutboundScheduler>() ),
+          m_sleepDeadline( 0 ),
           p_OrderId( make_shared<OrderId>( 0 ) ), p_Reader( nullptr ),
           p_ExtraAuth( make_shared<bool>( false ) ) {}
 
@@ -2,8 +2,8 @@
 #include "AccountSummaryTags.h"
 #include "ContractSamples.h"
 #include "EClientSocket.h"
+#include "OutboundScheduler.h"
 #include <spdlog/spdlog.h>
-#include <thread>
 
 using namespace std;
 using namespace ClientSpace;
@@ -14,6 +14,7 @@ ClientAccount::ClientAccount()
     accReqId = 9001;
     accountID = "";
     accountCurrency = "";
+    pnlEngine = PnLEngine();
 }
 
 ClientAccount::ClientAccount( double                           startingCash,
@@ -27,22 +28,30 @@ ClientAccount::ClientAccount( double                           startingCash,
     accountID = "";
     accountCurrency = "";
     valid = false;
+    pnlEngine = PnLEngine();
 }
 
 void ClientAccount::init()
 {
-    p_Client->reqAccountSummary( accReqId, "All",
-                                 AccountSummaryTags::getAllTags() );
-    std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
-    p_Client->reqAccountUpdates( true, accountID );
-    std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    p_Outbound->send( OutboundLane::MarketData, [client = p_Client, reqId = accReqId]() {
+        client->reqAccountSummary( (int)reqId, "All", AccountSummaryTags::getAllTags() );
+    } );
+    p_Outbound->send( OutboundLane::MarketData,
+                      [client = p_Client, account = accountID]() { client->reqAccountUpdates( true, account ); } );
 }
 
 void ClientAccount::closeSubscriptions()
 {
     *p_State = ACCOUNTCLOSE;
-    p_Client->cancelAccountSummary( accReqId );
-    p_Client->reqAccountUpdates( false, accountID );
+    p_Outbound->send( OutboundLane::MarketData,
+                      [client = p_Client, reqId = accReqId]() { client->cancelAccountSummary( (int)reqId ); } );
+    p_Outbound->send( OutboundLane::MarketData,
+                      [client = p_Client, account = accountID]() { client->reqAccountUpdates( false, account ); } );
+    for( auto reqId : pnlEngine.watches() )
+    {
+        p_Outbound->send( OutboundLane::MarketData,
+                          [client = p_Client, reqId]() { client->cancelPnLSingle( (int)reqId ); } );
+    }
     *p_State = ACCOUNTCLOSESUCCESS;
 }
 
@@ -53,4 +62,25 @@ void ClientAccount::addClient( std::shared_ptr<EClientSocket> newClient )
 void ClientAccount::addState( std::shared_ptr<ClientSpace::State> newState )
 {
     p_State = move( newState );
-}
\ No newline at end of file
+}
+void ClientAccount::addOutbound( shared_ptr<OutboundScheduler> newOutbound ) { p_Outbound = move( newOutbound ); }
+
+PnLEngine& ClientAccount::pnl() { return pnlEngine; }
+
+void ClientAccount::trackPnL( int slot, const Contract& con, long reqId )
+{
+    if( pnlEngine.watched( slot ) || con.conId == 0 )
+    {
+        return;
+    }
+    pnlEngine.watch( reqId, slot );
+    p_Outbound->send( OutboundLane::MarketData, [client = p_Client, reqId, account = accountID, conId = con.conId]() {
+        client->reqPnLSingle( (int)reqId, account, "", conId );
+    } );
+}
+
+void ClientAccount::sync()
+{
+    PnL = pnlEngine.realized();
+    UPnL = pnlEngine.unrealized();
+}
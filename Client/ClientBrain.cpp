@@ -2,11 +2,19 @@
 #include "AccountSummaryTags.h"
 #include "ClientAccount.h"
 #include "ClientBroker.h"
+#include "ClientClock.h"
 #include "ClientData.h"
+#include "CommissionReport.h"
 #include "Contract.h"
 #include "ContractSamples.h"
+#include "DataArray.h"
 #include "EClientSocket.h"
 #include "Execution.h"
+#include "FlightRecorder.h"
+#include "HistoryStore.h"
+#include "Journal.h"
+#include "Metrics.h"
+#include "OutboundScheduler.h"
 #include "Order.h"
 #include "OrderState.h"
 #include "Strategy.h"
@@ -18,6 +26,10 @@
 using namespace std;
 using namespace ClientSpace;
 
+/// Upper bounds of the main loop time buckets in nanoseconds, a live pass sleeps MAINLOOPDELAY
+constexpr int64_t LOOP_TIME_BOUNDS[] = { 100000,    1000000,   10000000,   50000000,   100000000,  150000000,
+                                         250000000, 500000000, 1000000000, 2500000000, 5000000000 };
+
 ClientBrain::ClientBrain()
     : Account( make_shared<ClientAccount>( 0, p_Client, p_State ) ),
       Data( make_shared<ClientData>( p_Client, p_State ) ),
@@ -25,6 +37,11 @@ ClientBrain::ClientBrain()
 {
     Strategy = make_shared<BTStrategy>();
     reqId = 10000;
+    Data->addOutbound( p_Outbound );
+    Account->addOutbound( p_Outbound );
+    Broker->addOutbound( p_Outbound );
+    Broker->risk().portfolio( &Account->pnl() );
+    initMetrics();
 }
 
 ClientBrain::ClientBrain( shared_ptr<BTStrategy> newStrategy )
@@ -34,6 +51,11 @@ ClientBrain::ClientBrain( shared_ptr<BTStrategy> newStrategy )
 {
     Strategy = move( newStrategy );
     reqId = 10000;
+    Data->addOutbound( p_Outbound );
+    Account->addOutbound( p_Outbound );
+    Broker->addOutbound( p_Outbound );
+    Broker->risk().portfolio( &Account->pnl() );
+    initMetrics();
 }
 
 ClientBrain::ClientBrain( shared_ptr<ClientData>        newData,
@@ -46,6 +68,11 @@ ClientBrain::ClientBrain( shared_ptr<ClientData>        newData,
     Data = move( newData );
     Data->addClient( p_Client );
     Data->addState( p_State );
+    Data->addOutbound( p_Outbound );
+    Account->addOutbound( p_Outbound );
+    Broker->addOutbound( p_Outbound );
+    Broker->risk().portfolio( &Account->pnl() );
+    initMetrics();
 }
 
 ClientBrain::ClientBrain( const shared_ptr<ClientAccount>& newAccount,
@@ -60,10 +87,100 @@ ClientBrain::ClientBrain( const shared_ptr<ClientAccount>& newAccount,
     Data->addClient( p_Client );
     Data->addState( p_State );
     Strategy = newStrategy;
+    Data->addOutbound( p_Outbound );
+    Account->addOutbound( p_Outbound );
+    Broker->addOutbound( p_Outbound );
+    Broker->risk().portfolio( &Account->pnl() );
+    initMetrics();
 }
 
 long ClientBrain::getNextReqId() { return reqId++; }
 
+const StateTimer& ClientBrain::stateTimes() const { return stateTimer; }
+
+void ClientBrain::initMetrics()
+{
+    auto& metrics = Metrics::global();
+    reconnects = &metrics.counter( "tradebot_reconnects_total", "Connections made after the first" );
+    histRequests = &metrics.gauge( "tradebot_open_hist_requests", "Historical data requests waiting on TWS" );
+    dataLines = &metrics.gauge( "tradebot_open_data_lines", "Market data lines open" );
+    pendingOrders = &metrics.gauge( "tradebot_pending_orders", "Orders sent but not yet accepted" );
+    openOrders = &metrics.gauge( "tradebot_open_orders", "Orders accepted and working" );
+    realizedPnL = &metrics.gauge( "tradebot_realized_pnl", "Realized PnL of the account, net of commissions" );
+    unrealizedPnL = &metrics.gauge( "tradebot_unrealized_pnl", "Unrealized PnL of the account at the latest marks" );
+    grossExposure = &metrics.gauge( "tradebot_gross_exposure", "Sum of the absolute market values of the positions" );
+    netExposure = &metrics.gauge( "tradebot_net_exposure", "Sum of the signed market values of the positions" );
+    loopTime = &metrics.histogram( "tradebot_loop_seconds", "Time between two passes of the main loop",
+                                   vector<int64_t>( begin( LOOP_TIME_BOUNDS ), end( LOOP_TIME_BOUNDS ) ), "",
+                                   1e-9 );
+    stateEntries.fill( nullptr );
+    stateTime.fill( nullptr );
+    lastPass = 0;
+    connects = 0;
+    dropped = ClientClock::now();
+}
+
+MetricCounter& ClientBrain::stateCounter( array<MetricCounter*, STATE_COUNT>& counters, const string& name,
+                                          const string& help, State state, double scale )
+{
+    if( counters[state] == nullptr )
+    {
+        counters[state] =
+            &Metrics::global().counter( name, help, "state=\"" + string( stateName( state ) ) + "\"", scale );
+    }
+    return *counters[state];
+}
+
+void ClientBrain::idle( int ms )
+{
+    auto until = chrono::steady_clock::now() + chrono::milliseconds( ms );
+    while( true )
+    {
+        p_Outbound->pump();
+        auto left = until - chrono::steady_clock::now();
+        if( left <= chrono::nanoseconds( 0 ) )
+        {
+            return;
+        }
+        auto due = p_Outbound->due();
+        this_thread::sleep_for( due < 0 ? left : min<chrono::steady_clock::duration>( left, chrono::nanoseconds( due ) ) );
+    }
+}
+
+void ClientBrain::beginPass()
+{
+    p_Outbound->pump();
+    auto left = stateTimer.current();
+    auto spent = stateTimer.time( left );
+    auto entered = stateTimer.entries( *p_State );
+    stateTimer.observe( *p_State, ClientClock::now() );
+    if( stateTimer.time( left ) != spent )
+    {
+        stateCounter( stateTime, "tradebot_state_seconds_total", "Time spent in each state", left, 1e-9 )
+            .add( (uint64_t)( stateTimer.time( left ) - spent ) );
+    }
+    if( stateTimer.entries( *p_State ) != entered )
+    {
+        FlightRecorder::record( FlightEvent::State, left, *p_State );
+        stateCounter( stateEntries, "tradebot_state_entries_total", "Times each state was entered", *p_State, 1 )
+            .add();
+    }
+    auto now = chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+    if( lastPass != 0 )
+    {
+        loopTime->observe( now - lastPass );
+    }
+    lastPass = now;
+    histRequests->set( (int64_t)Data->openHistRequests.size() );
+    dataLines->set( (int64_t)Data->openDataLines.size() );
+    pendingOrders->set( (int64_t)Broker->pendingOrders.size() );
+    realizedPnL->set( (int64_t)Account->pnl().realized() );
+    unrealizedPnL->set( (int64_t)Account->pnl().unrealized() );
+    grossExposure->set( (int64_t)Account->pnl().gross() );
+    netExposure->set( (int64_t)Account->pnl().net() );
+    openOrders->set( (int64_t)Broker->openOrders.size() );
+}
+
 void ClientBrain::setConnectOptions( const std::string& connectOptions )
 {
     p_Client->setConnectOptions( connectOptions );
@@ -75,9 +192,40 @@ void ClientBrain::init()
     Data->init();
 }
 
+void ClientBrain::record( shared_ptr<Journal> newJournal )
+{
+    journal = move( newJournal );
+    if( !journal )
+    {
+        return;
+    }
+    // a replay needs the lines before it can place their ticks
+    for( const auto& vec : Data->DataArrays )
+    {
+        if( Data->openDataLines.find( vec->vectorId ) != Data->openDataLines.end() )
+        {
+            journal->line( vec->vectorId, vec->contract );
+        }
+    }
+}
+
+void ClientBrain::evaluate( const EvalScheduler& newScheduler )
+{
+    scheduler = newScheduler;
+    if( scheduler.mode() == EvalMode::BarClose )
+    {
+        // bars of the length are only built for the lines opened after this
+        Data->streamBar( scheduler.interval() );
+    }
+}
+
 bool ClientBrain::connect( const char* host, int port, int clientId )
 {
     clientID = clientId;
+    if( connects++ > 0 )
+    {
+        reconnects->add();
+    }
     *p_State = CONNECT;
     string hostName = !( ( host != nullptr ) && ( *host ) != 0 ) ? "127.0.0.1" : host;
     spdlog::info( "Connecting to " + hostName + ": " + to_string( port ) +
@@ -91,6 +239,15 @@ bool ClientBrain::connect( const char* host, int port, int clientId )
         p_Reader = make_shared<EReader>( p_Client.get(), &m_osSignal );
         p_Reader->start();
         *p_State = CONNECTSUCCESS;
+        if( connects > 1 )
+        {
+            // executions are streamed, the ones made while disconnected have to be asked for.
+            // Earlier ones were booked already or are in the positions TWS reports
+            auto filter = ExecutionFilter();
+            filter.m_clientId = clientId;
+            filter.m_time = HistoryStore::utcTimeString( dropped );
+            Broker->requestExecutions( getNextReqId(), filter );
+        }
     }
     else
     {
@@ -115,6 +272,8 @@ bool ClientBrain::isConnected() const { return p_Client->isConnected(); }
 
 void ClientBrain::connectionClosed()
 {
+    FlightRecorder::record( FlightEvent::Disconnect, 0 );
+    dropped = ClientClock::now();
     spdlog::info( "Connection Closed" );
     *p_State = DISCONNECTED;
 }
@@ -129,10 +288,11 @@ void ClientBrain::connectAck()
 
 void ClientBrain::reqHeadTimestamp()
 {
-    p_Client->reqHeadTimestamp( 14001, ContractSamples::EurGbpFx(), "MIDPOINT", 1,
-                                1 );
+    p_Outbound->send( OutboundLane::MarketData, [client = p_Client]() {
+        client->reqHeadTimestamp( 14001, ContractSamples::EurGbpFx(), "MIDPOINT", 1, 1 );
+    } );
     std::this_thread::sleep_for( std::chrono::seconds( 1 ) );
-    p_Client->cancelHeadTimestamp( 14001 );
+    p_Outbound->send( OutboundLane::MarketData, [client = p_Client]() { client->cancelHeadTimestamp( 14001 ); } );
 
     *p_State = REQHEADTIMESTAMP_ACK;
 }
@@ -148,7 +308,7 @@ void ClientBrain::reqCurrentTime()
     // set ping deadline to "now + n seconds"
     m_sleepDeadline = time( nullptr ) + PING_DEADLINE;
     *p_State = PING_ACK;
-    p_Client->reqCurrentTime();
+    p_Outbound->send( OutboundLane::MarketData, [client = p_Client]() { client->reqCurrentTime(); } );
 }
 
 void ClientBrain::currentTime( long time )
@@ -177,6 +337,7 @@ void ClientBrain::managedAccounts( const std::string& accountsList )
 
 void ClientBrain::error( int id, int errorCode, const std::string& errorString )
 {
+    FlightRecorder::record( FlightEvent::Error, id, errorCode );
     spdlog::error( "Error: ID " + to_string( id ) + " Code " + to_string( errorCode ) +
                    " MSG " + errorString );
     if( inter )
@@ -184,11 +345,33 @@ void ClientBrain::error( int id, int errorCode, const std::string& errorString )
         disconnect();
         exit( -1 );
     }
+    else if( Data->gapFailed( id ) )
+    {
+        // the real-time bars waiting on a gap request go ahead without it
+    }
+    else if( Data->tickPageFailed( id ) )
+    {
+        // a historical tick page was refused or paced, it is sent again
+    }
+    else if( errorCode == 317 && Data->resetBook( id ) )
+    {
+        // the market depth was reset, the rows that follow rebuild the book from empty
+    }
+    else if( ( errorCode < 2100 || errorCode >= 2200 ) && Data->lookupFailed( id ) )
+    {
+        // a contract universe lookup failed, 200 when there is no security definition.
+        // Codes 2100 to 2199 are warnings that leave the request running
+    }
     else if( errorCode == 322 )
     {
         // more than 50 data requests at once, so this vectorId won't be answered
         Data->openHistRequests.erase( (long)id );
     }
+    else if( errorCode == 10190 )
+    {
+        // too many tick-by-tick subscriptions, give the slot to a waiting stream
+        Data->ticksRefused( id );
+    }
     else if( errorCode == 504 )
     {
         // just made a request with p_Client when disconnected
@@ -242,14 +425,7 @@ void ClientBrain::updateAccountValue( const std::string& key,
     {
         Account->cash = atof( val.data() );
     }
-    else if( key == "RealizedPnL" )
-    {
-        Account->PnL = atof( val.data() );
-    }
-    else if( key == "UnrealizedPnL" )
-    {
-        Account->UPnL = atof( val.data() );
-    }
+    // RealizedPnL and UnrealizedPnL come minutes late, the PnL engine keeps them instead
 }
 
 void ClientBrain::updatePortfolio( const Contract& contract, double position,
@@ -258,6 +434,14 @@ void ClientBrain::updatePortfolio( const Contract& contract, double position,
                                    double             realizedPNL,
                                    const std::string& accountName )
 {
+    Broker->risk().position( contract, position );
+    auto slot = Account->pnl().slot( contract );
+    Account->pnl().position( slot, position, averageCost, marketPrice );
+    Account->sync();
+    if( position != 0 && isConnected() )
+    {
+        Account->trackPnL( slot, contract, getNextReqId() );
+    }
     // if we're initializing the bot
     if( *p_State == INIT )
     {
@@ -276,7 +460,7 @@ void ClientBrain::updatePortfolio( const Contract& contract, double position,
         exec.price = averageCost;
         exec.shares = position;
         exec.side = position > 0 ? "BUY" : "SELL";
-        exec.time = TimeStamp().toString();
+        exec.time = HistoryStore::barTimeString( ClientClock::now() );
         auto pos = Position( contract, order, exec );
         Account->update( pos );
         spdlog::info( "Updating portfolio: " + contract.symbol +
@@ -327,10 +511,27 @@ void ClientBrain::positionEnd() { spdlog::info( "End of positiion update" ); }
 void ClientBrain::tickPrice( TickerId tickerId, TickType field, double price,
                              const TickAttrib& attribs )
 {
+    FlightRecorder::record( FlightEvent::TickPrice, (int32_t)tickerId, field, price );
+    if( journal )
+    {
+        journal->tickPrice( tickerId, field, price );
+    }
     auto snapVec = Data->snapMap.find( tickerId );
     auto opVec = Data->optionMap.find( tickerId );
     if( snapVec != Data->snapMap.end() )
     {
+        snapVec->second.ticks->add();
+        if( snapVec->second.riskSlot < 0 )
+        {
+            snapVec->second.riskSlot = Broker->risk().slot( snapVec->second.contract );
+        }
+        Broker->risk().mark( snapVec->second.riskSlot, field, price );
+        if( snapVec->second.pnlSlot < 0 )
+        {
+            snapVec->second.pnlSlot = Account->pnl().slot( snapVec->second.contract );
+        }
+        Account->pnl().mark( snapVec->second.pnlSlot, field, price );
+        Account->sync();
         if( field == 1 || field == 2 )
         {
             Data->updatePrice( tickerId, snapVec->second.bidAsk, price, field );
@@ -342,6 +543,18 @@ void ClientBrain::tickPrice( TickerId tickerId, TickType field, double price,
     }
     else if( opVec != Data->optionMap.end() )
     {
+        opVec->second.ticks->add();
+        if( opVec->second.riskSlot < 0 )
+        {
+            opVec->second.riskSlot = Broker->risk().slot( opVec->second.contract );
+        }
+        Broker->risk().mark( opVec->second.riskSlot, field, price );
+        if( opVec->second.pnlSlot < 0 )
+        {
+            opVec->second.pnlSlot = Account->pnl().slot( opVec->second.contract );
+        }
+        Account->pnl().mark( opVec->second.pnlSlot, field, price );
+        Account->sync();
         if( field == 1 || field == 2 )
         {
             Data->updatePrice( tickerId, opVec->second.bidAsk, price, field );
@@ -351,14 +564,24 @@ void ClientBrain::tickPrice( TickerId tickerId, TickType field, double price,
             Data->updatePrice( tickerId, opVec->second.lastTrade, price, field );
         }
     }
+    else
+    {
+        Data->underlyingTick( tickerId, field, price );
+    }
 }
 
 void ClientBrain::tickSize( TickerId tickerId, TickType field, int size )
 {
+    FlightRecorder::record( FlightEvent::TickSize, (int32_t)tickerId, field, size );
+    if( journal )
+    {
+        journal->tickSize( tickerId, field, size );
+    }
     auto snapVec = Data->snapMap.find( tickerId );
     auto opVec = Data->optionMap.find( tickerId );
     if( snapVec != Data->snapMap.end() )
     {
+        snapVec->second.ticks->add();
         if( field == 0 || field == 3 )
         {
             Data->updateSize( tickerId, snapVec->second.bidAsk, size, field );
@@ -370,6 +593,7 @@ void ClientBrain::tickSize( TickerId tickerId, TickType field, int size )
     }
     else if( opVec != Data->optionMap.end() )
     {
+        opVec->second.ticks->add();
         if( field == 0 || field == 3 )
         {
             Data->updateSize( tickerId, opVec->second.bidAsk, size, field );
@@ -393,6 +617,12 @@ void ClientBrain::tickOptionComputation( TickerId tickerId, TickType tickType,
                                          double gamma, double vega, double theta,
                                          double undPrice )
 {
+    FlightRecorder::record( FlightEvent::OptionComputation, (int32_t)tickerId, tickType, impliedVol );
+    if( journal )
+    {
+        journal->tickOptionComputation( tickerId, tickType, impliedVol, delta, optPrice,
+                                        pvDividend, gamma, vega, theta, undPrice );
+    }
     auto opVec = Data->optionMap.find( tickerId );
     if( opVec != Data->optionMap.end() )
     {
@@ -436,6 +666,7 @@ void ClientBrain::tickString( TickerId tickerId, TickType tickType,
 void ClientBrain::tickSnapshotEnd( int reqId )
 {
     spdlog::info( "Snapshot for " + to_string( reqId ) + " has ended." );
+    Data->underlyingSnapshotEnd( reqId );
 }
 
 void ClientBrain::tickReqParams( int tickerId, double minTick,
@@ -460,39 +691,34 @@ void ClientBrain::historicalDataEnd( int reqId, const std::string& startDateStr,
 {
     spdlog::info( "HistoricalDataEnd. ReqId: " + to_string( reqId ) +
                   " - Start Date: " + startDateStr + ", End Date: " + endDateStr );
-    Data->openHistRequests.erase( (long)reqId );
+    Data->histRequestDone( (long)reqId );
 }
 
 void ClientBrain::historicalTicks( int                                reqId,
                                    const std::vector<HistoricalTick>& ticks,
                                    bool                               done )
 {
-    for( const HistoricalTick& tick : ticks )
-    {
-        spdlog::info( "In historicalTicks callback." );
-    }
+    Data->updateHistTicks( reqId, ticks, done );
 }
 
 void ClientBrain::historicalTicksBidAsk(
     int reqId, const std::vector<HistoricalTickBidAsk>& ticks, bool done )
 {
-    for( const HistoricalTickBidAsk& tick : ticks )
-    {
-        spdlog::info( "In historicalTicksBidAsk callback." );
-    }
+    Data->updateHistTicks( reqId, ticks, done );
 }
 
 void ClientBrain::historicalTicksLast(
     int reqId, const std::vector<HistoricalTickLast>& ticks, bool done )
 {
-    for( const auto& tick : ticks )
-    {
-        spdlog::info( "In historicalTicksLast callback." );
-    }
+    Data->updateHistTicks( reqId, ticks, done );
 }
 
 void ClientBrain::historicalData( TickerId reqId, const Bar& bar )
 {
+    if( journal )
+    {
+        journal->historicalData( reqId, bar );
+    }
     Data->updateCandle( reqId, bar );
 }
 
@@ -501,6 +727,75 @@ void ClientBrain::historicalDataUpdate( TickerId reqId, const Bar& bar )
     Data->updateCandle( reqId, bar );
 }
 
+void ClientBrain::realtimeBar( TickerId reqId, long time, double open, double high, double low,
+                               double close, long volume, double wap, int count )
+{
+    Bar bar;
+    bar.time = HistoryStore::barTimeString( (int64_t)time * 1000000000 );
+    bar.open = open;
+    bar.high = high;
+    bar.low = low;
+    bar.close = close;
+    bar.wap = wap;
+    bar.volume = volume;
+    bar.count = count;
+    Data->updateRealTimeBar( reqId, bar );
+}
+
+void ClientBrain::tickByTickAllLast( int reqId, int tickType, time_t time, double price, int size,
+                                     const TickAttribLast& tickAttribLast, const std::string& exchange,
+                                     const std::string& specialConditions )
+{
+    Data->updateTrade( reqId, time, price, size, tickAttribLast );
+}
+
+void ClientBrain::tickByTickBidAsk( int reqId, time_t time, double bidPrice, double askPrice,
+                                    int bidSize, int askSize, const TickAttribBidAsk& tickAttribBidAsk )
+{
+    Data->updateQuote( reqId, time, bidPrice, askPrice, bidSize, askSize );
+}
+
+void ClientBrain::updateMktDepth( TickerId id, int position, int operation, int side,
+                                  double price, int size )
+{
+    if( journal )
+    {
+        journal->marketDepth( id, position, operation, side, price, size );
+    }
+    Data->updateBook( id, position, operation, side, price, size );
+}
+
+void ClientBrain::updateMktDepthL2( TickerId id, int position, const std::string& marketMaker,
+                                    int operation, int side, double price, int size,
+                                    bool isSmartDepth )
+{
+    // the book is aggregated by price, the market maker of a row is not kept
+    updateMktDepth( id, position, operation, side, price, size );
+}
+
+void ClientBrain::contractDetails( int reqId, const ContractDetails& contractDetails )
+{
+    Data->contractResolved( reqId, contractDetails );
+}
+
+void ClientBrain::contractDetailsEnd( int reqId )
+{
+    Data->contractResolvedEnd( reqId );
+}
+
+void ClientBrain::securityDefinitionOptionalParameter(
+    int reqId, const std::string& exchange, int underlyingConId,
+    const std::string& tradingClass, const std::string& multiplier,
+    const std::set<std::string>& expirations, const std::set<double>& strikes )
+{
+    Data->chainResolved( reqId, exchange, multiplier, expirations, strikes );
+}
+
+void ClientBrain::securityDefinitionOptionalParameterEnd( int reqId )
+{
+    Data->chainResolvedEnd( reqId );
+}
+
 /* ClientBroker Callbacks */
 void ClientBrain::orderStatus( OrderId orderId, const std::string& status,
                                double filled, double remaining,
@@ -508,7 +803,14 @@ void ClientBrain::orderStatus( OrderId orderId, const std::string& status,
                                double lastFillPrice, int clientId,
                                const std::string& whyHeld, double mktCapPrice )
 {
+    FlightRecorder::record( FlightEvent::OrderStatus, (int32_t)orderId, FlightRecorder::orderStatus( status ), filled );
     spdlog::warn( "In orderStatus. The status message is " + status );
+    if( journal )
+    {
+        journal->orderStatus( orderId, status, filled, remaining, avgFillPrice, lastFillPrice );
+    }
+    bool done = status == "Filled" || status == "Cancelled" || status == "ApiCancelled" || status == "Inactive";
+    Broker->risk().status( orderId, filled, done ? 0 : remaining );
     if( status == "ApiPending" )
     {
         // yet to be submitted to IB server, consider it open
@@ -561,15 +863,7 @@ void ClientBrain::orderStatus( OrderId orderId, const std::string& status,
     {
         // order has been completely filled
         spdlog::info( "Received Filled status for order " + to_string( orderId ) );
-        auto filter = ExecutionFilter();
-        filter.m_acctCode = Account->accountID;
-        filter.m_clientId = clientId;
-        filter.m_symbol = Broker->orderMap[orderId].first.symbol;
-        filter.m_secType = Broker->orderMap[orderId].first.secType;
-        filter.m_side = Broker->orderMap[orderId].second.action;
-        auto newExecId = getNextReqId();
-        Broker->executionMap[newExecId] = Broker->orderMap[orderId];
-        Broker->filledOrder( newExecId, filter );
+        // its executions were booked by execDetails as they streamed in
         Broker->openOrders.erase( Broker->orderMap[orderId] );
     }
     else if( status == "Inactive" )
@@ -603,22 +897,66 @@ void ClientBrain::completedOrdersEnd() { spdlog::info( "End completedOrders" );
 void ClientBrain::execDetails( int reqId, const Contract& contract,
                                const Execution& execution )
 {
-    if( Broker->executionMap.find( reqId ) != Broker->executionMap.end() )
+    FlightRecorder::record( FlightEvent::Execution, (int32_t)execution.orderId, reqId, execution.shares );
+    auto fill = Broker->fill( contract, execution );
+    if( fill == nullptr )
     {
-        auto pa = Broker->executionMap[reqId];
-        spdlog::info(
-            "Received executions targeted at orders for position with symbol " +
-            pa.first.symbol + ", secId: " + pa.first.secType );
-        Account->update( Position( pa.first, pa.second, execution ) );
+        // already streamed, reqExecutions sends every execution of the day again
+        return;
     }
-    else
+    auto slot = Account->pnl().slot( contract );
+    Account->pnl().fill( slot, fill->shares, fill->price );
+    Account->sync();
+    if( isConnected() )
     {
-        spdlog::error(
-            "Received a reqId in execDetails that did not map to a position!" );
+        Account->trackPnL( slot, contract, getNextReqId() );
+    }
+    spdlog::info( "Received execution " + execution.execId + " of order " + to_string( execution.orderId ) +
+                  ": " + execution.side + " " + to_string( execution.shares ) + " " + contract.symbol + " at " +
+                  to_string( execution.price ) );
+    auto found = Broker->orderMap.find( execution.orderId );
+    if( found != Broker->orderMap.end() )
+    {
+        Account->update( Position( found->second.first, found->second.second, execution ) );
+        return;
     }
+    // an order of another client or of an earlier session
+    auto order = Order();
+    order.account = execution.acctNumber;
+    order.action = execution.side == "BOT" ? "BUY" : "SELL";
+    order.clientId = execution.clientId;
+    order.orderId = execution.orderId;
+    Account->update( Position( contract, order, execution ) );
 }
 
 void ClientBrain::execDetailsEnd( int reqId )
 {
     spdlog::info( "End execDetails for " + to_string( reqId ) );
-}
\ No newline at end of file
+}
+
+void ClientBrain::commissionReport( const CommissionReport& report )
+{
+    auto fill = Broker->commission( report );
+    if( fill == nullptr )
+    {
+        // a report sent again by reqExecutions was charged already
+        if( Broker->fills().count( report.execId ) == 0 )
+        {
+            spdlog::warn( "Received a commission report for unknown execution " + report.execId );
+        }
+        return;
+    }
+    Account->pnl().charge( Account->pnl().slot( fill->conId, fill->symbol, fill->secType ), report.commission );
+    Account->sync();
+    spdlog::info( "Commission of execution " + report.execId + " of symbol " + fill->symbol + ": " +
+                  to_string( report.commission ) + " " + report.currency );
+}
+
+void ClientBrain::pnlSingle( int reqId, int pos, double dailyPnL, double unrealizedPnL, double realizedPnL,
+                             double value )
+{
+    if( Account->pnl().reconcile( reqId, pos, unrealizedPnL, realizedPnL, value, ClientClock::now() ) )
+    {
+        Account->sync();
+    }
+}
@@ -1,10 +1,26 @@
 #include "ClientBroker.h"
+#include "ClientClock.h"
+#include "CommissionReport.h"
 #include "EClientSocket.h"
 #include "Execution.h"
+#include "FlightRecorder.h"
+#include "Metrics.h"
+#include "OutboundScheduler.h"
+#include <cfloat>
 #include <spdlog/spdlog.h>
 
 using namespace std;
 
+namespace
+{
+    /// What a modify cannot change: the contract, the side and the order type
+    string modifyKey( const Contract& con, const Order& order )
+    {
+        auto contract = con.conId != 0 ? to_string( con.conId ) : con.symbol + " " + con.secType;
+        return contract + " " + order.action + " " + order.orderType;
+    }
+} // namespace
+
 ClientBroker::ClientBroker( const std::shared_ptr<EClientSocket>&      newClient,
                             const std::shared_ptr<ClientSpace::State>& newState,
                             const shared_ptr<OrderId>&                 ordersId )
@@ -12,27 +28,128 @@ ClientBroker::ClientBroker( const std::shared_ptr<EClientSocket>&      newClient
     p_Client = newClient;
     p_State = newState;
     p_OrderId = ordersId;
-    executionMap = map<long, pair<Contract, Order>>();
+    executions = unordered_map<string, Fill>();
     pendingOrders = set<pair<Contract, Order>, OrderCompare>();
     openOrders = set<pair<Contract, Order>, OrderCompare>();
+    sink = nullptr;
+    riskEngine = RiskEngine();
+    booked = &Metrics::global().counter( "tradebot_executions_total", "Executions booked" );
+    duplicates = &Metrics::global().counter( "tradebot_duplicate_executions_total",
+                                             "Executions received again and ignored" );
 }
 
-void ClientBroker::placeOrder( pair<Contract, Order>& p )
+bool ClientBroker::placeOrder( pair<Contract, Order>& p )
 {
     auto contract = p.first;
     auto order = p.second;
-    spdlog::info( "Placing order for symbol " + contract.symbol + ", SecType " +
-                  contract.secType + " with order ID " + to_string( *p_OrderId ) );
-    auto newOrderId = *p_OrderId;
+    // a cancel of the same contract, side and type still waiting to go out turns this order into a modify
+    auto replaced = sink == nullptr ? p_Outbound->cancelled( modifyKey( contract, order ) ) : -1;
+    auto newOrderId = replaced >= 0 ? replaced : *p_OrderId;
+    auto verdict = riskEngine.check( contract, order, newOrderId, ClientClock::now() );
+    if( verdict != RiskVerdict::Accepted )
+    {
+        spdlog::warn( "Rejected order for symbol " + contract.symbol + ", SecType " + contract.secType + ": " +
+                      RiskEngine::name( verdict ) );
+        FlightRecorder::record( FlightEvent::OrderRejected, (int32_t)newOrderId, (int32_t)verdict,
+                                order.totalQuantity );
+        Metrics::global()
+            .counter( "tradebot_risk_rejects_total", "Orders rejected by the pre-trade checks",
+                      string( "reason=\"" ) + RiskEngine::name( verdict ) + "\"" )
+            .add();
+        return false;
+    }
+    if( replaced >= 0 )
+    {
+        spdlog::info( "Modifying order " + to_string( replaced ) + " of symbol " + contract.symbol +
+                      " instead of cancelling it" );
+        p_Outbound->replace( replaced );
+        openOrders.erase( orderMap[replaced] );
+    }
+    else
+    {
+        spdlog::info( "Placing order for symbol " + contract.symbol + ", SecType " +
+                      contract.secType + " with order ID " + to_string( newOrderId ) );
+        ( *p_OrderId )++;
+    }
     orderMap[newOrderId] = p;
-    ( *p_OrderId )++;
     order.orderId = newOrderId;
     openOrders.insert( p );
+    FlightRecorder::record( FlightEvent::OrderPlaced, (int32_t)newOrderId, order.action == "BUY" ? 1 : -1,
+                            order.totalQuantity );
+
+    if( sink != nullptr )
+    {
+        sink->placeOrder( newOrderId, contract, order );
+        return true;
+    }
+    p_Outbound->send( OutboundLane::Orders, [client = p_Client, newOrderId, contract, order]() {
+        client->placeOrder( newOrderId, contract, order );
+    } );
+    return true;
+}
 
-    p_Client->placeOrder( newOrderId, contract, order );
+void ClientBroker::cancelOrder( OrderId orderId )
+{
+    auto found = orderMap.find( orderId );
+    if( found == orderMap.end() )
+    {
+        spdlog::error( "Cannot cancel unknown order " + to_string( orderId ) );
+        return;
+    }
+    if( sink != nullptr )
+    {
+        // a replay fills orders as soon as they are placed, there is nothing left to cancel
+        return;
+    }
+    p_Outbound->cancel( orderId, modifyKey( found->second.first, found->second.second ),
+                        [client = p_Client, orderId]() { client->cancelOrder( orderId ); } );
+}
+
+void ClientBroker::requestExecutions( long reqId, const ExecutionFilter& filter )
+{
+    if( sink != nullptr )
+    {
+        sink->reqExecutions( (int)reqId, filter );
+        return;
+    }
+    p_Outbound->send( OutboundLane::Orders,
+                      [client = p_Client, reqId, filter]() { client->reqExecutions( (int)reqId, filter ); } );
 }
 
-void ClientBroker::filledOrder( long reqId, const ExecutionFilter& filter )
+const Fill* ClientBroker::fill( const Contract& con, const Execution& execution )
 {
-    p_Client->reqExecutions( reqId, filter );
+    if( executions.find( execution.execId ) != executions.end() )
+    {
+        duplicates->add();
+        return nullptr;
+    }
+    booked->add();
+    auto side = execution.side == "BOT" || execution.side == "BUY" ? 1.0 : -1.0;
+    auto& f = executions[execution.execId];
+    f = Fill { execution.orderId, con.conId, con.symbol, con.secType, side * (double)execution.shares, execution.price, 0, 0,
+               ClientClock::now(), false };
+    return &f;
 }
+
+const Fill* ClientBroker::commission( const CommissionReport& report )
+{
+    auto found = executions.find( report.execId );
+    // reqExecutions sends the report again with the execution
+    if( found == executions.end() || found->second.reported )
+    {
+        return nullptr;
+    }
+    found->second.reported = true;
+    found->second.commission = report.commission;
+    // TWS sends DBL_MAX until a closing execution realizes something
+    found->second.realizedPNL = report.realizedPNL < DBL_MAX ? report.realizedPNL : 0;
+    return &found->second;
+}
+
+const unordered_map<string, Fill>& ClientBroker::fills() const { return executions; }
+
+void ClientBroker::simulate( OrderSink* newSink ) { sink = newSink; }
+
+RiskEngine& ClientBroker::risk() { return riskEngine; }
+
+void ClientBroker::addOutbound( shared_ptr<OutboundScheduler> newOutbound ) { p_Outbound = move( newOutbound ); }
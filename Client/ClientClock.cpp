@@ -0,0 +1,30 @@
+#include "ClientClock.h"
+#include <chrono>
+
+using namespace std;
+
+namespace
+{
+    // every replay runs on its own thread, so a backtest can run several at once
+    thread_local bool    simulating = false;
+    thread_local int64_t simulatedTime = 0;
+} // namespace
+
+int64_t ClientClock::now()
+{
+    if( simulating )
+    {
+        return simulatedTime;
+    }
+    return chrono::duration_cast<chrono::nanoseconds>( chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+void ClientClock::simulate( int64_t time )
+{
+    simulatedTime = time;
+    simulating = true;
+}
+
+void ClientClock::release() { simulating = false; }
+
+bool ClientClock::simulated() { return simulating; }
@@ -1,20 +1,58 @@
 #include "ClientData.h"
+#include "Backfill.h"
+#include "ClientClock.h"
 #include "DataArray.h"
 #include "EClientSocket.h"
 #include "Indicator.h"
+#include "Metrics.h"
+#include "OutboundScheduler.h"
 #include "SMA.h"
+#include "SeriesCodec.h"
 #include "TimeStamp.h"
 #include "bar.h"
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <spdlog/spdlog.h>
-#include <thread>
 
 constexpr int64_t TIMEOUT = 20;
+/// Default universe config and contract cache, relative to the working directory
+constexpr const char* UNIVERSE_CONFIG = "universe.cfg";
+constexpr const char* CONTRACT_CACHE = "contracts.cache";
+/// Catalog of the historical ranges harvested so far
+constexpr const char* HARVEST_CATALOG = "harvest.catalog";
+/// First id of the streaming bar vectors, far above any TWS request id
+constexpr long FIRST_BAR_VECTOR = 1L << 30;
+/// Length of a real-time bar, the only one TWS offers
+constexpr int REALTIME_BAR_SECONDS = 5;
+/// Longest gap between a history and its real-time bars that is filled on subscribing, in seconds
+constexpr int64_t REALTIME_GAP_LIMIT = 3600;
+constexpr int64_t NANOS_PER_SECOND = 1000000000;
 
 using namespace std;
 using namespace ClientSpace;
 
+namespace
+{
+    MetricCounter& lineTicks( const Contract& con, long vecId )
+    {
+        return Metrics::global().counter( "tradebot_ticks_total", "Market data ticks received per line",
+                                          "line=\"" + to_string( vecId ) + "\",symbol=\"" + con.symbol +
+                                              "\",type=\"" + con.secType + "\"" );
+    }
+
+    /// TimeStamp of a candle starting at epoch nanoseconds, built from its local
+    /// date and time fields instead of a formatted string
+    TimeStamp candleTime( int64_t time )
+    {
+        time_t t = (time_t)( time / NANOS_PER_SECOND );
+        tm     parts {};
+        localtime_r( &t, &parts );
+        return TimeStamp( parts.tm_year + 1900, parts.tm_mon + 1, parts.tm_mday, parts.tm_hour, parts.tm_min,
+                          parts.tm_sec );
+    }
+} // namespace
+
 ClientData::ClientData()
 {
     indicators = vector<BTIndicator*>();
@@ -22,7 +60,17 @@ ClientData::ClientData()
     openDataLines = set<long>();
     updatedLines = set<long>();
     TimeLine = TimeMap();
+    universeConfig = UNIVERSE_CONFIG;
+    universeCache = CONTRACT_CACHE;
+    barSeconds = vector<int>( begin( DEFAULT_BAR_SECONDS ), end( DEFAULT_BAR_SECONDS ) );
+    barSource = BarSource::Trades;
+    nextBarVector = FIRST_BAR_VECTOR;
+    tickRoot = HISTORY_ROOT;
+    localGreeks = true;
+    riskFreeRate = RISK_FREE_RATE;
     valid = false;
+    lookupDeadline = 0;
+    depthBooks = 0;
 }
 
 ClientData::ClientData( vector<BTIndicator*>& newIndicators )
@@ -32,7 +80,17 @@ ClientData::ClientData( vector<BTIndicator*>& newIndicators )
     openDataLines = set<long>();
     updatedLines = set<long>();
     TimeLine = TimeMap();
+    universeConfig = UNIVERSE_CONFIG;
+    universeCache = CONTRACT_CACHE;
+    barSeconds = vector<int>( begin( DEFAULT_BAR_SECONDS ), end( DEFAULT_BAR_SECONDS ) );
+    barSource = BarSource::Trades;
+    nextBarVector = FIRST_BAR_VECTOR;
+    tickRoot = HISTORY_ROOT;
+    localGreeks = true;
+    riskFreeRate = RISK_FREE_RATE;
     valid = false;
+    lookupDeadline = 0;
+    depthBooks = 0;
 }
 
 ClientData::ClientData( const shared_ptr<EClientSocket>& newClient,
@@ -45,7 +103,17 @@ ClientData::ClientData( const shared_ptr<EClientSocket>& newClient,
     openDataLines = set<long>();
     updatedLines = set<long>();
     TimeLine = TimeMap();
+    universeConfig = UNIVERSE_CONFIG;
+    universeCache = CONTRACT_CACHE;
+    barSeconds = vector<int>( begin( DEFAULT_BAR_SECONDS ), end( DEFAULT_BAR_SECONDS ) );
+    barSource = BarSource::Trades;
+    nextBarVector = FIRST_BAR_VECTOR;
+    tickRoot = HISTORY_ROOT;
+    localGreeks = true;
+    riskFreeRate = RISK_FREE_RATE;
     valid = false;
+    lookupDeadline = 0;
+    depthBooks = 0;
 }
 
 void ClientData::addClient( std::shared_ptr<EClientSocket> newClient )
@@ -57,111 +125,160 @@ void ClientData::addState( std::shared_ptr<ClientSpace::State> newState )
     p_State = move( newState );
 }
 
+void ClientData::addOutbound( shared_ptr<OutboundScheduler> newOutbound ) { p_Outbound = move( newOutbound ); }
+
+void ClientData::setUniverse( const string& config, const string& cache )
+{
+    universeConfig = config;
+    universeCache = cache;
+}
+
 void ClientData::init()
 {
+    catalog.load( HARVEST_CATALOG );
+    lookupDeadline = ClientClock::now() + RESOLVE_TIMEOUT * 1000000000;
     initContractVectors();
+    if( pendingLookups.empty() )
+    {
+        finishInit();
+    }
+}
+
+void ClientData::finishInit()
+{
+    spdlog::info( "Contract universe holds " + to_string( stockContracts.size() ) +
+                  " stocks and " + to_string( optionContracts.size() ) + " options" );
     startLiveData();
     valid = true;
 }
 
 void ClientData::startLiveData()
 {
-    // market data lines
+    // market data lines, with the trade prints of the stocks listed first in the
+    // universe taking the tick-by-tick slots
+    auto priority = (int)stockContracts.size();
+    auto depth = depthBooks;
+    auto realTime = set<string>();
+    for( const auto& entry : universe.entries )
+    {
+        if( entry.secType == "STK" && entry.realTime )
+        {
+            realTime.insert( entry.symbol );
+        }
+    }
     for( auto& con : stockContracts )
     {
-        newLiveRequest( con, getNextVectorId() );
-        this_thread::sleep_for( chrono::milliseconds( 500 ) );
+        auto line = getNextVectorId();
+        newLiveRequest( con, line );
+        openTicks( con, getNextVectorId(), TickKind::Trades, priority--, line );
+        if( depth-- > 0 )
+        {
+            openBook( con, getNextVectorId() );
+        }
+        if( realTime.count( con.symbol ) != 0 )
+        {
+            openRealTimeBars( con, getNextVectorId() );
+        }
     }
     for( auto& con : optionContracts )
     {
         newLiveRequest( con, getNextVectorId() );
-        this_thread::sleep_for( chrono::milliseconds( 500 ) );
     }
 }
 
+vector<HistRequest> ClientData::harvestPlan( int index ) const
+{
+    // duration and bar size of every request in each harvest index
+    static const vector<vector<pair<string, string>>> windows = {
+        { { "1800 S", "1 secs" }, { "3600 S", "5 secs" }, { "14400 S", "10 secs" }, { "14400 S", "15 secs" }, { "28800 S", "30 secs" },
+          // the length of all candles north of 30s have no length restriction anymore
+          { "1 D", "1 min" } },
+        { { "2 D", "2 mins" }, { "1 W", "3 mins" }, { "1 W", "5 mins" }, { "1 W", "10 mins" }, { "1 W", "15 mins" }, { "1 W", "20 mins" } },
+        { { "1 M", "30 mins" }, { "1 M", "1 hour" }, { "1 M", "2 hours" }, { "1 M", "3 hours" }, { "1 M", "4 hours" }, { "1 M", "8 hours" } },
+        { { "1 Y", "1 day" } } };
+    auto plan = vector<HistRequest>();
+    if( index < 0 || index >= (int)windows.size() )
+    {
+        return plan;
+    }
+    for( const auto& con : stockContracts )
+    {
+        for( const auto& window : windows[index] )
+        {
+            plan.push_back( HistRequest { con, window.first, window.second, "TRADES", "" } );
+        }
+    }
+    // only ask for what the previous harvests haven't already stored
+    return HarvestPlanner( catalog ).plan( plan, (int64_t)time( nullptr ) );
+}
+
+vector<HistRequest> ClientData::harvestPlan() const
+{
+    auto plan = vector<HistRequest>();
+    for( int index = 0; index < HARVEST_INDICES; index++ )
+    {
+        auto indexPlan = harvestPlan( index );
+        plan.insert( plan.end(), indexPlan.begin(), indexPlan.end() );
+    }
+    return plan;
+}
+
 void ClientData::harvest( int index )
 {
     // historical data requests
-    if( index == 0 )
+    for( auto& req : harvestPlan( index ) )
+    {
+        spdlog::info( "Retrieving " + req.duration + " of " + req.barSize +
+                      " historical data of index " + to_string( index ) + " for " +
+                      req.contract.symbol + " ending " + req.endDateTime );
+        newHistRequest( req, getNextVectorId() );
+    }
+    if( index == 3 )
     {
         for( auto& con : stockContracts )
         {
-            spdlog::info( "Retrieving historical data of index 0 for " + con.symbol );
-            newHistRequest( con, getNextVectorId(), "1800 S", "1 secs", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "3600 S", "5 secs", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "14400 S", "10 secs", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "14400 S", "15 secs", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "28800 S", "30 secs", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 D", "1 min",
-                            "TRADES" ); // the length of all candles north of 30s have
-                                        // no length restriction anymore
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
+            newLiveRequest( con, getNextVectorId() );
         }
+    }
+    if( index == 0 )
+    {
         *p_State = DATAHARVEST_TIMEOUT_0;
         startTimer();
     }
     else if( index == 1 )
     {
-        for( auto& con : stockContracts )
-        {
-            spdlog::info( "Retrieving historical data of index 1 for " + con.symbol );
-            newHistRequest( con, getNextVectorId(), "2 D", "2 mins", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 W", "3 mins", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 W", "5 mins", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 W", "10 mins", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 W", "15 mins", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 W", "20 mins", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-        }
         *p_State = DATAHARVEST_TIMEOUT_1;
         startTimer();
     }
     else if( index == 2 )
     {
-        for( auto& con : stockContracts )
-        {
-            spdlog::info( "Retrieving historical data of index 2 for " + con.symbol );
-            newHistRequest( con, getNextVectorId(), "1 M", "30 mins", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 M", "1 hour", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 M", "2 hours", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 M", "3 hours", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 M", "4 hours", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-            newHistRequest( con, getNextVectorId(), "1 M", "8 hours", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 200 ) );
-        }
         *p_State = DATAHARVEST_TIMEOUT_2;
         startTimer();
     }
     else if( index == 3 )
     {
-        for( auto& con : stockContracts )
-        {
-            spdlog::info( "Retrieving historical data of index 3 for " + con.symbol );
-            newHistRequest( con, getNextVectorId(), "1 Y", "1 day", "TRADES" );
-            this_thread::sleep_for( chrono::milliseconds( 500 ) );
-            newLiveRequest( con, getNextVectorId() );
-            this_thread::sleep_for( chrono::milliseconds( 500 ) );
-        }
         *p_State = DATAHARVEST_LIVE;
     }
 }
 
+void ClientData::startHarvestLive()
+{
+    for( auto& con : stockContracts )
+    {
+        newLiveRequest( con, getNextVectorId() );
+    }
+    *p_State = DATAHARVEST_LIVE;
+}
+
 void ClientData::newLiveRequest( Contract& con, long vecId )
+{
+    openLine( con, vecId );
+    p_Outbound->send( OutboundLane::MarketData, [client = p_Client, vecId, con]() {
+        client->reqMktData( vecId, con, "", false, false, TagValueListSPtr() );
+    } );
+}
+
+shared_ptr<DataArray> ClientData::openLine( const Contract& con, long vecId )
 {
     auto newVec = make_shared<DataArray>( vecId, con.conId, con.symbol, con.secId,
                                           con.secType, con.exchange, con.currency );
@@ -169,6 +286,25 @@ void ClientData::newLiveRequest( Contract& con, long vecId )
     if( con.secType == "STK" )
     {
         snapMap[vecId] = SnapHold();
+        snapMap[vecId].ticks = &lineTicks( con, vecId );
+        snapMap[vecId].contract = con;
+        snapMap[vecId].riskSlot = -1;
+        snapMap[vecId].pnlSlot = -1;
+        chainLines[vecId] = con.symbol;
+        if( !barSeconds.empty() )
+        {
+            auto builder = barBuilders.emplace( vecId, BarBuilder( barSeconds, barSource ) ).first;
+            auto& ids = barLines[vecId];
+            ids.clear();
+            for( int length : builder->second.lengths() )
+            {
+                auto barVec = make_shared<DataArray>( nextBarVector, con.conId, con.symbol, con.secId,
+                                                      con.secType, con.exchange, con.currency );
+                barVec->interval = BarBuilder::interval( length );
+                DataArrays.insert( barVec );
+                ids.push_back( nextBarVector++ );
+            }
+        }
     }
     else if( con.secType == "OPT" )
     {
@@ -178,17 +314,23 @@ void ClientData::newLiveRequest( Contract& con, long vecId )
         newVec->contract.right = con.right;
         newVec->exprDate = TimeStamp( con.lastTradeDateOrContractMonth, true );
         optionMap[vecId] = OptionHold();
+        optionMap[vecId].ticks = &lineTicks( con, vecId );
+        optionMap[vecId].contract = con;
+        optionMap[vecId].riskSlot = -1;
+        optionMap[vecId].pnlSlot = -1;
+        chains[con.symbol].add( vecId, con );
+        chainLines[vecId] = con.symbol;
     }
     for( const auto& ind : indicators )
     {
         newVec->addIndicator( ind );
     }
     DataArrays.insert( newVec );
-    p_Client->reqMktData( vecId, con, "", false, false, TagValueListSPtr() );
+    return newVec;
 }
 
-void ClientData::newHistRequest( Contract& con, long vecId, const string& length,
-                                 const string& barlength, const string& type )
+shared_ptr<DataArray> ClientData::newHistVector( Contract& con, long vecId,
+                                                 const string& barlength )
 {
     auto   newVec = make_shared<DataArray>( vecId, con.conId, con.symbol, con.secId,
                                           con.secType, con.exchange, con.currency );
@@ -198,9 +340,257 @@ void ClientData::newHistRequest( Contract& con, long vecId, const string& length
                  inter.end() );
     newVec->interval = inter;
     DataArrays.insert( newVec );
+    storeSeries[vecId] = make_pair( con.conId, inter );
+    return newVec;
+}
+
+void ClientData::newHistRequest( HistRequest& req, long vecId )
+{
+    newHistVector( req.contract, vecId, req.barSize );
     openHistRequests.insert( vecId );
-    p_Client->reqHistoricalData( vecId, con, "", length, barlength, type, 1, 1,
-                                 false, TagValueListSPtr() );
+    histRequests[vecId] = req;
+    p_Outbound->send( OutboundLane::Historical, [client = p_Client, vecId, req]() {
+        client->reqHistoricalData( vecId, req.contract, req.endDateTime, req.duration, req.barSize,
+                                   req.whatToShow, 1, 1, false, TagValueListSPtr() );
+    } );
+}
+
+void ClientData::addHistory( HistRequest& req, const vector<Bar>& bars )
+{
+    auto vecId = getNextVectorId();
+    newHistVector( req.contract, vecId, req.barSize );
+    for( const auto& bar : bars )
+    {
+        updateCandle( vecId, bar );
+    }
+    if( req.windowEnd > req.windowStart )
+    {
+        catalog.add( req, TimeRange( req.windowStart, req.windowEnd ), ClientClock::now() / 1000000000 );
+    }
+}
+
+void ClientData::histRequestDone( long vecId )
+{
+    if( gapFilled( vecId ) )
+    {
+        return;
+    }
+    openHistRequests.erase( vecId );
+    auto req = histRequests.find( vecId );
+    if( req != histRequests.end() && req->second.windowEnd > req->second.windowStart )
+    {
+        catalog.add( req->second, TimeRange( req->second.windowStart, req->second.windowEnd ),
+                     ClientClock::now() / 1000000000 );
+    }
+}
+
+void ClientData::saveHarvest() { catalog.save( HARVEST_CATALOG ); }
+
+void ClientData::writeStore( const string& root )
+{
+    // several requests can fill the same series, group them into one segment write
+    auto series = map<pair<long, string>, vector<BarRow>>();
+    for( auto& rows : barRows )
+    {
+        auto& target = series[storeSeries[rows.first]];
+        target.insert( target.end(), rows.second.begin(), rows.second.end() );
+    }
+    auto store = HistoryStore( root );
+    for( const auto& entry : series )
+    {
+        // harvested series are only appended to in bulk, keep them compressed on disk
+        if( store.write( entry.first.first, entry.first.second, entry.second ) )
+        {
+            store.compact( entry.first.first, entry.first.second );
+        }
+    }
+    spdlog::info( "Wrote " + to_string( series.size() ) + " series to the history store at " + root );
+    barRows.clear();
+}
+
+void ClientData::loadHistory( const string& root, const string& interval )
+{
+    auto store = HistoryStore( root );
+    for( auto& con : stockContracts )
+    {
+        auto series = DecodedSeries();
+        if( !store.load( con.conId, interval, series ) || series.kind != SeriesKind::Bars )
+        {
+            continue;
+        }
+        auto newVec = make_shared<DataArray>( getNextVectorId(), con.conId, con.symbol, con.secId,
+                                              con.secType, con.exchange, con.currency );
+        newVec->interval = interval;
+        for( const auto& ind : indicators )
+        {
+            newVec->addIndicator( ind );
+        }
+        const auto* time = series.times();
+        const auto* open = series.doubles( 1 );
+        const auto* high = series.doubles( 2 );
+        const auto* low = series.doubles( 3 );
+        const auto* close = series.doubles( 4 );
+        const auto* volume = series.ints( 5 );
+        for( size_t i = 0; i < series.rows(); i++ )
+        {
+            CandleStruct newPoint;
+            newPoint.time = candleTime( time[i] );
+            newPoint.open = open[i];
+            newPoint.high = high[i];
+            newPoint.low = low[i];
+            newPoint.close = close[i];
+            newPoint.volume = volume[i];
+            newVec->addPoint( newPoint );
+        }
+        if( series.rows() > 0 )
+        {
+            lastBars[newVec->vectorId] = time[series.rows() - 1];
+        }
+        DataArrays.insert( newVec );
+        spdlog::info( "Warm started " + con.symbol + " with " + to_string( series.rows() ) + " " +
+                      interval + " bars" );
+    }
+}
+
+void ClientData::openRealTimeBars( const Contract& con, long reqId, const string& whatToShow )
+{
+    auto interval = BarBuilder::interval( REALTIME_BAR_SECONDS );
+    auto line = RealTimeLine { 0, 0, 0, vector<Bar>() };
+    // continue the newest history of the same contract and bar length
+    for( const auto& vec : DataArrays )
+    {
+        auto last = lastBars.find( vec->vectorId );
+        if( vec->vectorId < FIRST_BAR_VECTOR && vec->contract.conId == con.conId &&
+            vec->interval == interval && last != lastBars.end() && last->second >= line.last )
+        {
+            line.vector = vec->vectorId;
+            line.last = last->second;
+        }
+    }
+    if( line.vector == 0 )
+    {
+        auto newVec = make_shared<DataArray>( reqId, con.conId, con.symbol, con.secId, con.secType,
+                                              con.exchange, con.currency );
+        newVec->interval = interval;
+        for( const auto& ind : indicators )
+        {
+            newVec->addIndicator( ind );
+        }
+        DataArrays.insert( newVec );
+        line.vector = reqId;
+    }
+    else
+    {
+        auto now = (int64_t)time( nullptr );
+        auto missing = now - line.last / NANOS_PER_SECOND - REALTIME_BAR_SECONDS;
+        if( missing > 0 )
+        {
+            // bars that arrive before the gap is filled wait for it
+            line.gapRequest = getNextVectorId();
+            gapRequests[line.gapRequest] = reqId;
+            auto duration = min( missing + REALTIME_BAR_SECONDS, REALTIME_GAP_LIMIT );
+            if( duration < missing + REALTIME_BAR_SECONDS )
+            {
+                spdlog::warn( "The history of " + con.symbol + " ends " + to_string( missing ) +
+                              " seconds ago, only the last " + to_string( REALTIME_GAP_LIMIT ) +
+                              " are filled and the bars before stay missing" );
+            }
+            spdlog::info( "Filling " + to_string( duration ) + " seconds of " + con.symbol +
+                          " bars before its real-time bars" );
+            p_Outbound->send( OutboundLane::Historical,
+                              [client = p_Client, id = line.gapRequest, con, duration, whatToShow]() {
+                                  client->reqHistoricalData( id, con, "", to_string( duration ) + " S", "5 secs",
+                                                             whatToShow, 0, 1, false, TagValueListSPtr() );
+                              } );
+        }
+    }
+    realTimeLines[reqId] = line;
+    p_Outbound->send( OutboundLane::MarketData, [client = p_Client, reqId, con, whatToShow]() {
+        client->reqRealTimeBars( reqId, con, REALTIME_BAR_SECONDS, whatToShow, false, TagValueListSPtr() );
+    } );
+}
+
+void ClientData::closeRealTimeBars()
+{
+    for( const auto& line : realTimeLines )
+    {
+        p_Outbound->send( OutboundLane::MarketData,
+                          [client = p_Client, reqId = line.first]() { client->cancelRealTimeBars( (int)reqId ); } );
+    }
+    realTimeLines.clear();
+    gapRequests.clear();
+}
+
+shared_ptr<DataArray> ClientData::realTimeVector( long reqId ) const
+{
+    auto line = realTimeLines.find( reqId );
+    if( line == realTimeLines.end() )
+    {
+        return nullptr;
+    }
+    auto vec = DataArrays.find( line->second.vector );
+    return vec != DataArrays.end() ? *vec : nullptr;
+}
+
+void ClientData::updateRealTimeBar( TickerId reqId, const Bar& bar )
+{
+    auto line = realTimeLines.find( reqId );
+    if( line == realTimeLines.end() )
+    {
+        spdlog::error( "Received a real-time bar for unknown subscription " + to_string( reqId ) );
+        return;
+    }
+    if( line->second.gapRequest != 0 )
+    {
+        line->second.held.push_back( bar );
+        return;
+    }
+    appendRealTimeBar( line->second, bar );
+}
+
+void ClientData::appendRealTimeBar( RealTimeLine& line, const Bar& bar )
+{
+    // the gap and the real-time bars overlap by a bar or two
+    auto start = HistoryStore::barTime( bar.time );
+    if( start <= line.last )
+    {
+        return;
+    }
+    line.last = start;
+    updateCandle( line.vector, bar );
+    auto vec = DataArrays.find( line.vector );
+    if( vec != DataArrays.end() )
+    {
+        updateTimeLine( *vec );
+    }
+}
+
+bool ClientData::gapFilled( long reqId )
+{
+    auto gap = gapRequests.find( reqId );
+    if( gap == gapRequests.end() )
+    {
+        return false;
+    }
+    auto& line = realTimeLines[gap->second];
+    gapRequests.erase( gap );
+    line.gapRequest = 0;
+    for( const auto& bar : line.held )
+    {
+        appendRealTimeBar( line, bar );
+    }
+    line.held.clear();
+    return true;
+}
+
+bool ClientData::gapFailed( long reqId )
+{
+    if( !gapFilled( reqId ) )
+    {
+        return false;
+    }
+    spdlog::warn( "Could not fill the gap before the real-time bars of request " + to_string( reqId ) );
+    return true;
 }
 
 void ClientData::startTimer() { start = chrono::high_resolution_clock::now(); }
@@ -218,17 +608,32 @@ bool ClientData::checkTimer()
 
 void ClientData::updateCandle( TickerId reqId, const Bar& bar )
 {
+    auto gap = gapRequests.find( reqId );
+    if( gap != gapRequests.end() )
+    {
+        appendRealTimeBar( realTimeLines[gap->second], bar );
+        return;
+    }
     auto point = DataArrays.find( reqId );
     if( point != DataArrays.end() )
     {
+        auto start = HistoryStore::barTime( bar.time );
+        auto last = lastBars.emplace( reqId, start ).first;
+        last->second = max( last->second, start );
+        // the bar time is parsed once, the candle is stamped from its epoch
         CandleStruct newPoint;
-        newPoint.time = TimeStamp( bar.time );
+        newPoint.time = candleTime( start );
         newPoint.open = bar.open;
         newPoint.high = bar.high;
         newPoint.low = bar.low;
         newPoint.close = bar.close;
         newPoint.volume = bar.volume;
         point->get()->addPoint( newPoint );
+        if( storeSeries.find( reqId ) != storeSeries.end() )
+        {
+            barRows[reqId].push_back( BarRow { start, bar.open, bar.high, bar.low, bar.close,
+                                               (int64_t)bar.volume } );
+        }
     }
     else
     {
@@ -239,6 +644,8 @@ void ClientData::updateCandle( TickerId reqId, const Bar& bar )
 void ClientData::updatePrice( TickerId reqId, SnapStruct& newPoint, double price,
                               int field )
 {
+    streamTick( reqId, field, price );
+    chainTick( reqId, field, price );
     if( field == 1 )
     {
         newPoint.bidPrice = price;
@@ -272,6 +679,7 @@ void ClientData::updatePrice( TickerId reqId, SnapStruct& newPoint, double price
 void ClientData::updatePrice( TickerId reqId, OptionStruct& newPoint,
                               double price, int field )
 {
+    chainTick( reqId, field, price );
     if( field == 1 )
     {
         newPoint.bidPrice = price;
@@ -305,6 +713,7 @@ void ClientData::updatePrice( TickerId reqId, OptionStruct& newPoint,
 void ClientData::updateSize( TickerId reqId, SnapStruct& newPoint, int value,
                              int field )
 {
+    streamTick( reqId, field, value );
     if( field == 0 )
     {
         newPoint.bidSize = value;
@@ -364,6 +773,11 @@ void ClientData::updateOptionGreeks( TickerId reqId, OptionStruct& newPoint,
                                      double gamma, double vega, double theta,
                                      int field )
 {
+    if( localGreeks )
+    {
+        // the chain pricer keeps the greeks of this line up to date
+        return;
+    }
     // sometimes (especially at the beginning) the data can be crap, so make sure
     // the values are sane
     if( abs( delta ) > 1 || abs( gamma ) > 1 )
@@ -470,178 +884,790 @@ void ClientData::updateTimeLine( const shared_ptr<DataArray>& vec )
     updatedLines.insert( vec->vectorId );
 }
 
-void ClientData::initContractVectors()
+void ClientData::streamBars( const vector<int>& seconds, BarSource source )
 {
-    // stock tickers
-    Contract MSFT = Contract();
-    MSFT.conId = 272093;
-    MSFT.symbol = "MSFT";
-    MSFT.secType = "STK";
-    MSFT.currency = "USD";
-    MSFT.exchange = "SMART";
-    MSFT.primaryExchange = "NASDAQ";
-    stockContracts.push_back( MSFT );
-
-    Contract AAPL = Contract();
-    AAPL.conId = 265598;
-    AAPL.symbol = "AAPL";
-    AAPL.secType = "STK";
-    AAPL.currency = "USD";
-    AAPL.exchange = "SMART";
-    AAPL.primaryExchange = "NASDAQ";
-    stockContracts.push_back( AAPL );
-
-    Contract NFLX = Contract();
-    NFLX.conId = 15124833;
-    NFLX.symbol = "NFLX";
-    NFLX.secType = "STK";
-    NFLX.currency = "USD";
-    NFLX.exchange = "SMART";
-    NFLX.primaryExchange = "NASDAQ";
-    stockContracts.push_back( NFLX );
-
-    Contract AMZN = Contract();
-    AMZN.conId = 3691937;
-    AMZN.symbol = "AMZN";
-    AMZN.secType = "STK";
-    AMZN.currency = "USD";
-    AMZN.exchange = "SMART";
-    AMZN.primaryExchange = "NASDAQ";
-    stockContracts.push_back( AMZN );
-
-    Contract GOOG = Contract();
-    GOOG.conId = 208813720;
-    GOOG.symbol = "GOOG";
-    GOOG.secType = "STK";
-    GOOG.currency = "USD";
-    GOOG.exchange = "SMART";
-    GOOG.primaryExchange = "NASDAQ";
-    stockContracts.push_back( GOOG );
-
-    Contract TSLA = Contract();
-    TSLA.conId = 76792991;
-    TSLA.symbol = "TSLA";
-    TSLA.secType = "STK";
-    TSLA.currency = "USD";
-    TSLA.exchange = "SMART";
-    TSLA.primaryExchange = "NASDAQ";
-    stockContracts.push_back( TSLA );
-
-    Contract BA = Contract();
-    BA.conId = 4762;
-    BA.symbol = "BA";
-    BA.secType = "STK";
-    BA.currency = "USD";
-    BA.exchange = "SMART";
-    BA.primaryExchange = "NYSE";
-    stockContracts.push_back( BA );
-
-    Contract INTC = Contract();
-    INTC.conId = 270639;
-    INTC.symbol = "INTC";
-    INTC.secType = "STK";
-    INTC.currency = "USD";
-    INTC.exchange = "SMART";
-    INTC.primaryExchange = "NASDAQ";
-    stockContracts.push_back( INTC );
-
-    Contract NVDA = Contract();
-    NVDA.conId = 4815747;
-    NVDA.symbol = "NVDA";
-    NVDA.secType = "STK";
-    NVDA.currency = "USD";
-    NVDA.exchange = "SMART";
-    NVDA.primaryExchange = "NASDAQ";
-    stockContracts.push_back( NVDA );
-
-    Contract FB = Contract();
-    FB.conId = 107113386;
-    FB.symbol = "FB";
-    FB.secType = "STK";
-    FB.currency = "USD";
-    FB.exchange = "SMART";
-    FB.primaryExchange = "NASDAQ";
-    stockContracts.push_back( FB );
-
-    // options for AMZN
-    Contract OPT0 = Contract();
-    OPT0.conId = getNextConId();
-    OPT0.symbol = "AMZN";
-    OPT0.secType = "OPT";
-    OPT0.exchange = "AMEX";
-    OPT0.currency = "USD";
-    OPT0.lastTradeDateOrContractMonth = "20200731";
-    OPT0.strike = 3050;
-    OPT0.right = "C";
-    OPT0.multiplier = "100";
-    optionContracts.push_back( OPT0 );
-
-    Contract OPT1 = Contract( OPT0 );
-    OPT1.conId = getNextConId();
-    OPT1.strike = 3100;
-    optionContracts.push_back( OPT1 );
-    Contract OPT2 = Contract( OPT0 );
-    OPT2.conId = getNextConId();
-    OPT2.strike = 3150;
-    optionContracts.push_back( OPT2 );
-    Contract OPT3 = Contract( OPT0 );
-    OPT3.conId = getNextConId();
-    OPT3.strike = 3150;
-    OPT3.right = "P";
-    optionContracts.push_back( OPT3 );
-    Contract OPT4 = Contract( OPT3 );
-    OPT4.conId = getNextConId();
-    OPT4.strike = 3100;
-    optionContracts.push_back( OPT4 );
-    Contract OPT5 = Contract( OPT3 );
-    OPT5.conId = getNextConId();
-    OPT5.strike = 3050;
-    optionContracts.push_back( OPT5 );
-
-    // options for TSLA
-    Contract OPT6 = Contract();
-    OPT6.conId = getNextConId();
-    OPT6.symbol = "TSLA";
-    OPT6.secType = "OPT";
-    OPT6.exchange = "AMEX";
-    OPT6.currency = "USD";
-    OPT6.lastTradeDateOrContractMonth = "20200731";
-    OPT6.strike = 1400;
-    OPT6.right = "C";
-    OPT6.multiplier = "100";
-    optionContracts.push_back( OPT6 );
-
-    Contract OPT7 = Contract( OPT6 );
-    OPT7.conId = getNextConId();
-    OPT7.strike = 1450;
-    optionContracts.push_back( OPT7 );
-    Contract OPT8 = Contract( OPT6 );
-    OPT8.conId = getNextConId();
-    OPT8.strike = 1500;
-    optionContracts.push_back( OPT8 );
-    Contract OPT9 = Contract( OPT6 );
-    OPT9.conId = getNextConId();
-    OPT9.strike = 1500;
-    OPT9.right = "P";
-    optionContracts.push_back( OPT9 );
-    Contract OPT10 = Contract( OPT9 );
-    OPT10.conId = getNextConId();
-    OPT10.strike = 1450;
-    optionContracts.push_back( OPT10 );
-    Contract OPT11 = Contract( OPT9 );
-    OPT11.conId = getNextConId();
-    OPT11.strike = 1400;
-    optionContracts.push_back( OPT11 );
+    barSeconds = seconds;
+    barSource = source;
 }
 
-bool ClientData::updated()
+void ClientData::streamBar( int seconds )
 {
-    if( !updatedLines.empty() )
+    if( find( barSeconds.begin(), barSeconds.end(), seconds ) != barSeconds.end() )
     {
-        updatedLines.clear();
+        return;
+    }
+    spdlog::info( "Streaming " + to_string( seconds ) + " second bars for the evaluation mode" );
+    barSeconds.push_back( seconds );
+    sort( barSeconds.begin(), barSeconds.end() );
+}
+
+bool ClientData::barsClosed( int seconds )
+{
+    auto now = ClientClock::now();
+    for( auto& builder : barBuilders )
+    {
+        closing.clear();
+        builder.second.advance( now, closing );
+        if( !closing.empty() )
+        {
+            closeBars( builder.first, closing );
+        }
+    }
+    if( seconds > 0 )
+    {
+        return closedBars.erase( seconds ) > 0;
+    }
+    if( !closedBars.empty() )
+    {
+        closedBars.clear();
         return true;
     }
     return false;
 }
 
-bool ClientData::updated() const { return openDataLines == updatedLines; }
\ No newline at end of file
+vector<shared_ptr<DataArray>> ClientData::barVectors( long vecId ) const
+{
+    auto vectors = vector<shared_ptr<DataArray>>();
+    auto line = barLines.find( vecId );
+    if( line != barLines.end() )
+    {
+        for( long id : line->second )
+        {
+            auto barVec = DataArrays.find( id );
+            if( barVec != DataArrays.end() )
+            {
+                vectors.push_back( *barVec );
+            }
+        }
+    }
+    return vectors;
+}
+
+void ClientData::streamTick( long vecId, int field, double value )
+{
+    if( !tickStreams.all().empty() )
+    {
+        bool trade = field == 4 || field == 5;
+        bool quote = field == 1 || field == 2;
+        if( ( trade && tickStreams.feeds( vecId, TickKind::Trades ) ) ||
+            ( quote && tickStreams.feeds( vecId, TickKind::Quotes ) ) )
+        {
+            return;
+        }
+    }
+    barTick( vecId, field, value );
+}
+
+void ClientData::barTick( long vecId, int field, double value )
+{
+    auto builder = barBuilders.find( vecId );
+    if( builder == barBuilders.end() )
+    {
+        return;
+    }
+    closing.clear();
+    builder->second.tick( ClientClock::now(), field, value, closing );
+    if( !closing.empty() )
+    {
+        closeBars( vecId, closing );
+    }
+}
+
+void ClientData::closeBars( long vecId, const vector<ClosedBar>& bars )
+{
+    const auto& ids = barLines[vecId];
+    const auto& lengths = barBuilders.at( vecId ).lengths();
+    for( const auto& closed : bars )
+    {
+        auto barVec = DataArrays.find( ids[closed.length] );
+        if( barVec == DataArrays.end() )
+        {
+            continue;
+        }
+        CandleStruct newPoint;
+        newPoint.time = candleTime( closed.bar.start );
+        newPoint.open = closed.bar.open;
+        newPoint.high = closed.bar.high;
+        newPoint.low = closed.bar.low;
+        newPoint.close = closed.bar.close;
+        newPoint.volume = closed.bar.volume;
+        barVec->get()->addPoint( newPoint );
+        closedBars.insert( lengths[closed.length] );
+    }
+}
+
+void ClientData::openBook( const Contract& con, long reqId, int rows, bool smartDepth )
+{
+    addBook( reqId );
+    p_Outbound->send( OutboundLane::MarketData, [client = p_Client, reqId, con, rows, smartDepth]() {
+        client->reqMktDepth( reqId, con, min( rows, BOOK_DEPTH ), smartDepth, TagValueListSPtr() );
+    } );
+}
+
+OrderBook& ClientData::addBook( long reqId ) { return books[reqId]; }
+
+const OrderBook* ClientData::book( long reqId ) const
+{
+    auto found = books.find( reqId );
+    return found != books.end() ? &found->second : nullptr;
+}
+
+void ClientData::updateBook( TickerId reqId, int position, int operation, int side, double price, int size )
+{
+    auto found = books.find( reqId );
+    if( found == books.end() )
+    {
+        spdlog::error( "Received market depth for unknown book " + to_string( reqId ) );
+        return;
+    }
+    if( !found->second.apply( position, operation, side, price, size ) )
+    {
+        spdlog::warn( "Dropped market depth operation " + to_string( operation ) + " at position " +
+                      to_string( position ) + " of book " + to_string( reqId ) );
+    }
+}
+
+bool ClientData::resetBook( long reqId )
+{
+    auto found = books.find( reqId );
+    if( found == books.end() )
+    {
+        return false;
+    }
+    spdlog::warn( "Market depth of book " + to_string( reqId ) + " was reset" );
+    found->second.clear();
+    return true;
+}
+
+void ClientData::streamDepth( int count ) { depthBooks = min( count, MAXIMUM_DEPTH_BOOKS ); }
+
+void ClientData::streamTicks( int slots, const string& root )
+{
+    tickStreams.limit( slots );
+    tickRoot = root;
+    allocateTicks();
+}
+
+void ClientData::openTicks( const Contract& con, long reqId, TickKind kind, int priority, long line )
+{
+    tickStreams.add( reqId, con, kind, priority, line );
+    allocateTicks();
+}
+
+void ClientData::closeTicks( long reqId )
+{
+    auto* stream = tickStreams.find( reqId );
+    if( stream == nullptr )
+    {
+        return;
+    }
+    if( stream->active )
+    {
+        p_Outbound->send( OutboundLane::MarketData,
+                          [client = p_Client, reqId]() { client->cancelTickByTickData( (int)reqId ); } );
+    }
+    writeTicks( *stream, true );
+    tickStreams.remove( reqId );
+    allocateTicks();
+}
+
+void ClientData::ticksRefused( long reqId )
+{
+    if( tickStreams.refuse( reqId ) )
+    {
+        spdlog::warn( "TWS refused tick stream " + to_string( reqId ) + ", keeping " +
+                      to_string( tickStreams.limit() ) + " tick streams open" );
+        allocateTicks();
+    }
+}
+
+const TickStream* ClientData::tickStream( long reqId ) const { return tickStreams.find( reqId ); }
+
+void ClientData::allocateTicks()
+{
+    auto stop = vector<long>();
+    auto start = vector<long>();
+    tickStreams.allocate( stop, start );
+    // free the slots before asking for new ones
+    for( long id : stop )
+    {
+        spdlog::info( "Tick stream " + to_string( id ) + " gave up its slot" );
+        p_Outbound->send( OutboundLane::MarketData,
+                          [client = p_Client, id]() { client->cancelTickByTickData( (int)id ); } );
+    }
+    for( long id : start )
+    {
+        const auto* stream = tickStreams.find( id );
+        spdlog::info( "Requesting tick-by-tick " + string( stream->kind == TickKind::Trades ? "trades" : "quotes" ) +
+                      " of " + stream->contract.symbol + " on stream " + to_string( id ) );
+        p_Outbound->send( OutboundLane::MarketData,
+                          [client = p_Client, id, con = stream->contract, trades = stream->kind == TickKind::Trades]() {
+                              client->reqTickByTickData( (int)id, con, trades ? "AllLast" : "BidAsk", 0, false );
+                          } );
+    }
+}
+
+void ClientData::updateTrade( int reqId, time_t time, double price, int size, const TickAttribLast& attrib )
+{
+    auto flags = ( attrib.pastLimit ? TRADE_PAST_LIMIT : 0 ) | ( attrib.unreported ? TRADE_UNREPORTED : 0 );
+    auto* stream = tickStreams.trade( reqId, (int64_t)time, price, size, flags );
+    if( stream == nullptr )
+    {
+        spdlog::error( "Received tick-by-tick trades for unknown stream " + to_string( reqId ) );
+        return;
+    }
+    // unreported prints are not part of the consolidated tape, bars leave them out
+    if( stream->line != 0 && !attrib.unreported )
+    {
+        barTick( stream->line, 4, price );
+        barTick( stream->line, 5, size );
+    }
+    if( stream->trades.size() >= TICK_FLUSH_ROWS )
+    {
+        writeTicks( *stream );
+    }
+}
+
+void ClientData::updateQuote( int reqId, time_t time, double bidPrice, double askPrice, int bidSize, int askSize )
+{
+    auto* stream = tickStreams.quote( reqId, (int64_t)time, bidPrice, askPrice, bidSize, askSize );
+    if( stream == nullptr )
+    {
+        spdlog::error( "Received tick-by-tick quotes for unknown stream " + to_string( reqId ) );
+        return;
+    }
+    if( stream->line != 0 )
+    {
+        barTick( stream->line, 1, bidPrice );
+        barTick( stream->line, 2, askPrice );
+    }
+    if( stream->quotes.size() >= TICK_FLUSH_ROWS )
+    {
+        writeTicks( *stream );
+    }
+}
+
+void ClientData::writeTicks()
+{
+    for( const auto& entry : tickStreams.all() )
+    {
+        writeTicks( *tickStreams.find( entry.first ), true );
+    }
+}
+
+void ClientData::writeTicks( TickStream& stream, bool merge )
+{
+    auto store = HistoryStore( tickRoot );
+    auto interval = string( stream.kind == TickKind::Trades ? "trades" : "quotes" );
+    if( !stream.trades.empty() || !stream.quotes.empty() )
+    {
+        // a part of its own, the series is not read back on the trading thread
+        bool written = stream.kind == TickKind::Trades
+                           ? store.append( stream.contract.conId, interval, stream.trades )
+                           : store.append( stream.contract.conId, interval, stream.quotes );
+        if( !written )
+        {
+            spdlog::error( "Could not store the ticks of " + stream.contract.symbol + ", keeping them buffered" );
+            return;
+        }
+        stream.trades.clear();
+        stream.quotes.clear();
+    }
+    if( merge && !store.merge( stream.contract.conId, interval ) )
+    {
+        spdlog::error( "Could not merge the ticks of " + stream.contract.symbol + ", leaving them in parts" );
+    }
+}
+
+void ClientData::harvestTicks( int64_t seconds, const string& whatToShow )
+{
+    auto now = (int64_t)time( nullptr );
+    for( const auto& con : stockContracts )
+    {
+        tickBackfill.add( con, now - seconds, now, whatToShow );
+    }
+}
+
+bool ClientData::pageTicks()
+{
+    // tick pages are paced like small bar requests
+    auto now = chrono::steady_clock::now();
+    while( !tickPagesSent.empty() && now - tickPagesSent.front() >= chrono::seconds( PACING_SMALL_BAR_WINDOW ) )
+    {
+        tickPagesSent.pop_front();
+    }
+    if( tickBackfill.ready() && (int)tickPagesSent.size() < PACING_SMALL_BAR_REQUESTS )
+    {
+        auto   reqId = getNextVectorId();
+        auto   con = Contract();
+        string start;
+        string whatToShow;
+        tickBackfill.next( reqId, con, start, whatToShow );
+        p_Outbound->send( OutboundLane::Historical, [client = p_Client, reqId, con, start, whatToShow]() {
+            client->reqHistoricalTicks( (int)reqId, con, start, "", TICK_PAGE_SIZE, whatToShow, 0, false,
+                                        TagValueListSPtr() );
+        } );
+        tickPagesSent.push_back( now );
+    }
+    return !tickBackfill.finished();
+}
+
+void ClientData::updateHistTicks( int reqId, const vector<HistoricalTick>& ticks, bool done )
+{
+    tickBackfill.ticks( reqId, ticks );
+    if( done )
+    {
+        histTicksDone( reqId );
+    }
+}
+
+void ClientData::updateHistTicks( int reqId, const vector<HistoricalTickBidAsk>& ticks, bool done )
+{
+    tickBackfill.ticks( reqId, ticks );
+    if( done )
+    {
+        histTicksDone( reqId );
+    }
+}
+
+void ClientData::updateHistTicks( int reqId, const vector<HistoricalTickLast>& ticks, bool done )
+{
+    tickBackfill.ticks( reqId, ticks );
+    if( done )
+    {
+        histTicksDone( reqId );
+    }
+}
+
+void ClientData::histTicksDone( int reqId )
+{
+    tickBackfill.done( reqId );
+    auto store = HistoryStore( HISTORY_ROOT );
+    tickBackfill.store( store );
+}
+
+bool ClientData::tickPageFailed( long reqId )
+{
+    if( !tickBackfill.contains( reqId ) )
+    {
+        return false;
+    }
+    tickBackfill.failed( reqId );
+    return true;
+}
+
+void ClientData::writeTickBackfill()
+{
+    auto store = HistoryStore( HISTORY_ROOT );
+    auto written = tickBackfill.store( store, true );
+    if( written > 0 )
+    {
+        spdlog::info( "Wrote " + to_string( written ) + " backfilled ticks to the history store at " + HISTORY_ROOT );
+    }
+}
+
+void ClientData::priceOptions( bool local, double rate )
+{
+    localGreeks = local;
+    riskFreeRate = rate;
+}
+
+const OptionChain* ClientData::chain( const string& symbol ) const
+{
+    auto found = chains.find( symbol );
+    return found != chains.end() ? &found->second : nullptr;
+}
+
+void ClientData::chainTick( long vecId, int field, double price )
+{
+    if( !localGreeks )
+    {
+        return;
+    }
+    auto line = chainLines.find( vecId );
+    if( line == chainLines.end() )
+    {
+        return;
+    }
+    auto found = chains.find( line->second );
+    if( found == chains.end() )
+    {
+        return;
+    }
+    auto& optionChain = found->second;
+    auto  now = ClientClock::now();
+    if( optionChain.contains( vecId ) )
+    {
+        // only this option moved, the rest of the chain stays as it is
+        optionChain.quote( vecId, field, price );
+        if( optionChain.solve( vecId, now, riskFreeRate ) )
+        {
+            storeGreeks( optionChain, optionChain.slot( vecId ) );
+        }
+        return;
+    }
+    optionChain.underlying( field, price );
+    if( !optionChain.solve( now, riskFreeRate ) )
+    {
+        return;
+    }
+    for( size_t i = 0; i < optionChain.lines.size(); i++ )
+    {
+        storeGreeks( optionChain, i );
+    }
+}
+
+void ClientData::storeGreeks( const OptionChain& optionChain, size_t slot )
+{
+    auto hold = optionMap.find( optionChain.lines[slot] );
+    if( hold == optionMap.end() )
+    {
+        return;
+    }
+    const auto& bids = optionChain.bids();
+    const auto& asks = optionChain.asks();
+    for( auto* point : { &hold->second.bidAsk, &hold->second.lastTrade } )
+    {
+        point->bidImpliedVol = bids.iv[slot];
+        point->bidDelta = bids.delta[slot];
+        point->bidPvDividend = 0;
+        point->bidGamma = bids.gamma[slot];
+        point->bidVega = bids.vega[slot];
+        point->bidTheta = bids.theta[slot];
+        point->askImpliedVol = asks.iv[slot];
+        point->askDelta = asks.delta[slot];
+        point->askPvDividend = 0;
+        point->askGamma = asks.gamma[slot];
+        point->askVega = asks.vega[slot];
+        point->askTheta = asks.theta[slot];
+    }
+}
+
+void ClientData::initContractVectors()
+{
+    if( !universe.loadConfig( universeConfig ) )
+    {
+        spdlog::critical( "No universe config found at " + universeConfig +
+                          ", no contracts will be requested" );
+    }
+    universe.loadCache( universeCache );
+    for( size_t i = 0; i < universe.entries.size(); i++ )
+    {
+        auto contracts = vector<Contract>();
+        if( universe.cached( universe.entries[i], contracts ) )
+        {
+            addContracts( contracts );
+        }
+        else
+        {
+            resolveEntry( i );
+        }
+    }
+    spdlog::info( "Loaded " + to_string( stockContracts.size() + optionContracts.size() ) +
+                  " contracts from the contract cache, resolving " +
+                  to_string( pendingLookups.size() ) + " universe entries with TWS" );
+}
+
+void ClientData::resolveEntry( size_t index )
+{
+    const auto& entry = universe.entries[index];
+    auto        reqId = getNextVectorId();
+    auto        res = Resolution();
+    res.entry = index;
+    res.stage = entry.secType == "OPT" ? RESOLVE_UNDERLYING : RESOLVE_STOCK;
+    resolutions[reqId] = res;
+    resolved[index] = vector<Contract>();
+    pendingLookups[index] = 1;
+    p_Outbound->send( OutboundLane::Historical,
+                      [client = p_Client, reqId, con = ContractUniverse::underlying( entry )]() {
+                          client->reqContractDetails( (int)reqId, con );
+                      } );
+}
+
+void ClientData::contractResolved( int reqId, const ContractDetails& details )
+{
+    auto res = resolutions.find( reqId );
+    if( res == resolutions.end() )
+    {
+        return;
+    }
+    if( res->second.stage == RESOLVE_OPTIONS &&
+        res->second.strikes.find( details.contract.strike ) == res->second.strikes.end() )
+    {
+        // a lookup without a strike returns the entire expiry, keep only the window
+        return;
+    }
+    res->second.found.push_back( details.contract );
+}
+
+void ClientData::contractResolvedEnd( int reqId )
+{
+    auto search = resolutions.find( reqId );
+    if( search == resolutions.end() )
+    {
+        return;
+    }
+    auto res = search->second;
+    resolutions.erase( search );
+    const auto& entry = universe.entries[res.entry];
+    if( res.stage == RESOLVE_UNDERLYING )
+    {
+        if( res.found.empty() )
+        {
+            spdlog::error( "Could not resolve the underlying of option entry " + entry.symbol );
+            entryResolved( res.entry );
+            return;
+        }
+        // the strike window is centered on the price of the underlying
+        auto priceId = getNextVectorId();
+        auto price = Resolution();
+        price.entry = res.entry;
+        price.stage = RESOLVE_PRICE;
+        price.found.push_back( res.found.front() );
+        resolutions[priceId] = price;
+        p_Outbound->send( OutboundLane::MarketData, [client = p_Client, priceId, con = res.found.front()]() {
+            client->reqMktData( priceId, con, "", true, false, TagValueListSPtr() );
+        } );
+        return;
+    }
+    if( res.found.empty() )
+    {
+        spdlog::error( "TWS returned no contracts for universe entry " + entry.key() );
+    }
+    else if( res.stage == RESOLVE_STOCK )
+    {
+        resolved[res.entry].push_back( res.found.front() );
+    }
+    else
+    {
+        resolved[res.entry].insert( resolved[res.entry].end(), res.found.begin(), res.found.end() );
+    }
+    entryResolved( res.entry );
+}
+
+bool ClientData::underlyingTick( long reqId, int field, double price )
+{
+    auto res = resolutions.find( reqId );
+    if( res == resolutions.end() || res->second.stage != RESOLVE_PRICE )
+    {
+        return false;
+    }
+    // live or delayed last and close
+    if( ( field == 4 || field == 68 ) && price > 0 )
+    {
+        res->second.last = price;
+    }
+    else if( ( field == 9 || field == 75 ) && price > 0 )
+    {
+        res->second.close = price;
+    }
+    return true;
+}
+
+void ClientData::underlyingSnapshotEnd( long reqId )
+{
+    auto search = resolutions.find( reqId );
+    if( search == resolutions.end() || search->second.stage != RESOLVE_PRICE )
+    {
+        return;
+    }
+    auto res = search->second;
+    resolutions.erase( search );
+    auto price = res.last > 0 ? res.last : res.close;
+    if( price <= 0 )
+    {
+        spdlog::warn( "No price for " + res.found.front().symbol +
+                      ", centering its option strikes on the middle of the chain" );
+    }
+    resolveChain( res.entry, res.found.front(), price );
+}
+
+void ClientData::resolveChain( size_t index, const Contract& underlying, double price )
+{
+    auto chainId = getNextVectorId();
+    auto chain = Resolution();
+    chain.entry = index;
+    chain.stage = RESOLVE_CHAIN;
+    chain.last = price;
+    resolutions[chainId] = chain;
+    p_Outbound->send( OutboundLane::Historical,
+                      [client = p_Client, chainId, symbol = underlying.symbol, conId = underlying.conId]() {
+                          client->reqSecDefOptParams( (int)chainId, symbol, "", "STK", (int)conId );
+                      } );
+}
+
+void ClientData::chainResolved( int reqId, const string& exchange, const string& multiplier,
+                                const set<string>& expirations, const set<double>& strikes )
+{
+    auto res = resolutions.find( reqId );
+    if( res == resolutions.end() )
+    {
+        return;
+    }
+    // TWS sends one chain per exchange, prefer the one the entry trades on
+    const auto& entry = universe.entries[res->second.entry];
+    if( res->second.expirations.empty() || exchange == entry.exchange )
+    {
+        res->second.expirations = expirations;
+        res->second.chainStrikes = strikes;
+        res->second.multiplier = multiplier;
+    }
+}
+
+void ClientData::chainResolvedEnd( int reqId )
+{
+    auto search = resolutions.find( reqId );
+    if( search == resolutions.end() )
+    {
+        return;
+    }
+    auto res = search->second;
+    resolutions.erase( search );
+    resolveOptions( res.entry, res );
+}
+
+void ClientData::resolveOptions( size_t index, const Resolution& chain )
+{
+    const auto& entry = universe.entries[index];
+    auto        expiries = ContractUniverse::selectExpiries( entry, chain.expirations );
+    auto        strikes = ContractUniverse::selectStrikes( entry, chain.chainStrikes, chain.last );
+    // the chain lookup itself is done, every expiry and right is a new lookup
+    pendingLookups[index] = 0;
+    if( expiries.empty() || strikes.empty() )
+    {
+        spdlog::error( "Option chain of " + entry.symbol + " has no live expiries or strikes" );
+        pendingLookups[index] = 1;
+        entryResolved( index );
+        return;
+    }
+    for( const auto& expiry : expiries )
+    {
+        for( const auto& right : { "C", "P" } )
+        {
+            Contract con = Contract();
+            con.symbol = entry.symbol;
+            con.secType = "OPT";
+            con.exchange = entry.exchange;
+            con.currency = entry.currency;
+            con.lastTradeDateOrContractMonth = expiry;
+            con.right = right;
+            con.multiplier = chain.multiplier;
+            auto reqId = getNextVectorId();
+            auto res = Resolution();
+            res.entry = index;
+            res.stage = RESOLVE_OPTIONS;
+            res.strikes = strikes;
+            resolutions[reqId] = res;
+            pendingLookups[index]++;
+            p_Outbound->send( OutboundLane::Historical,
+                              [client = p_Client, reqId, con]() { client->reqContractDetails( (int)reqId, con ); } );
+        }
+    }
+}
+
+void ClientData::entryResolved( size_t index )
+{
+    if( --pendingLookups[index] > 0 )
+    {
+        return;
+    }
+    pendingLookups.erase( index );
+    auto contracts = resolved[index];
+    if( failedEntries.erase( index ) > 0 || contracts.empty() )
+    {
+        // a partial or empty answer is not cached, the last good one is used instead
+        if( universe.stale( universe.entries[index], contracts ) )
+        {
+            spdlog::warn( "Using the cached contracts of universe entry " + universe.entries[index].key() );
+        }
+    }
+    else
+    {
+        universe.store( universe.entries[index], contracts );
+    }
+    addContracts( contracts );
+    resolved.erase( index );
+    if( pendingLookups.empty() )
+    {
+        universe.saveCache( universeCache );
+        finishInit();
+    }
+}
+
+bool ClientData::lookupFailed( long reqId )
+{
+    auto search = resolutions.find( reqId );
+    if( search == resolutions.end() )
+    {
+        return false;
+    }
+    if( search->second.stage == RESOLVE_PRICE )
+    {
+        // the chain is still looked up, around its middle
+        underlyingSnapshotEnd( reqId );
+        return true;
+    }
+    spdlog::error( "Universe lookup " + to_string( reqId ) + " for entry " +
+                   universe.entries[search->second.entry].key() + " failed" );
+    failedEntries.insert( search->second.entry );
+    // the lookup ends as one that found nothing
+    search->second.found.clear();
+    search->second.expirations.clear();
+    if( search->second.stage == RESOLVE_CHAIN )
+    {
+        chainResolvedEnd( (int)reqId );
+    }
+    else
+    {
+        contractResolvedEnd( (int)reqId );
+    }
+    return true;
+}
+
+void ClientData::checkLookups()
+{
+    if( pendingLookups.empty() || ClientClock::now() < lookupDeadline )
+    {
+        return;
+    }
+    spdlog::error( "Gave up on " + to_string( resolutions.size() ) + " universe lookups after " +
+                   to_string( RESOLVE_TIMEOUT ) + " s" );
+    // answers that come later find no lookup and are dropped
+    resolutions.clear();
+    auto entries = pendingLookups;
+    for( const auto& entry : entries )
+    {
+        failedEntries.insert( entry.first );
+        pendingLookups[entry.first] = 1;
+        entryResolved( entry.first );
+    }
+}
+
+void ClientData::addContracts( const vector<Contract>& contracts )
+{
+    for( const auto& con : contracts )
+    {
+        if( con.secType == "OPT" )
+        {
+            optionContracts.push_back( con );
+        }
+        else
+        {
+            stockContracts.push_back( con );
+        }
+    }
+}
+
+bool ClientData::updated()
+{
+    if( !updatedLines.empty() )
+    {
+        updatedLines.clear();
+        return true;
+    }
+    return false;
+}
+
+bool ClientData::updated() const { return openDataLines == updatedLines; }
+
+bool ClientData::pending() const { return !updatedLines.empty(); }
\ No newline at end of file
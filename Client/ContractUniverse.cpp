@@ -0,0 +1,330 @@
+#include "ContractUniverse.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <spdlog/spdlog.h>
+
+using namespace std;
+
+/// Magic number at the start of the contract cache, "TBCC"
+constexpr uint32_t CACHE_MAGIC = 0x43434254;
+constexpr uint32_t CACHE_VERSION = 1;
+
+namespace
+{
+    string today()
+    {
+        char   buf[9];
+        time_t now = time( nullptr );
+        strftime( buf, sizeof( buf ), "%Y%m%d", gmtime( &now ) );
+        return string( buf );
+    }
+
+    template <typename T>
+    void put( string& out, T value )
+    {
+        out.append( reinterpret_cast<const char*>( &value ), sizeof( T ) );
+    }
+
+    void putString( string& out, const string& value )
+    {
+        put<uint16_t>( out, (uint16_t)value.size() );
+        out.append( value );
+    }
+
+    /// Bounds checked cursor over the raw cache bytes
+    struct Reader
+    {
+        const char* pos;
+        const char* end;
+        bool        ok = true;
+
+        template <typename T>
+        T get()
+        {
+            T value {};
+            if( end - pos < (ptrdiff_t)sizeof( T ) )
+            {
+                ok = false;
+                return value;
+            }
+            memcpy( &value, pos, sizeof( T ) );
+            pos += sizeof( T );
+            return value;
+        }
+
+        string getString()
+        {
+            auto length = get<uint16_t>();
+            if( !ok || end - pos < length )
+            {
+                ok = false;
+                return string();
+            }
+            string value( pos, length );
+            pos += length;
+            return value;
+        }
+    };
+} // namespace
+
+string UniverseEntry::key() const { return symbol + ":" + secType; }
+
+ContractUniverse::ContractUniverse()
+{
+    entries = vector<UniverseEntry>();
+    cache = map<string, CacheEntry>();
+    ttl = CONTRACT_CACHE_TTL;
+}
+
+bool ContractUniverse::loadConfig( const string& path )
+{
+    ifstream in( path );
+    if( !in.is_open() )
+    {
+        spdlog::error( "Could not open universe config " + path );
+        return false;
+    }
+    string line;
+    int    lineNo = 0;
+    while( getline( in, line ) )
+    {
+        lineNo++;
+        auto comment = line.find( '#' );
+        if( comment != string::npos )
+        {
+            line.erase( comment );
+        }
+        istringstream tokens( line );
+        UniverseEntry entry;
+        if( !( tokens >> entry.secType ) )
+        {
+            continue;
+        }
+        bool valid = false;
+        if( entry.secType == "STK" )
+        {
+            valid = static_cast<bool>( tokens >> entry.symbol >> entry.exchange >> entry.primaryExchange >> entry.currency );
+            string option;
+            if( tokens >> option )
+            {
+                entry.realTime = option == "rtbars";
+                valid = valid && entry.realTime;
+            }
+        }
+        else if( entry.secType == "OPT" )
+        {
+            valid = static_cast<bool>( tokens >> entry.symbol >> entry.exchange >> entry.currency >> entry.expiries >> entry.strikes );
+            tokens >> entry.center;
+        }
+        if( !valid )
+        {
+            spdlog::warn( "Skipping malformed line " + to_string( lineNo ) + " of " + path );
+            continue;
+        }
+        entries.push_back( entry );
+    }
+    spdlog::info( "Loaded " + to_string( entries.size() ) + " universe entries from " + path );
+    return true;
+}
+
+bool ContractUniverse::loadCache( const string& path )
+{
+    ifstream in( path, ios::binary );
+    if( !in.is_open() )
+    {
+        return false;
+    }
+    string raw( ( istreambuf_iterator<char>( in ) ), istreambuf_iterator<char>() );
+    Reader reader { raw.data(), raw.data() + raw.size() };
+    if( reader.get<uint32_t>() != CACHE_MAGIC || reader.get<uint32_t>() != CACHE_VERSION )
+    {
+        spdlog::warn( "Contract cache " + path + " has an unknown format, ignoring it" );
+        return false;
+    }
+    auto                        count = reader.get<uint32_t>();
+    map<string, CacheEntry> loaded;
+    for( uint32_t i = 0; i < count && reader.ok; i++ )
+    {
+        auto       key = reader.getString();
+        CacheEntry entry;
+        entry.written = reader.get<int64_t>();
+        auto size = reader.get<uint32_t>();
+        for( uint32_t j = 0; j < size && reader.ok; j++ )
+        {
+            Contract con;
+            con.conId = (long)reader.get<int64_t>();
+            con.strike = reader.get<double>();
+            con.symbol = reader.getString();
+            con.secType = reader.getString();
+            con.lastTradeDateOrContractMonth = reader.getString();
+            con.right = reader.getString();
+            con.multiplier = reader.getString();
+            con.exchange = reader.getString();
+            con.primaryExchange = reader.getString();
+            con.currency = reader.getString();
+            con.localSymbol = reader.getString();
+            con.tradingClass = reader.getString();
+            entry.contracts.push_back( con );
+        }
+        loaded[key] = entry;
+    }
+    if( !reader.ok )
+    {
+        spdlog::warn( "Contract cache " + path + " is truncated, ignoring it" );
+        return false;
+    }
+    cache = move( loaded );
+    return true;
+}
+
+bool ContractUniverse::saveCache( const string& path ) const
+{
+    string out;
+    put<uint32_t>( out, CACHE_MAGIC );
+    put<uint32_t>( out, CACHE_VERSION );
+    put<uint32_t>( out, (uint32_t)cache.size() );
+    for( const auto& entry : cache )
+    {
+        putString( out, entry.first );
+        put<int64_t>( out, entry.second.written );
+        put<uint32_t>( out, (uint32_t)entry.second.contracts.size() );
+        for( const auto& con : entry.second.contracts )
+        {
+            put<int64_t>( out, (int64_t)con.conId );
+            put<double>( out, con.strike );
+            putString( out, con.symbol );
+            putString( out, con.secType );
+            putString( out, con.lastTradeDateOrContractMonth );
+            putString( out, con.right );
+            putString( out, con.multiplier );
+            putString( out, con.exchange );
+            putString( out, con.primaryExchange );
+            putString( out, con.currency );
+            putString( out, con.localSymbol );
+            putString( out, con.tradingClass );
+        }
+    }
+    ofstream file( path, ios::binary | ios::trunc );
+    if( !file.is_open() )
+    {
+        spdlog::error( "Could not write contract cache " + path );
+        return false;
+    }
+    file.write( out.data(), (streamsize)out.size() );
+    return file.good();
+}
+
+bool ContractUniverse::cached( const UniverseEntry& entry, vector<Contract>& contracts ) const
+{
+    auto hit = cache.find( entry.key() );
+    if( hit == cache.end() || hit->second.contracts.empty() )
+    {
+        return false;
+    }
+    if( time( nullptr ) - hit->second.written > ttl )
+    {
+        return false;
+    }
+    // an option chain with an expired contract has to be regenerated
+    auto now = today();
+    for( const auto& con : hit->second.contracts )
+    {
+        if( con.secType == "OPT" && con.lastTradeDateOrContractMonth < now )
+        {
+            return false;
+        }
+    }
+    contracts = hit->second.contracts;
+    return true;
+}
+
+bool ContractUniverse::stale( const UniverseEntry& entry, vector<Contract>& contracts ) const
+{
+    auto hit = cache.find( entry.key() );
+    if( hit == cache.end() )
+    {
+        return false;
+    }
+    auto now = today();
+    contracts.clear();
+    for( const auto& con : hit->second.contracts )
+    {
+        if( con.secType != "OPT" || con.lastTradeDateOrContractMonth >= now )
+        {
+            contracts.push_back( con );
+        }
+    }
+    return !contracts.empty();
+}
+
+void ContractUniverse::store( const UniverseEntry& entry, const vector<Contract>& contracts )
+{
+    cache[entry.key()] = CacheEntry { (int64_t)time( nullptr ), contracts };
+}
+
+vector<Contract> ContractUniverse::contracts() const
+{
+    auto all = vector<Contract>();
+    for( const auto& entry : cache )
+    {
+        all.insert( all.end(), entry.second.contracts.begin(), entry.second.contracts.end() );
+    }
+    return all;
+}
+
+Contract ContractUniverse::underlying( const UniverseEntry& entry )
+{
+    Contract con = Contract();
+    con.symbol = entry.symbol;
+    con.secType = "STK";
+    con.currency = entry.currency;
+    con.exchange = "SMART";
+    if( entry.secType == "STK" )
+    {
+        con.exchange = entry.exchange;
+        con.primaryExchange = entry.primaryExchange;
+    }
+    return con;
+}
+
+vector<string> ContractUniverse::selectExpiries( const UniverseEntry& entry,
+                                                 const set<string>&   expirations )
+{
+    vector<string> selected;
+    auto           now = today();
+    for( const auto& expiry : expirations )
+    {
+        if( (int)selected.size() >= entry.expiries )
+        {
+            break;
+        }
+        if( expiry >= now )
+        {
+            selected.push_back( expiry );
+        }
+    }
+    return selected;
+}
+
+set<double> ContractUniverse::selectStrikes( const UniverseEntry& entry, const set<double>& strikes, double price )
+{
+    if( strikes.empty() )
+    {
+        return set<double>();
+    }
+    double center = entry.center > 0 ? entry.center : price;
+    if( center <= 0 )
+    {
+        center = *next( strikes.begin(), (long)strikes.size() / 2 );
+    }
+    vector<double> sorted( strikes.begin(), strikes.end() );
+    auto           count = min( (size_t)max( entry.strikes, 0 ), sorted.size() );
+    partial_sort( sorted.begin(), sorted.begin() + (long)count, sorted.end(),
+                  [center]( double a, double b ) { return abs( a - center ) < abs( b - center ); } );
+    return set<double>( sorted.begin(), sorted.begin() + (long)count );
+}
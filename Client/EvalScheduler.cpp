@@ -0,0 +1,113 @@
+#include "EvalScheduler.h"
+#include "ClientClock.h"
+#include "ClientData.h"
+#include <cstdlib>
+
+using namespace std;
+
+constexpr int64_t NS_PER_MS = 1000000;
+
+EvalScheduler::EvalScheduler() : EvalScheduler( EvalMode::EveryTick, 0 ) {}
+
+EvalScheduler::EvalScheduler( EvalMode newMode, int newPeriod )
+{
+    evalMode = newMode;
+    period = newPeriod;
+    last = 0;
+    next = 0;
+    count = 0;
+}
+
+bool EvalScheduler::due( ClientData& data )
+{
+    bool run = false;
+    switch( evalMode )
+    {
+        case EvalMode::EveryTick:
+            run = data.updated();
+            break;
+
+        case EvalMode::BarClose:
+            if( data.barsClosed( period ) )
+            {
+                // the ticks inside the bar are already part of it
+                data.updated();
+                run = true;
+            }
+            break;
+
+        case EvalMode::Timer:
+        {
+            auto now = ClientClock::now();
+            if( now >= next )
+            {
+                // a late check does not bunch up the evaluations it missed
+                auto span = (int64_t)period * NS_PER_MS;
+                next = span > 0 ? now - now % span + span : now;
+                data.updated();
+                run = true;
+            }
+            break;
+        }
+
+        case EvalMode::Coalesced:
+        {
+            auto now = ClientClock::now();
+            if( data.pending() && now - last >= (int64_t)period * NS_PER_MS )
+            {
+                last = now;
+                data.updated();
+                run = true;
+            }
+            break;
+        }
+    }
+    if( run )
+    {
+        count++;
+    }
+    return run;
+}
+
+EvalMode EvalScheduler::mode() const { return evalMode; }
+
+int EvalScheduler::interval() const { return period; }
+
+size_t EvalScheduler::evaluations() const { return count; }
+
+bool EvalScheduler::parse( const string& text, EvalScheduler& scheduler )
+{
+    if( text == "tick" )
+    {
+        scheduler = EvalScheduler();
+        return true;
+    }
+    auto colon = text.find( ':' );
+    if( colon == string::npos )
+    {
+        return false;
+    }
+    auto name = text.substr( 0, colon );
+    int  value = atoi( text.c_str() + colon + 1 );
+    if( value <= 0 )
+    {
+        return false;
+    }
+    if( name == "bar" )
+    {
+        scheduler = EvalScheduler( EvalMode::BarClose, value );
+    }
+    else if( name == "timer" )
+    {
+        scheduler = EvalScheduler( EvalMode::Timer, value );
+    }
+    else if( name == "coalesce" )
+    {
+        scheduler = EvalScheduler( EvalMode::Coalesced, value );
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,249 @@
+#include "FlightRecorder.h"
+#include "ClientClock.h"
+#include "RiskEngine.h"
+#include "StateTable.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+using namespace std;
+
+/// Magic number at the start of a flight dump, "TBFR"
+constexpr uint32_t FLIGHT_MAGIC = 0x52464254;
+constexpr uint32_t FLIGHT_VERSION = 1;
+
+/// Statuses of orderStatus, numbered by their position
+constexpr const char* ORDER_STATUSES[] = { "ApiPending", "PendingSubmit", "PendingCancel", "PreSubmitted", "Submitted",
+                                           "ApiCancelled", "Cancelled",     "Filled",        "Inactive" };
+
+namespace
+{
+    struct FlightHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t rings;
+        uint32_t records;
+    };
+    /// Precedes the records of each ring
+    struct RingHeader
+    {
+        uint32_t thread;
+        uint32_t recordSize;
+        uint64_t written;
+    };
+    static_assert( sizeof( FlightRecord ) == 32, "flight records must stay 32 bytes" );
+    static_assert( ( FLIGHT_RECORDS & ( FLIGHT_RECORDS - 1 ) ) == 0, "FLIGHT_RECORDS must be a power of two" );
+
+    struct FlightRing
+    {
+        array<FlightRecord, FLIGHT_RECORDS> records;
+        atomic<uint64_t>                    written;
+        uint16_t                            thread;
+    };
+
+    /// Rings of every thread that has recorded, never freed so a dump can read them at any time
+    array<atomic<FlightRing*>, FLIGHT_THREADS> rings;
+    atomic<size_t>                             ringCount( 0 );
+    /// Path of the dump, set once by install
+    char         dumpPath[256];
+    atomic<bool> installed( false );
+    atomic<bool> dumping( false );
+
+    FlightRing* makeRing()
+    {
+        auto index = ringCount.fetch_add( 1 );
+        if( index >= FLIGHT_THREADS )
+        {
+            return nullptr;
+        }
+        auto* ring = new FlightRing();
+        ring->written.store( 0 );
+        ring->thread = (uint16_t)index;
+        rings[index].store( ring, memory_order_release );
+        return ring;
+    }
+
+    FlightRing* threadRing()
+    {
+        thread_local FlightRing* ring = makeRing();
+        return ring;
+    }
+
+    /// write until everything is out, false on an error
+    bool writeAll( int fd, const void* data, size_t size )
+    {
+        auto* bytes = (const char*)data;
+        while( size > 0 )
+        {
+            auto n = ::write( fd, bytes, size );
+            if( n <= 0 )
+            {
+                return false;
+            }
+            bytes += n;
+            size -= (size_t)n;
+        }
+        return true;
+    }
+
+    void crashed( int signal )
+    {
+        FlightRecorder::dump();
+        ::signal( signal, SIG_DFL );
+        raise( signal );
+    }
+
+    void dumpAtExit() { FlightRecorder::dump(); }
+} // namespace
+
+void FlightRecorder::record( FlightEvent event, int32_t id, int32_t field, double value )
+{
+    auto* ring = threadRing();
+    if( ring == nullptr )
+    {
+        return;
+    }
+    auto  written = ring->written.load( memory_order_relaxed );
+    auto& r = ring->records[written & ( FLIGHT_RECORDS - 1 )];
+    r.time = ClientClock::now();
+    r.value = value;
+    r.id = id;
+    r.field = field;
+    r.event = (uint16_t)event;
+    r.thread = ring->thread;
+    ring->written.store( written + 1, memory_order_relaxed );
+}
+
+void FlightRecorder::install( const string& path )
+{
+    strncpy( dumpPath, path.c_str(), sizeof( dumpPath ) - 1 );
+    if( installed.exchange( true ) )
+    {
+        return;
+    }
+    signal( SIGSEGV, crashed );
+    signal( SIGABRT, crashed );
+    atexit( dumpAtExit );
+}
+
+void FlightRecorder::dump()
+{
+    if( !installed.load() || dumping.exchange( true ) )
+    {
+        return;
+    }
+    int fd = ::open( dumpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd >= 0 )
+    {
+        // a ring registered but not stored yet ends the dump, it has nothing in it
+        size_t count = 0;
+        while( count < min( ringCount.load(), FLIGHT_THREADS ) && rings[count].load( memory_order_acquire ) != nullptr )
+        {
+            count++;
+        }
+        FlightHeader h { FLIGHT_MAGIC, FLIGHT_VERSION, (uint32_t)count, (uint32_t)FLIGHT_RECORDS };
+        bool         ok = writeAll( fd, &h, sizeof( h ) );
+        for( size_t i = 0; i < count && ok; i++ )
+        {
+            auto*      ring = rings[i].load( memory_order_acquire );
+            RingHeader r { ring->thread, sizeof( FlightRecord ), ring->written.load( memory_order_relaxed ) };
+            ok = writeAll( fd, &r, sizeof( r ) ) && writeAll( fd, ring->records.data(), sizeof( ring->records ) );
+        }
+        ::close( fd );
+    }
+    dumping.store( false );
+}
+
+bool FlightRecorder::load( const string& path, vector<FlightRecord>& records )
+{
+    records.clear();
+    int fd = ::open( path.c_str(), O_RDONLY );
+    if( fd < 0 )
+    {
+        return false;
+    }
+    FlightHeader h {};
+    bool ok = ::read( fd, &h, sizeof( h ) ) == (ssize_t)sizeof( h ) && h.magic == FLIGHT_MAGIC &&
+              h.version == FLIGHT_VERSION && h.records > 0 && ( h.records & ( h.records - 1 ) ) == 0;
+    auto ring = vector<FlightRecord>( ok ? h.records : 0 );
+    for( uint32_t i = 0; ok && i < h.rings; i++ )
+    {
+        RingHeader r {};
+        auto       size = ring.size() * sizeof( FlightRecord );
+        ok = ::read( fd, &r, sizeof( r ) ) == (ssize_t)sizeof( r ) && r.recordSize == sizeof( FlightRecord ) &&
+             ::read( fd, ring.data(), size ) == (ssize_t)size;
+        // the oldest record is the one the next write would replace
+        auto first = r.written > h.records ? r.written - h.records : 0;
+        for( auto n = first; ok && n < r.written; n++ )
+        {
+            records.push_back( ring[n & ( h.records - 1 )] );
+        }
+    }
+    ::close( fd );
+    if( !ok )
+    {
+        spdlog::error( "Flight dump " + path + " is corrupt" );
+        records.clear();
+        return false;
+    }
+    stable_sort( records.begin(), records.end(),
+                 []( const FlightRecord& a, const FlightRecord& b ) { return a.time < b.time; } );
+    return true;
+}
+
+string FlightRecorder::describe( const FlightRecord& r )
+{
+    auto head = to_string( r.time ) + " thread " + to_string( r.thread ) + " ";
+    switch( (FlightEvent)r.event )
+    {
+        case FlightEvent::State:
+            return head + "state " + ClientSpace::stateName( (ClientSpace::State)r.id ) + " -> " +
+                   ClientSpace::stateName( (ClientSpace::State)r.field );
+        case FlightEvent::TickPrice:
+            return head + "tickPrice " + to_string( r.id ) + " type " + to_string( r.field ) + " price " +
+                   to_string( r.value );
+        case FlightEvent::TickSize:
+            return head + "tickSize " + to_string( r.id ) + " type " + to_string( r.field ) + " size " +
+                   to_string( r.value );
+        case FlightEvent::OrderStatus:
+            return head + "orderStatus " + to_string( r.id ) + " " +
+                   ( r.field >= 0 && r.field < (int32_t)size( ORDER_STATUSES ) ? ORDER_STATUSES[r.field] : "unknown" ) +
+                   " filled " + to_string( r.value );
+        case FlightEvent::Execution:
+            return head + "execDetails order " + to_string( r.id ) + " req " + to_string( r.field ) + " shares " +
+                   to_string( r.value );
+        case FlightEvent::OrderPlaced:
+            return head + "placeOrder " + to_string( r.id ) + ( r.field > 0 ? " BUY " : " SELL " ) +
+                   to_string( r.value );
+        case FlightEvent::Error:
+            return head + "error " + to_string( r.id ) + " code " + to_string( r.field );
+        case FlightEvent::Disconnect:
+            return head + "connection closed";
+        case FlightEvent::OrderRejected:
+            return head + "rejected order " + to_string( r.id ) + " " +
+                   RiskEngine::name( (RiskVerdict)r.field ) + " " + to_string( r.value );
+        case FlightEvent::OptionComputation:
+            return head + "tickOptionComputation " + to_string( r.id ) + " type " + to_string( r.field ) + " iv " +
+                   to_string( r.value );
+    }
+    return head + "unknown event " + to_string( r.event );
+}
+
+int32_t FlightRecorder::orderStatus( const string& status )
+{
+    for( size_t i = 0; i < size( ORDER_STATUSES ); i++ )
+    {
+        if( status == ORDER_STATUSES[i] )
+        {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,226 @@
+#include "HarvestPlanner.h"
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <spdlog/spdlog.h>
+
+using namespace std;
+
+constexpr int64_t SECONDS_PER_DAY = 24 * 60 * 60;
+
+bool HarvestCatalog::load( const string& path )
+{
+    ifstream in( path );
+    if( !in.is_open() )
+    {
+        return false;
+    }
+    string line;
+    while( getline( in, line ) )
+    {
+        auto tab = line.find( '\t' );
+        if( tab == string::npos )
+        {
+            continue;
+        }
+        istringstream range( line.substr( tab + 1 ) );
+        TimeRange     r;
+        if( range >> r.first >> r.second )
+        {
+            insert( line.substr( 0, tab ), r );
+        }
+    }
+    return true;
+}
+
+bool HarvestCatalog::save( const string& path ) const
+{
+    ofstream out( path, ios::trunc );
+    if( !out.is_open() )
+    {
+        spdlog::error( "Could not write harvest catalog " + path );
+        return false;
+    }
+    for( const auto& entry : series )
+    {
+        for( const auto& r : entry.second )
+        {
+            out << entry.first << '\t' << r.first << ' ' << r.second << '\n';
+        }
+    }
+    return out.good();
+}
+
+string HarvestCatalog::key( const HistRequest& req )
+{
+    string bar = req.barSize;
+    bar.erase( remove( bar.begin(), bar.end(), ' ' ), bar.end() );
+    return to_string( req.contract.conId ) + "|" + bar + "|" + req.whatToShow;
+}
+
+void HarvestCatalog::add( const HistRequest& req, TimeRange r, int64_t now )
+{
+    r.second = min( r.second, HarvestPlanner::lastClose( req.barSize, now ) );
+    if( r.second > r.first )
+    {
+        insert( key( req ), r );
+    }
+}
+
+void HarvestCatalog::insert( const string& name, TimeRange r )
+{
+    auto& ranges = series[name];
+    ranges.push_back( r );
+    sort( ranges.begin(), ranges.end() );
+    auto merged = vector<TimeRange>();
+    for( const auto& next : ranges )
+    {
+        if( !merged.empty() && next.first <= merged.back().second )
+        {
+            merged.back().second = max( merged.back().second, next.second );
+        }
+        else
+        {
+            merged.push_back( next );
+        }
+    }
+    ranges = move( merged );
+}
+
+const vector<TimeRange>& HarvestCatalog::covered( const HistRequest& req ) const
+{
+    static const vector<TimeRange> none;
+    auto                           entry = series.find( key( req ) );
+    return entry == series.end() ? none : entry->second;
+}
+
+HarvestPlanner::HarvestPlanner( const HarvestCatalog& newCatalog ) : catalog( newCatalog ) {}
+
+vector<HistRequest> HarvestPlanner::plan( const vector<HistRequest>& windows, int64_t now ) const
+{
+    auto requests = vector<HistRequest>();
+    for( const auto& window : windows )
+    {
+        auto length = durationSeconds( window.duration );
+        auto bar = barSeconds( window.barSize );
+        auto start = now - length;
+        // walk the covered ranges and collect everything between them
+        auto gaps = vector<TimeRange>();
+        for( const auto& r : catalog.covered( window ) )
+        {
+            if( r.second <= start )
+            {
+                continue;
+            }
+            if( r.first >= now )
+            {
+                break;
+            }
+            if( r.first > start )
+            {
+                gaps.emplace_back( start, r.first );
+            }
+            start = max( start, r.second );
+        }
+        if( start < now )
+        {
+            gaps.emplace_back( start, now );
+        }
+        for( const auto& gap : gaps )
+        {
+            // anything shorter than a bar can't hold a new bar
+            if( gap.second - gap.first < bar )
+            {
+                continue;
+            }
+            for( auto end = gap.second; end > gap.first; end -= length )
+            {
+                auto req = window;
+                req.windowEnd = end;
+                req.windowStart = max( gap.first, end - length );
+                req.duration = durationString( req.windowEnd - req.windowStart );
+                req.endDateTime = endDateTime( req.windowEnd );
+                requests.push_back( req );
+            }
+        }
+    }
+    spdlog::info( "Harvest plan needs " + to_string( requests.size() ) + " requests to fill " +
+                  to_string( windows.size() ) + " windows" );
+    return requests;
+}
+
+int64_t HarvestPlanner::durationSeconds( const string& duration )
+{
+    istringstream in( duration );
+    int64_t       count = 0;
+    string        unit;
+    in >> count >> unit;
+    switch( unit.empty() ? 'S' : unit[0] )
+    {
+        case 'D':
+            return count * SECONDS_PER_DAY;
+        case 'W':
+            return count * 7 * SECONDS_PER_DAY;
+        case 'M':
+            return count * 30 * SECONDS_PER_DAY;
+        case 'Y':
+            return count * 365 * SECONDS_PER_DAY;
+        default:
+            return count;
+    }
+}
+
+int64_t HarvestPlanner::barSeconds( const string& barSize )
+{
+    istringstream in( barSize );
+    int64_t       count = 0;
+    string        unit;
+    in >> count >> unit;
+    if( unit.rfind( "sec", 0 ) == 0 )
+    {
+        return count;
+    }
+    if( unit.rfind( "min", 0 ) == 0 )
+    {
+        return count * 60;
+    }
+    if( unit.rfind( "hour", 0 ) == 0 )
+    {
+        return count * 60 * 60;
+    }
+    if( unit.rfind( "day", 0 ) == 0 )
+    {
+        return count * SECONDS_PER_DAY;
+    }
+    if( unit.rfind( "week", 0 ) == 0 )
+    {
+        return count * 7 * SECONDS_PER_DAY;
+    }
+    return count * 30 * SECONDS_PER_DAY;
+}
+
+int64_t HarvestPlanner::lastClose( const string& barSize, int64_t now )
+{
+    // bars are taken as aligned to the epoch, days to midnight UTC
+    auto bar = max( barSeconds( barSize ), (int64_t)1 );
+    return now - now % bar;
+}
+
+string HarvestPlanner::durationString( int64_t seconds )
+{
+    // second durations are only accepted up to one day
+    if( seconds <= SECONDS_PER_DAY )
+    {
+        return to_string( max<int64_t>( seconds, 1 ) ) + " S";
+    }
+    return to_string( ( seconds + SECONDS_PER_DAY - 1 ) / SECONDS_PER_DAY ) + " D";
+}
+
+string HarvestPlanner::endDateTime( int64_t epoch )
+{
+    char   buf[32];
+    time_t t = (time_t)epoch;
+    strftime( buf, sizeof( buf ), "%Y%m%d %H:%M:%S GMT", gmtime( &t ) );
+    return string( buf );
+}
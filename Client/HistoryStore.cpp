@@ -0,0 +1,707 @@
+#include "HistoryStore.h"
+#include "SeriesCodec.h"
+#include "TimeParser.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/// Magic number at the start of a segment, "TBHS"
+constexpr uint32_t SEGMENT_MAGIC = 0x53484254;
+constexpr uint32_t SEGMENT_VERSION = 1;
+/// Magic number at the start of a compacted segment, "TBHZ"
+constexpr uint32_t COMPACT_MAGIC = 0x5A484254;
+constexpr uint32_t COMPACT_VERSION = 1;
+constexpr int64_t  NANOS = 1000000000;
+
+namespace
+{
+    vector<RawRow> rawRows( const vector<TradeRow>& trades )
+    {
+        auto rows = vector<RawRow>( trades.size() );
+        for( size_t i = 0; i < trades.size(); i++ )
+        {
+            rows[i].time = trades[i].time;
+            memcpy( &rows[i].values[0], &trades[i].price, sizeof( uint64_t ) );
+            memcpy( &rows[i].values[1], &trades[i].size, sizeof( uint64_t ) );
+            memcpy( &rows[i].values[2], &trades[i].flags, sizeof( uint64_t ) );
+        }
+        return rows;
+    }
+
+    vector<RawRow> rawRows( const vector<QuoteRow>& quotes )
+    {
+        auto rows = vector<RawRow>( quotes.size() );
+        for( size_t i = 0; i < quotes.size(); i++ )
+        {
+            rows[i].time = quotes[i].time;
+            memcpy( &rows[i].values[0], &quotes[i].bidPrice, sizeof( uint64_t ) );
+            memcpy( &rows[i].values[1], &quotes[i].askPrice, sizeof( uint64_t ) );
+            memcpy( &rows[i].values[2], &quotes[i].bidSize, sizeof( uint64_t ) );
+            memcpy( &rows[i].values[3], &quotes[i].askSize, sizeof( uint64_t ) );
+        }
+        return rows;
+    }
+
+    /// Fixed 64 byte header at the start of every segment
+    struct SegmentHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t kind;
+        uint32_t columns;
+        uint64_t rows;
+        uint64_t indexStride;
+        int64_t  conId;
+        uint64_t indexOffset;
+        char     interval[16];
+    };
+    static_assert( sizeof( SegmentHeader ) == 64, "segment header must stay 64 bytes" );
+
+    /// Fixed 64 byte header of a compacted segment, followed by the block directory and the blocks
+    struct CompactHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t kind;
+        uint32_t columns;
+        uint64_t rows;
+        uint64_t blocks;
+        int64_t  conId;
+        uint64_t dataOffset;
+        char     interval[16];
+    };
+    static_assert( sizeof( CompactHeader ) == 64, "compacted segment header must stay 64 bytes" );
+
+    const SegmentHeader* head( const void* header )
+    {
+        return static_cast<const SegmentHeader*>( header );
+    }
+
+    uint64_t indexEntries( uint64_t rows, uint64_t stride )
+    {
+        return ( rows + stride - 1 ) / stride;
+    }
+
+    double asDouble( uint64_t raw, ColumnType type )
+    {
+        if( type == ColumnType::Int64 )
+        {
+            int64_t value;
+            memcpy( &value, &raw, sizeof( value ) );
+            return (double)value;
+        }
+        double value;
+        memcpy( &value, &raw, sizeof( value ) );
+        return value;
+    }
+
+    bool writeAll( int fd, const void* data, size_t size )
+    {
+        const auto* pos = static_cast<const uint8_t*>( data );
+        while( size > 0 )
+        {
+            auto written = ::write( fd, pos, size );
+            if( written <= 0 )
+            {
+                return false;
+            }
+            pos += written;
+            size -= (size_t)written;
+        }
+        return true;
+    }
+} // namespace
+
+const SeriesSchema& SeriesSchema::get( SeriesKind kind )
+{
+    static const SeriesSchema bars { SeriesKind::Bars,
+                                     { ColumnType::Int64, ColumnType::Double, ColumnType::Double, ColumnType::Double, ColumnType::Double, ColumnType::Int64 },
+                                     { "time", "open", "high", "low", "close", "volume" } };
+    static const SeriesSchema snaps { SeriesKind::Snaps,
+                                      { ColumnType::Int64, ColumnType::Double, ColumnType::Double, ColumnType::Int64, ColumnType::Int64 },
+                                      { "time", "bidPrice", "askPrice", "bidSize", "askSize" } };
+    static const SeriesSchema trades { SeriesKind::Trades,
+                                       { ColumnType::Int64, ColumnType::Double, ColumnType::Int64, ColumnType::Int64 },
+                                       { "time", "price", "size", "flags" } };
+    switch( kind )
+    {
+        case SeriesKind::Snaps:
+            return snaps;
+        case SeriesKind::Trades:
+            return trades;
+        default:
+            return bars;
+    }
+}
+
+Segment::~Segment() { close(); }
+
+bool Segment::open( const string& path )
+{
+    close();
+    int fd = ::open( path.c_str(), O_RDONLY );
+    if( fd < 0 )
+    {
+        return false;
+    }
+    struct stat info
+    {
+    };
+    if( fstat( fd, &info ) != 0 || (size_t)info.st_size < sizeof( SegmentHeader ) )
+    {
+        ::close( fd );
+        return false;
+    }
+    void* map = mmap( nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    // the mapping keeps the file alive
+    ::close( fd );
+    if( map == MAP_FAILED )
+    {
+        return false;
+    }
+    base = static_cast<const uint8_t*>( map );
+    length = (size_t)info.st_size;
+    header = base;
+    const auto* h = head( header );
+    auto        entries = indexEntries( h->rows, h->indexStride );
+    auto        footerSize = h->columns * sizeof( ColumnStats );
+    if( h->magic != SEGMENT_MAGIC || h->version != SEGMENT_VERSION || h->columns == 0 ||
+        h->columns > STORE_MAX_COLUMNS || h->indexStride == 0 ||
+        h->indexOffset != sizeof( SegmentHeader ) + h->rows * h->columns * sizeof( int64_t ) ||
+        h->indexOffset + entries * sizeof( int64_t ) + footerSize > length )
+    {
+        spdlog::error( "History segment " + path + " is corrupt" );
+        close();
+        return false;
+    }
+    index = reinterpret_cast<const int64_t*>( base + h->indexOffset );
+    footer = reinterpret_cast<const ColumnStats*>( index + entries );
+    // scans walk the columns front to back
+    madvise( map, length, MADV_SEQUENTIAL );
+    return true;
+}
+
+void Segment::close()
+{
+    if( base != nullptr )
+    {
+        munmap( const_cast<uint8_t*>( base ), length );
+    }
+    base = nullptr;
+    header = nullptr;
+    index = nullptr;
+    footer = nullptr;
+    length = 0;
+}
+
+SeriesKind Segment::kind() const { return (SeriesKind)head( header )->kind; }
+
+size_t Segment::rows() const { return header != nullptr ? head( header )->rows : 0; }
+
+size_t Segment::columns() const { return head( header )->columns; }
+
+long Segment::conId() const { return (long)head( header )->conId; }
+
+string Segment::interval() const
+{
+    const auto* h = head( header );
+    return string( h->interval, strnlen( h->interval, sizeof( h->interval ) ) );
+}
+
+const int64_t* Segment::times() const { return ints( 0 ); }
+
+const int64_t* Segment::ints( size_t column ) const
+{
+    return reinterpret_cast<const int64_t*>( base + sizeof( SegmentHeader ) ) + column * rows();
+}
+
+const double* Segment::doubles( size_t column ) const
+{
+    return reinterpret_cast<const double*>( base + sizeof( SegmentHeader ) ) + column * rows();
+}
+
+const ColumnStats& Segment::stats( size_t column ) const { return footer[column]; }
+
+RowRange Segment::range( int64_t from, int64_t to ) const
+{
+    auto        n = rows();
+    const auto* h = head( header );
+    const auto* t = times();
+    auto        entries = indexEntries( n, h->indexStride );
+    // the index narrows the search down to one stride of rows for each bound
+    auto bound = [&]( int64_t value ) -> size_t {
+        auto   block = lower_bound( index, index + entries, value ) - index;
+        size_t lo = block == 0 ? 0 : ( block - 1 ) * h->indexStride;
+        size_t hi = min<size_t>( n, (size_t)block * h->indexStride );
+        return (size_t)( lower_bound( t + lo, t + hi, value ) - t );
+    };
+    auto begin = bound( from );
+    auto end = max( begin, bound( to ) );
+    return RowRange { begin, end };
+}
+
+vector<RawRow> Segment::raw( RowRange r ) const
+{
+    auto out = vector<RawRow>( r.size() );
+    auto cols = columns();
+    for( size_t i = 0; i < r.size(); i++ )
+    {
+        out[i].time = times()[r.begin + i];
+        for( size_t c = 1; c < cols; c++ )
+        {
+            memcpy( &out[i].values[c - 1], ints( c ) + r.begin + i, sizeof( uint64_t ) );
+        }
+    }
+    return out;
+}
+
+vector<BarRow> Segment::bars( RowRange r ) const
+{
+    if( kind() != SeriesKind::Bars )
+    {
+        return vector<BarRow>();
+    }
+    auto out = vector<BarRow>( r.size() );
+    const auto* t = times();
+    const auto* open = doubles( 1 );
+    const auto* high = doubles( 2 );
+    const auto* low = doubles( 3 );
+    const auto* close = doubles( 4 );
+    const auto* volume = ints( 5 );
+    for( size_t i = r.begin; i < r.end; i++ )
+    {
+        out[i - r.begin] = BarRow { t[i], open[i], high[i], low[i], close[i], volume[i] };
+    }
+    return out;
+}
+
+HistoryStore::HistoryStore( string newRoot ) : root( move( newRoot ) ) {}
+
+string HistoryStore::path( long conId, const string& interval ) const
+{
+    return root + "/" + to_string( conId ) + "/" + interval + ".seg";
+}
+
+string HistoryStore::compactPath( long conId, const string& interval ) const { return path( conId, interval ) + "z"; }
+
+string HistoryStore::partPath( long conId, const string& interval, int64_t first ) const
+{
+    return root + "/" + to_string( conId ) + "/" + interval + "." + to_string( first ) + ".part";
+}
+
+vector<string> HistoryStore::intervals( long conId ) const
+{
+    auto found = vector<string>();
+    auto dirPath = root + "/" + to_string( conId );
+    DIR* dir = opendir( dirPath.c_str() );
+    if( dir == nullptr )
+    {
+        return found;
+    }
+    while( auto* entry = readdir( dir ) )
+    {
+        string name = entry->d_name;
+        if( name.size() > 4 && name.compare( name.size() - 4, 4, ".seg" ) == 0 )
+        {
+            found.push_back( name.substr( 0, name.size() - 4 ) );
+        }
+        else if( name.size() > 5 && name.compare( name.size() - 5, 5, ".segz" ) == 0 )
+        {
+            found.push_back( name.substr( 0, name.size() - 5 ) );
+        }
+    }
+    closedir( dir );
+    sort( found.begin(), found.end() );
+    found.erase( unique( found.begin(), found.end() ), found.end() );
+    return found;
+}
+
+vector<long> HistoryStore::conIds() const
+{
+    auto found = vector<long>();
+    DIR* dir = opendir( root.c_str() );
+    if( dir == nullptr )
+    {
+        return found;
+    }
+    while( auto* entry = readdir( dir ) )
+    {
+        long conId = strtol( entry->d_name, nullptr, 10 );
+        if( conId != 0 && !intervals( conId ).empty() )
+        {
+            found.push_back( conId );
+        }
+    }
+    closedir( dir );
+    sort( found.begin(), found.end() );
+    return found;
+}
+
+unique_ptr<Segment> HistoryStore::open( long conId, const string& interval ) const
+{
+    auto seg = make_unique<Segment>();
+    if( !seg->open( path( conId, interval ) ) )
+    {
+        return nullptr;
+    }
+    return seg;
+}
+
+bool HistoryStore::write( long conId, const string& interval, SeriesKind kind, vector<RawRow> rows )
+{
+    auto cols = SeriesSchema::get( kind ).types.size();
+    // merge with what is stored, new rows first so they win the dedup
+    auto existing = DecodedSeries();
+    if( load( conId, interval, existing ) && existing.kind == kind && existing.columns.size() == cols )
+    {
+        auto first = rows.size();
+        rows.resize( first + existing.rows() );
+        for( size_t i = 0; i < existing.rows(); i++ )
+        {
+            rows[first + i].time = existing.columns[0][i];
+            for( size_t c = 1; c < cols; c++ )
+            {
+                rows[first + i].values[c - 1] = (uint64_t)existing.columns[c][i];
+            }
+        }
+    }
+    existing = DecodedSeries();
+    stable_sort( rows.begin(), rows.end(), []( const RawRow& a, const RawRow& b ) { return a.time < b.time; } );
+    rows.erase( unique( rows.begin(), rows.end(), []( const RawRow& a, const RawRow& b ) { return a.time == b.time; } ),
+                rows.end() );
+
+    auto target = path( conId, interval );
+    if( !writeSegment( target, conId, interval, kind, rows ) )
+    {
+        return false;
+    }
+    // the segment now holds everything the compacted form did
+    unlink( compactPath( conId, interval ).c_str() );
+    return true;
+}
+
+bool HistoryStore::append( long conId, const string& interval, SeriesKind kind, vector<RawRow> rows )
+{
+    if( rows.empty() )
+    {
+        return true;
+    }
+    stable_sort( rows.begin(), rows.end(), []( const RawRow& a, const RawRow& b ) { return a.time < b.time; } );
+    rows.erase( unique( rows.begin(), rows.end(), []( const RawRow& a, const RawRow& b ) { return a.time == b.time; } ),
+                rows.end() );
+    return writeSegment( partPath( conId, interval, rows.front().time ), conId, interval, kind, rows );
+}
+
+bool HistoryStore::merge( long conId, const string& interval )
+{
+    auto dirPath = root + "/" + to_string( conId );
+    auto prefix = interval + ".";
+    auto parts = vector<string>();
+    DIR* dir = opendir( dirPath.c_str() );
+    if( dir == nullptr )
+    {
+        return true;
+    }
+    while( auto* entry = readdir( dir ) )
+    {
+        string name = entry->d_name;
+        if( name.size() > prefix.size() + 5 && name.compare( 0, prefix.size(), prefix ) == 0 &&
+            name.compare( name.size() - 5, 5, ".part" ) == 0 )
+        {
+            parts.push_back( dirPath + "/" + name );
+        }
+    }
+    closedir( dir );
+    if( parts.empty() )
+    {
+        return true;
+    }
+    auto rows = vector<RawRow>();
+    auto kind = SeriesKind::Bars;
+    for( const auto& part : parts )
+    {
+        auto seg = Segment();
+        if( !seg.open( part ) )
+        {
+            spdlog::error( "Could not read history part " + part );
+            return false;
+        }
+        kind = seg.kind();
+        auto partRows = seg.raw( RowRange { 0, seg.rows() } );
+        rows.insert( rows.end(), partRows.begin(), partRows.end() );
+    }
+    if( !write( conId, interval, kind, move( rows ) ) )
+    {
+        return false;
+    }
+    for( const auto& part : parts )
+    {
+        unlink( part.c_str() );
+    }
+    return true;
+}
+
+bool HistoryStore::writeSegment( const string& target, long conId, const string& interval, SeriesKind kind,
+                                 const vector<RawRow>& rows )
+{
+    const auto& schema = SeriesSchema::get( kind );
+    auto        cols = schema.types.size();
+    SegmentHeader h {};
+    h.magic = SEGMENT_MAGIC;
+    h.version = SEGMENT_VERSION;
+    h.kind = (uint32_t)kind;
+    h.columns = (uint32_t)cols;
+    h.rows = rows.size();
+    h.indexStride = STORE_INDEX_STRIDE;
+    h.conId = conId;
+    h.indexOffset = sizeof( SegmentHeader ) + rows.size() * cols * sizeof( int64_t );
+    strncpy( h.interval, interval.c_str(), sizeof( h.interval ) - 1 );
+
+    auto column = vector<uint64_t>( rows.size() );
+    auto stats = vector<ColumnStats>( cols, ColumnStats { numeric_limits<double>::max(), numeric_limits<double>::lowest(), 0 } );
+    auto index = vector<int64_t>();
+    for( size_t i = 0; i < rows.size(); i += STORE_INDEX_STRIDE )
+    {
+        index.push_back( rows[i].time );
+    }
+
+    mkdir( root.c_str(), 0755 );
+    mkdir( ( root + "/" + to_string( conId ) ).c_str(), 0755 );
+    auto temp = target + ".tmp";
+    int  fd = ::open( temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 )
+    {
+        spdlog::error( "Could not create history segment " + temp );
+        return false;
+    }
+    bool ok = writeAll( fd, &h, sizeof( h ) );
+    for( size_t c = 0; c < cols && ok; c++ )
+    {
+        for( size_t i = 0; i < rows.size(); i++ )
+        {
+            uint64_t value;
+            if( c == 0 )
+            {
+                memcpy( &value, &rows[i].time, sizeof( value ) );
+            }
+            else
+            {
+                value = rows[i].values[c - 1];
+            }
+            column[i] = value;
+            auto v = asDouble( value, schema.types[c] );
+            stats[c].min = min( stats[c].min, v );
+            stats[c].max = max( stats[c].max, v );
+            stats[c].sum += v;
+        }
+        ok = writeAll( fd, column.data(), column.size() * sizeof( uint64_t ) );
+    }
+    ok = ok && writeAll( fd, index.data(), index.size() * sizeof( int64_t ) );
+    ok = ok && writeAll( fd, stats.data(), stats.size() * sizeof( ColumnStats ) );
+    ok = ( fsync( fd ) == 0 ) && ok;
+    ::close( fd );
+    if( !ok || rename( temp.c_str(), target.c_str() ) != 0 )
+    {
+        spdlog::error( "Could not write history segment " + target );
+        unlink( temp.c_str() );
+        return false;
+    }
+    return true;
+}
+
+bool HistoryStore::load( long conId, const string& interval, DecodedSeries& series, int64_t from, int64_t to ) const
+{
+    series = DecodedSeries();
+    if( auto seg = open( conId, interval ) )
+    {
+        auto r = seg->range( from, to );
+        series.kind = seg->kind();
+        series.columns.resize( seg->columns() );
+        for( size_t c = 0; c < seg->columns(); c++ )
+        {
+            series.columns[c].assign( seg->ints( c ) + r.begin, seg->ints( c ) + r.end );
+        }
+        return true;
+    }
+    auto target = compactPath( conId, interval );
+    int  fd = ::open( target.c_str(), O_RDONLY );
+    if( fd < 0 )
+    {
+        return false;
+    }
+    struct stat info
+    {
+    };
+    if( fstat( fd, &info ) != 0 || (size_t)info.st_size < sizeof( CompactHeader ) )
+    {
+        ::close( fd );
+        return false;
+    }
+    auto  length = (size_t)info.st_size;
+    void* map = mmap( nullptr, length, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( map == MAP_FAILED )
+    {
+        return false;
+    }
+    madvise( map, length, MADV_SEQUENTIAL );
+    const auto* base = static_cast<const uint8_t*>( map );
+    const auto* h = reinterpret_cast<const CompactHeader*>( base );
+    bool        ok = h->magic == COMPACT_MAGIC && h->version == COMPACT_VERSION && h->columns > 0 &&
+              h->columns <= STORE_MAX_COLUMNS &&
+              h->dataOffset == sizeof( CompactHeader ) + h->blocks * sizeof( BlockInfo ) && h->dataOffset <= length;
+    auto blocks = vector<BlockInfo>();
+    if( ok )
+    {
+        blocks.resize( h->blocks );
+        memcpy( blocks.data(), base + sizeof( CompactHeader ), h->blocks * sizeof( BlockInfo ) );
+        for( const auto& block : blocks )
+        {
+            ok = ok && block.offset + block.size <= length - h->dataOffset;
+        }
+    }
+    if( ok )
+    {
+        series.kind = (SeriesKind)h->kind;
+        const auto& schema = SeriesSchema::get( series.kind );
+        ok = schema.types.size() == h->columns &&
+             SeriesCodec::decode( schema.types, base + h->dataOffset, blocks, series, from, to );
+    }
+    munmap( map, length );
+    if( !ok )
+    {
+        spdlog::error( "Compacted history segment " + target + " is corrupt" );
+    }
+    return ok;
+}
+
+bool HistoryStore::compact( long conId, const string& interval )
+{
+    if( !merge( conId, interval ) )
+    {
+        return false;
+    }
+    auto seg = open( conId, interval );
+    if( !seg )
+    {
+        return false;
+    }
+    const auto& schema = SeriesSchema::get( seg->kind() );
+    auto        columns = vector<const int64_t*>();
+    for( size_t c = 0; c < seg->columns(); c++ )
+    {
+        columns.push_back( seg->ints( c ) );
+    }
+    auto blocks = vector<BlockInfo>();
+    auto data = SeriesCodec::encode( schema.types, columns, seg->rows(), blocks );
+
+    CompactHeader h {};
+    h.magic = COMPACT_MAGIC;
+    h.version = COMPACT_VERSION;
+    h.kind = (uint32_t)seg->kind();
+    h.columns = (uint32_t)seg->columns();
+    h.rows = seg->rows();
+    h.blocks = blocks.size();
+    h.conId = conId;
+    h.dataOffset = sizeof( CompactHeader ) + blocks.size() * sizeof( BlockInfo );
+    strncpy( h.interval, interval.c_str(), sizeof( h.interval ) - 1 );
+    seg.reset();
+
+    auto target = compactPath( conId, interval );
+    auto temp = target + ".tmp";
+    int  fd = ::open( temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 )
+    {
+        spdlog::error( "Could not create compacted history segment " + temp );
+        return false;
+    }
+    bool ok = writeAll( fd, &h, sizeof( h ) );
+    ok = ok && writeAll( fd, blocks.data(), blocks.size() * sizeof( BlockInfo ) );
+    ok = ok && writeAll( fd, data.data(), data.size() );
+    ok = ( fsync( fd ) == 0 ) && ok;
+    ::close( fd );
+    if( !ok || rename( temp.c_str(), target.c_str() ) != 0 )
+    {
+        spdlog::error( "Could not write compacted history segment " + target );
+        unlink( temp.c_str() );
+        return false;
+    }
+    unlink( path( conId, interval ).c_str() );
+    return true;
+}
+
+bool HistoryStore::write( long conId, const string& interval, const vector<BarRow>& bars )
+{
+    auto rows = vector<RawRow>( bars.size() );
+    for( size_t i = 0; i < bars.size(); i++ )
+    {
+        rows[i].time = bars[i].time;
+        memcpy( &rows[i].values[0], &bars[i].open, sizeof( uint64_t ) );
+        memcpy( &rows[i].values[1], &bars[i].high, sizeof( uint64_t ) );
+        memcpy( &rows[i].values[2], &bars[i].low, sizeof( uint64_t ) );
+        memcpy( &rows[i].values[3], &bars[i].close, sizeof( uint64_t ) );
+        memcpy( &rows[i].values[4], &bars[i].volume, sizeof( uint64_t ) );
+    }
+    return write( conId, interval, SeriesKind::Bars, move( rows ) );
+}
+
+bool HistoryStore::write( long conId, const string& interval, const vector<TradeRow>& trades )
+{
+    return write( conId, interval, SeriesKind::Trades, rawRows( trades ) );
+}
+
+bool HistoryStore::write( long conId, const string& interval, const vector<QuoteRow>& quotes )
+{
+    return write( conId, interval, SeriesKind::Snaps, rawRows( quotes ) );
+}
+
+bool HistoryStore::append( long conId, const string& interval, const vector<TradeRow>& trades )
+{
+    return append( conId, interval, SeriesKind::Trades, rawRows( trades ) );
+}
+
+bool HistoryStore::append( long conId, const string& interval, const vector<QuoteRow>& quotes )
+{
+    return append( conId, interval, SeriesKind::Snaps, rawRows( quotes ) );
+}
+
+int64_t HistoryStore::barTime( const string& text )
+{
+    // the parser caches the last date, one per thread keeps it lock free
+    static thread_local TimeParser parser;
+    return parser.parse( text );
+}
+
+string HistoryStore::barTimeString( int64_t time )
+{
+    char   buf[32];
+    time_t t = (time_t)( time / NANOS );
+    struct tm parts
+    {
+    };
+    localtime_r( &t, &parts );
+    strftime( buf, sizeof( buf ), "%Y%m%d %H:%M:%S", &parts );
+    return string( buf );
+}
+
+string HistoryStore::utcTimeString( int64_t time )
+{
+    char   buf[32];
+    time_t t = (time_t)( time / NANOS );
+    struct tm parts
+    {
+    };
+    gmtime_r( &t, &parts );
+    strftime( buf, sizeof( buf ), "%Y%m%d-%H:%M:%S", &parts );
+    return string( buf );
+}
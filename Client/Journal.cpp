@@ -0,0 +1,225 @@
+#include "Journal.h"
+#include "ClientClock.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/// Magic number at the start of a journal, "TBJL"
+constexpr uint32_t JOURNAL_MAGIC = 0x4C4A4254;
+constexpr uint32_t JOURNAL_VERSION = 1;
+
+/// Security type codes of a Line record
+constexpr int32_t LINE_STOCK = 0;
+constexpr int32_t LINE_CALL = 1;
+constexpr int32_t LINE_PUT = 2;
+
+namespace
+{
+    struct JournalHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t reserved;
+    };
+    static_assert( sizeof( JournalHeader ) == 16, "journal header must stay 16 bytes" );
+    static_assert( sizeof( JournalRecord ) == 112, "journal records must stay 112 bytes" );
+
+    void setText( JournalRecord& record, const string& value )
+    {
+        strncpy( record.text, value.c_str(), sizeof( record.text ) - 1 );
+    }
+} // namespace
+
+Journal::~Journal() { close(); }
+
+bool Journal::open( const string& path )
+{
+    close();
+    fd = ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 )
+    {
+        spdlog::error( "Could not create journal " + path );
+        return false;
+    }
+    JournalHeader h { JOURNAL_MAGIC, JOURNAL_VERSION, sizeof( JournalRecord ), 0 };
+    if( ::write( fd, &h, sizeof( h ) ) != (ssize_t)sizeof( h ) )
+    {
+        spdlog::error( "Could not write journal " + path );
+        close();
+        return false;
+    }
+    buffer.reserve( JOURNAL_FLUSH_RECORDS );
+    return true;
+}
+
+void Journal::close()
+{
+    if( fd >= 0 )
+    {
+        flush();
+        ::close( fd );
+    }
+    fd = -1;
+}
+
+void Journal::flush()
+{
+    if( fd < 0 || buffer.empty() )
+    {
+        return;
+    }
+    auto size = buffer.size() * sizeof( JournalRecord );
+    if( ::write( fd, buffer.data(), size ) != (ssize_t)size )
+    {
+        spdlog::error( "Lost " + to_string( buffer.size() ) + " journal records" );
+    }
+    buffer.clear();
+}
+
+JournalRecord& Journal::next( JournalType type, int field, int64_t id )
+{
+    if( buffer.size() >= JOURNAL_FLUSH_RECORDS )
+    {
+        flush();
+    }
+    buffer.emplace_back();
+    auto& record = buffer.back();
+    memset( &record, 0, sizeof( record ) );
+    record.time = ClientClock::now();
+    record.type = (uint32_t)type;
+    record.field = field;
+    record.id = id;
+    return record;
+}
+
+void Journal::line( TickerId tickerId, const Contract& con )
+{
+    int32_t code = LINE_STOCK;
+    if( con.secType == "OPT" )
+    {
+        code = con.right == "P" ? LINE_PUT : LINE_CALL;
+    }
+    auto& record = next( JournalType::Line, code, tickerId );
+    record.values[0] = (double)con.conId;
+    record.values[1] = con.strike;
+    record.values[2] = atof( con.lastTradeDateOrContractMonth.c_str() );
+    setText( record, con.symbol + " " + con.exchange + " " + con.currency );
+}
+
+void Journal::tickPrice( TickerId tickerId, TickType field, double price )
+{
+    next( JournalType::TickPrice, (int)field, tickerId ).values[0] = price;
+}
+
+void Journal::tickSize( TickerId tickerId, TickType field, int size )
+{
+    next( JournalType::TickSize, (int)field, tickerId ).values[0] = size;
+}
+
+void Journal::tickOptionComputation( TickerId tickerId, TickType field, double impliedVol,
+                                     double delta, double optPrice, double pvDividend,
+                                     double gamma, double vega, double theta, double undPrice )
+{
+    auto& record = next( JournalType::TickOption, (int)field, tickerId );
+    double values[8] = { impliedVol, delta, optPrice, pvDividend, gamma, vega, theta, undPrice };
+    memcpy( record.values, values, sizeof( values ) );
+}
+
+void Journal::historicalData( TickerId reqId, const Bar& bar )
+{
+    auto& record = next( JournalType::HistoricalBar, 0, reqId );
+    double values[7] = { bar.open, bar.high, bar.low, bar.close, bar.wap, (double)bar.volume, (double)bar.count };
+    memcpy( record.values, values, sizeof( values ) );
+    setText( record, bar.time );
+}
+
+void Journal::orderStatus( OrderId orderId, const string& status, double filled,
+                           double remaining, double avgFillPrice, double lastFillPrice )
+{
+    auto& record = next( JournalType::OrderStatus, 0, orderId );
+    record.values[0] = filled;
+    record.values[1] = remaining;
+    record.values[2] = avgFillPrice;
+    record.values[3] = lastFillPrice;
+    setText( record, status );
+}
+
+void Journal::marketDepth( TickerId id, int position, int operation, int side, double price, int size )
+{
+    auto& record = next( JournalType::MarketDepth, position, id );
+    record.values[0] = operation;
+    record.values[1] = side;
+    record.values[2] = price;
+    record.values[3] = size;
+}
+
+bool Journal::load( const string& path, vector<JournalRecord>& records )
+{
+    int fd = ::open( path.c_str(), O_RDONLY );
+    if( fd < 0 )
+    {
+        return false;
+    }
+    struct stat info
+    {
+    };
+    JournalHeader h {};
+    bool          ok = fstat( fd, &info ) == 0 && ::read( fd, &h, sizeof( h ) ) == (ssize_t)sizeof( h ) &&
+              h.magic == JOURNAL_MAGIC && h.version == JOURNAL_VERSION && h.recordSize == sizeof( JournalRecord );
+    if( ok )
+    {
+        // a journal cut short by a crash ends in a partial record, drop it
+        auto count = ( (size_t)info.st_size - sizeof( h ) ) / sizeof( JournalRecord );
+        records.resize( count );
+        auto size = count * sizeof( JournalRecord );
+        ok = ::read( fd, records.data(), size ) == (ssize_t)size;
+    }
+    ::close( fd );
+    if( !ok )
+    {
+        spdlog::error( "Journal " + path + " is corrupt" );
+        records.clear();
+    }
+    return ok;
+}
+
+Contract Journal::contract( const JournalRecord& record )
+{
+    auto con = Contract();
+    istringstream fields( text( record ) );
+    fields >> con.symbol >> con.exchange >> con.currency;
+    con.conId = (long)record.values[0];
+    con.secType = record.field == LINE_STOCK ? "STK" : "OPT";
+    if( record.field != LINE_STOCK )
+    {
+        con.strike = record.values[1];
+        con.lastTradeDateOrContractMonth = to_string( (long)record.values[2] );
+        con.right = record.field == LINE_PUT ? "P" : "C";
+    }
+    return con;
+}
+
+Bar Journal::bar( const JournalRecord& record )
+{
+    auto bar = Bar();
+    bar.time = text( record );
+    bar.open = record.values[0];
+    bar.high = record.values[1];
+    bar.low = record.values[2];
+    bar.close = record.values[3];
+    bar.wap = record.values[4];
+    bar.volume = (long long)record.values[5];
+    bar.count = (int)record.values[6];
+    return bar;
+}
+
+string Journal::text( const JournalRecord& record )
+{
+    return string( record.text, strnlen( record.text, sizeof( record.text ) ) );
+}
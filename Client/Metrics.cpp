@@ -0,0 +1,305 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+    /// A value in the unit it is rendered in
+    string number( int64_t value, double scale )
+    {
+        if( scale == 1 )
+        {
+            return to_string( value );
+        }
+        char buf[32];
+        snprintf( buf, sizeof( buf ), "%.9g", (double)value * scale );
+        return buf;
+    }
+
+    string braces( const string& labels ) { return labels.empty() ? "" : "{" + labels + "}"; }
+} // namespace
+
+MetricCounter::MetricCounter() { count.store( 0 ); }
+
+void MetricCounter::add( uint64_t n ) { count.fetch_add( n, memory_order_relaxed ); }
+
+uint64_t MetricCounter::value() const { return count.load( memory_order_relaxed ); }
+
+MetricGauge::MetricGauge() { level.store( 0 ); }
+
+void MetricGauge::set( int64_t value ) { level.store( value, memory_order_relaxed ); }
+
+int64_t MetricGauge::value() const { return level.load( memory_order_relaxed ); }
+
+MetricHistogram::MetricHistogram( vector<int64_t> newBounds )
+{
+    limits = move( newBounds );
+    buckets = make_unique<atomic<uint64_t>[]>( limits.size() + 1 );
+    for( size_t i = 0; i <= limits.size(); i++ )
+    {
+        buckets[i].store( 0 );
+    }
+    total.store( 0 );
+    added.store( 0 );
+}
+
+void MetricHistogram::observe( int64_t value )
+{
+    auto at = (size_t)( lower_bound( limits.begin(), limits.end(), value ) - limits.begin() );
+    buckets[at].fetch_add( 1, memory_order_relaxed );
+    total.fetch_add( 1, memory_order_relaxed );
+    added.fetch_add( value, memory_order_relaxed );
+}
+
+const vector<int64_t>& MetricHistogram::bounds() const { return limits; }
+
+uint64_t MetricHistogram::bucket( size_t index ) const { return buckets[index].load( memory_order_relaxed ); }
+
+uint64_t MetricHistogram::count() const { return total.load( memory_order_relaxed ); }
+
+int64_t MetricHistogram::sum() const { return added.load( memory_order_relaxed ); }
+
+Metrics::Metrics() { published.store( 0 ); }
+
+Metrics& Metrics::global()
+{
+    // never destroyed, the listener thread may still be rendering it while the process exits
+    static auto* registry = new Metrics();
+    return *registry;
+}
+
+template <typename Fill>
+size_t Metrics::entry( Kind kind, const string& name, const string& help, const string& labels, double scale,
+                       Fill fill )
+{
+    lock_guard<mutex> guard( registering );
+    auto              size = published.load( memory_order_relaxed );
+    for( size_t i = 0; i < size; i++ )
+    {
+        if( entries[i].kind == kind && entries[i].name == name && entries[i].labels == labels )
+        {
+            return i;
+        }
+    }
+    if( size == MAXIMUM_METRICS )
+    {
+        spdlog::error( "Metrics registry is full, " + name + braces( labels ) + " is not exported" );
+        return MAXIMUM_METRICS;
+    }
+    auto& e = entries[size];
+    e.kind = kind;
+    e.name = name;
+    e.help = help;
+    e.labels = labels;
+    e.scale = scale;
+    fill( e );
+    published.store( size + 1, memory_order_release );
+    return size;
+}
+
+MetricCounter& Metrics::counter( const string& name, const string& help, const string& labels, double scale )
+{
+    auto index = entry( Kind::Counter, name, help, labels, scale,
+                        []( Entry& e ) { e.counter = make_unique<MetricCounter>(); } );
+    if( index == MAXIMUM_METRICS )
+    {
+        static MetricCounter overflow;
+        return overflow;
+    }
+    return *entries[index].counter;
+}
+
+MetricGauge& Metrics::gauge( const string& name, const string& help, const string& labels, double scale )
+{
+    auto index =
+        entry( Kind::Gauge, name, help, labels, scale, []( Entry& e ) { e.gauge = make_unique<MetricGauge>(); } );
+    if( index == MAXIMUM_METRICS )
+    {
+        static MetricGauge overflow;
+        return overflow;
+    }
+    return *entries[index].gauge;
+}
+
+MetricHistogram& Metrics::histogram( const string& name, const string& help, const vector<int64_t>& bounds,
+                                     const string& labels, double scale )
+{
+    auto index = entry( Kind::Histogram, name, help, labels, scale,
+                        [&bounds]( Entry& e ) { e.histogram = make_unique<MetricHistogram>( bounds ); } );
+    if( index == MAXIMUM_METRICS )
+    {
+        static MetricHistogram overflow( bounds );
+        return overflow;
+    }
+    return *entries[index].histogram;
+}
+
+string Metrics::render() const
+{
+    auto size = published.load( memory_order_acquire );
+    // the text format wants the label sets of a name next to each other
+    auto order = vector<size_t>( size );
+    for( size_t i = 0; i < size; i++ )
+    {
+        order[i] = i;
+    }
+    stable_sort( order.begin(), order.end(),
+                 [this]( size_t a, size_t b ) { return entries[a].name < entries[b].name; } );
+    string out;
+    out.reserve( size * 96 );
+    const string* family = nullptr;
+    for( auto i : order )
+    {
+        const auto& e = entries[i];
+        if( family == nullptr || *family != e.name )
+        {
+            family = &e.name;
+            const char* type = e.kind == Kind::Counter ? "counter" : e.kind == Kind::Gauge ? "gauge" : "histogram";
+            out += "# HELP " + e.name + " " + e.help + "\n# TYPE " + e.name + " " + type + "\n";
+        }
+        if( e.kind == Kind::Counter )
+        {
+            out += e.name + braces( e.labels ) + " " + number( (int64_t)e.counter->value(), e.scale ) + "\n";
+        }
+        else if( e.kind == Kind::Gauge )
+        {
+            out += e.name + braces( e.labels ) + " " + number( e.gauge->value(), e.scale ) + "\n";
+        }
+        else
+        {
+            const auto& h = *e.histogram;
+            auto        prefix = e.labels.empty() ? string() : e.labels + ",";
+            uint64_t    cumulative = 0;
+            for( size_t b = 0; b < h.bounds().size(); b++ )
+            {
+                cumulative += h.bucket( b );
+                out += e.name + "_bucket{" + prefix + "le=\"" + number( h.bounds()[b], e.scale ) + "\"} " +
+                       to_string( cumulative ) + "\n";
+            }
+            cumulative += h.bucket( h.bounds().size() );
+            out += e.name + "_bucket{" + prefix + "le=\"+Inf\"} " + to_string( cumulative ) + "\n";
+            out += e.name + "_sum" + braces( e.labels ) + " " + number( h.sum(), e.scale ) + "\n";
+            out += e.name + "_count" + braces( e.labels ) + " " + to_string( h.count() ) + "\n";
+        }
+    }
+    return out;
+}
+
+MetricsServer::MetricsServer( const Metrics& newMetrics ) : metrics( newMetrics )
+{
+    listener = -1;
+    running.store( false );
+}
+
+MetricsServer::~MetricsServer() { stop(); }
+
+bool MetricsServer::start( int port )
+{
+    if( running.load() )
+    {
+        return true;
+    }
+    listener = socket( AF_INET, SOCK_STREAM, 0 );
+    if( listener < 0 )
+    {
+        spdlog::error( "Could not open the metrics socket: " + string( strerror( errno ) ) );
+        return false;
+    }
+    int reuse = 1;
+    setsockopt( listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof( reuse ) );
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons( (uint16_t)port );
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    if( ::bind( listener, (sockaddr*)&address, sizeof( address ) ) != 0 || listen( listener, 4 ) != 0 )
+    {
+        spdlog::error( "Could not listen for metrics on port " + to_string( port ) + ": " + strerror( errno ) );
+        close( listener );
+        listener = -1;
+        return false;
+    }
+    running.store( true );
+    worker = thread( &MetricsServer::serve, this );
+    spdlog::info( "Serving metrics on http://127.0.0.1:" + to_string( port ) + "/metrics" );
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if( !running.exchange( false ) )
+    {
+        return;
+    }
+    if( worker.joinable() )
+    {
+        worker.join();
+    }
+    close( listener );
+    listener = -1;
+}
+
+void MetricsServer::serve()
+{
+    while( running.load() )
+    {
+        // wake up now and then to see whether the server was stopped
+        pollfd waiting { listener, POLLIN, 0 };
+        if( poll( &waiting, 1, 200 ) <= 0 )
+        {
+            continue;
+        }
+        int connection = accept( listener, nullptr, nullptr );
+        if( connection < 0 )
+        {
+            continue;
+        }
+        timeval timeout { METRICS_TIMEOUT / 1000, ( METRICS_TIMEOUT % 1000 ) * 1000 };
+        setsockopt( connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+        setsockopt( connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+        answer( connection );
+        close( connection );
+    }
+}
+
+void MetricsServer::answer( int connection )
+{
+    char    request[1024];
+    ssize_t length = recv( connection, request, sizeof( request ) - 1, 0 );
+    if( length <= 0 )
+    {
+        return;
+    }
+    request[length] = '\0';
+    string head;
+    string body;
+    if( strncmp( request, "GET /metrics", 12 ) == 0 || strncmp( request, "GET / ", 6 ) == 0 )
+    {
+        body = metrics.render();
+        head = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n";
+    }
+    else
+    {
+        body = "Not found\n";
+        head = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n";
+    }
+    auto response = head + "Content-Length: " + to_string( body.size() ) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while( sent < response.size() )
+    {
+        auto n = send( connection, response.data() + sent, response.size() - sent, MSG_NOSIGNAL );
+        if( n <= 0 )
+        {
+            return;
+        }
+        sent += (size_t)n;
+    }
+}
@@ -0,0 +1,298 @@
+#include "OptionPricer.h"
+#include "TimeParser.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+/// Search range of the implied volatility
+constexpr double MIN_VOL = 1e-4;
+constexpr double MAX_VOL = 5.0;
+/// Newton steps, each one falls back to bisection when it leaves the bracket
+constexpr int SOLVER_STEPS = 12;
+/// Largest pricing error, relative to the option price, of a converged solve
+constexpr double SOLVER_TOLERANCE = 1e-4;
+/// Options are priced at least this far from expiry, about ten minutes
+constexpr double MIN_YEARS = 2e-5;
+constexpr double DAYS_PER_YEAR = 365.0;
+constexpr double NS_PER_YEAR = 365.0 * 86400.0 * 1e9;
+/// Options expire at the close, 16:00 New York time
+constexpr int EXPIRY_HOUR_UTC = 20;
+constexpr double INV_SQRT_2PI = 0.3989422804014327;
+constexpr double SQRT_2PI = 2.5066282746310002;
+
+/// IB tick types of a quote or trade
+constexpr int TICK_BID = 1;
+constexpr int TICK_ASK = 2;
+constexpr int TICK_LAST = 4;
+
+namespace
+{
+    inline double normPdf( double x ) { return INV_SQRT_2PI * exp( -0.5 * x * x ); }
+
+    /// Abramowitz and Stegun 26.2.17 given the density at x, absolute error below 7.5e-8 and no branches
+    inline double normCdf( double x, double pdf )
+    {
+        double a = fabs( x );
+        double t = 1.0 / ( 1.0 + 0.2316419 * a );
+        double poly = t * ( 0.319381530 + t * ( -0.356563782 + t * ( 1.781477937 + t * ( -1.821255978 + t * 1.330274429 ) ) ) );
+        double tail = pdf * poly;
+        return x >= 0 ? 1.0 - tail : tail;
+    }
+
+    inline double normCdf( double x ) { return normCdf( x, normPdf( x ) ); }
+
+    int64_t expiryTime( const string& date )
+    {
+        if( date.size() < 8 )
+        {
+            return 0;
+        }
+        auto value = [&date]( size_t at, size_t count ) {
+            int number = 0;
+            for( size_t i = at; i < at + count; i++ )
+            {
+                number = number * 10 + ( date[i] - '0' );
+            }
+            return number;
+        };
+        return TimeParser::utc( value( 0, 4 ), value( 4, 2 ), value( 6, 2 ), EXPIRY_HOUR_UTC ) * 1000000000;
+    }
+} // namespace
+
+void PricingBatch::resize( size_t count )
+{
+    for( auto* column : { &strike, &years, &sign, &price, &iv, &delta, &gamma, &vega, &theta, &lower, &upper,
+                          &logMoney, &root, &discount } )
+    {
+        column->resize( count, 0 );
+    }
+}
+
+size_t PricingBatch::size() const { return strike.size(); }
+
+double OptionPricer::value( double spot, double strike, double years, double rate, double vol, bool call )
+{
+    double sign = call ? 1.0 : -1.0;
+    double T = max( years, MIN_YEARS );
+    double sd = vol * sqrt( T );
+    double d1 = ( log( spot / strike ) + ( rate + 0.5 * vol * vol ) * T ) / sd;
+    double d2 = d1 - sd;
+    return sign * ( spot * normCdf( sign * d1 ) - strike * exp( -rate * T ) * normCdf( sign * d2 ) );
+}
+
+void OptionPricer::solve( double spot, double rate, PricingBatch& batch, size_t first, size_t count )
+{
+    const size_t  n = first + min( count, batch.size() - min( first, batch.size() ) );
+    const double* K = batch.strike.data();
+    const double* sign = batch.sign.data();
+    const double* P = batch.price.data();
+    double*       vol = batch.iv.data();
+    double*       lo = batch.lower.data();
+    double*       hi = batch.upper.data();
+    double*       lnSK = batch.logMoney.data();
+    double*       sqrtT = batch.root.data();
+    double*       disc = batch.discount.data();
+
+    // Brenner-Subrahmanyam start, exact for at the money options
+    for( size_t i = first; i < n; i++ )
+    {
+        double T = max( batch.years[i], MIN_YEARS );
+        sqrtT[i] = sqrt( T );
+        disc[i] = exp( -rate * T );
+        lnSK[i] = log( spot / K[i] ) + rate * T;
+        vol[i] = min( max( SQRT_2PI / sqrtT[i] * P[i] / spot, MIN_VOL ), MAX_VOL );
+        lo[i] = MIN_VOL;
+        hi[i] = MAX_VOL;
+    }
+    for( int step = 0; step < SOLVER_STEPS; step++ )
+    {
+        for( size_t i = first; i < n; i++ )
+        {
+            double sd = vol[i] * sqrtT[i];
+            double d1 = lnSK[i] / sd + 0.5 * sd;
+            double d2 = d1 - sd;
+            double pdf1 = normPdf( d1 );
+            double value = sign[i] * ( spot * normCdf( sign[i] * d1, pdf1 ) - K[i] * disc[i] * normCdf( sign[i] * d2, normPdf( d2 ) ) );
+            double vega = spot * pdf1 * sqrtT[i];
+            // the value rises with the volatility, so the bracket closes in from the side it overshot
+            bool high = value > P[i];
+            hi[i] = high ? vol[i] : hi[i];
+            lo[i] = high ? lo[i] : vol[i];
+            double newton = vol[i] - ( value - P[i] ) / max( vega, 1e-12 );
+            bool   inside = newton >= lo[i] && newton <= hi[i];
+            vol[i] = inside ? newton : 0.5 * ( lo[i] + hi[i] );
+        }
+    }
+    const double nan = numeric_limits<double>::quiet_NaN();
+    for( size_t i = first; i < n; i++ )
+    {
+        double sd = vol[i] * sqrtT[i];
+        double d1 = lnSK[i] / sd + 0.5 * sd;
+        double d2 = d1 - sd;
+        double pdf1 = normPdf( d1 );
+        double cdf2 = normCdf( sign[i] * d2, normPdf( d2 ) );
+        double value = sign[i] * ( spot * normCdf( sign[i] * d1, pdf1 ) - K[i] * disc[i] * cdf2 );
+        double vega = spot * pdf1 * sqrtT[i] / 100;
+        double tolerance = SOLVER_TOLERANCE * max( P[i], 0.01 );
+        // deep in the money or nearly worthless, a volatility point moves the price
+        // less than the tolerance and any volatility fits
+        bool solved = P[i] > 0 && fabs( value - P[i] ) <= tolerance && vega > tolerance;
+        batch.iv[i] = solved ? vol[i] : nan;
+        batch.delta[i] = solved ? normCdf( d1, pdf1 ) - ( sign[i] < 0 ? 1.0 : 0.0 ) : nan;
+        batch.gamma[i] = solved ? pdf1 / ( spot * sd ) : nan;
+        batch.vega[i] = solved ? vega : nan;
+        batch.theta[i] = solved ? ( -spot * pdf1 * vol[i] / ( 2 * sqrtT[i] ) - sign[i] * rate * K[i] * disc[i] * cdf2 ) /
+                                      DAYS_PER_YEAR
+                                : nan;
+    }
+}
+
+OptionChain::OptionChain()
+{
+    lines = vector<long>();
+    slots = map<long, size_t>();
+    expiries = vector<int64_t>();
+    underBid = 0;
+    underAsk = 0;
+    underLast = 0;
+}
+
+void OptionChain::add( long line, const Contract& con )
+{
+    if( contains( line ) )
+    {
+        return;
+    }
+    auto at = lines.size();
+    slots[line] = at;
+    lines.push_back( line );
+    expiries.push_back( expiryTime( con.lastTradeDateOrContractMonth ) );
+    siblings.push_back( at );
+    for( auto* batch : { &bidBatch, &askBatch } )
+    {
+        batch->resize( at + 1 );
+        batch->strike[at] = con.strike;
+        batch->sign[at] = con.right == "P" || con.right == "PUT" ? -1.0 : 1.0;
+    }
+    for( size_t i = 0; i < at; i++ )
+    {
+        if( expiries[i] == expiries[at] && bidBatch.strike[i] == con.strike && bidBatch.sign[i] != bidBatch.sign[at] )
+        {
+            siblings[i] = at;
+            siblings[at] = i;
+        }
+    }
+    volSurface.add( at, expiries[at], con.strike );
+}
+
+bool OptionChain::contains( long line ) const { return slots.find( line ) != slots.end(); }
+
+size_t OptionChain::slot( long line ) const { return slots.at( line ); }
+
+void OptionChain::quote( long line, int field, double price )
+{
+    auto found = slots.find( line );
+    if( found == slots.end() )
+    {
+        return;
+    }
+    auto at = found->second;
+    if( field == TICK_BID || field == TICK_LAST )
+    {
+        bidBatch.price[at] = price;
+    }
+    if( field == TICK_ASK || field == TICK_LAST )
+    {
+        askBatch.price[at] = price;
+    }
+}
+
+void OptionChain::underlying( int field, double price )
+{
+    if( field == TICK_BID )
+    {
+        underBid = price;
+    }
+    else if( field == TICK_ASK )
+    {
+        underAsk = price;
+    }
+    else if( field == TICK_LAST )
+    {
+        underLast = price;
+    }
+}
+
+double OptionChain::spot() const
+{
+    if( underBid > 0 && underAsk > 0 )
+    {
+        return ( underBid + underAsk ) / 2;
+    }
+    return underLast;
+}
+
+bool OptionChain::solve( int64_t now, double rate )
+{
+    auto S = spot();
+    if( S <= 0 || lines.empty() )
+    {
+        return false;
+    }
+    prepare( 0, lines.size(), now );
+    OptionPricer::solve( S, rate, bidBatch );
+    OptionPricer::solve( S, rate, askBatch );
+    publish( 0, lines.size() );
+    return true;
+}
+
+bool OptionChain::solve( long line, int64_t now, double rate )
+{
+    auto S = spot();
+    auto found = slots.find( line );
+    if( S <= 0 || found == slots.end() )
+    {
+        return false;
+    }
+    prepare( found->second, 1, now );
+    OptionPricer::solve( S, rate, bidBatch, found->second, 1 );
+    OptionPricer::solve( S, rate, askBatch, found->second, 1 );
+    publish( found->second, 1 );
+    return true;
+}
+
+const VolSurface& OptionChain::surface() const { return volSurface; }
+
+void OptionChain::prepare( size_t first, size_t count, int64_t now )
+{
+    for( size_t i = first; i < first + count; i++ )
+    {
+        auto years = (double)( expiries[i] - now ) / NS_PER_YEAR;
+        bidBatch.years[i] = years;
+        askBatch.years[i] = years;
+    }
+}
+
+void OptionChain::publish( size_t first, size_t count )
+{
+    auto S = spot();
+    auto mid = [this]( size_t i ) {
+        double bid = bidBatch.iv[i];
+        double ask = askBatch.iv[i];
+        return std::isnan( bid ) ? ask : std::isnan( ask ) ? bid : ( bid + ask ) / 2;
+    };
+    for( size_t i = first; i < first + count; i++ )
+    {
+        // an in the money option gives way to its out of the money sibling
+        auto sibling = siblings[i];
+        bool inTheMoney = bidBatch.sign[i] * ( S - bidBatch.strike[i] ) > 0;
+        auto iv = sibling != i && inTheMoney && !std::isnan( mid( sibling ) ) ? mid( sibling ) : mid( i );
+        volSurface.update( i, iv );
+    }
+}
+
+const PricingBatch& OptionChain::bids() const { return bidBatch; }
+
+const PricingBatch& OptionChain::asks() const { return askBatch; }
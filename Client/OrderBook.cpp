@@ -0,0 +1,102 @@
+#include "OrderBook.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+    const BookLevel EMPTY_LEVEL { 0, 0 };
+} // namespace
+
+OrderBook::OrderBook()
+{
+    clear();
+    applied = 0;
+}
+
+bool OrderBook::apply( int position, int operation, int side, double price, int64_t size )
+{
+    if( position < 0 || position >= BOOK_DEPTH || ( side != DEPTH_ASK && side != DEPTH_BID ) )
+    {
+        return false;
+    }
+    auto& book = sides[side];
+    auto* rows = book.rows.data();
+    switch( operation )
+    {
+        case DEPTH_INSERT:
+            // the last row falls off a full book
+            position = min( position, book.count );
+            move_backward( rows + position, rows + min( book.count, BOOK_DEPTH - 1 ),
+                           rows + min( book.count + 1, BOOK_DEPTH ) );
+            rows[position] = BookLevel { price, size };
+            book.count = min( book.count + 1, BOOK_DEPTH );
+            break;
+
+        case DEPTH_UPDATE:
+            rows[position] = BookLevel { price, size };
+            book.count = max( book.count, position + 1 );
+            break;
+
+        case DEPTH_DELETE:
+            if( position >= book.count )
+            {
+                return false;
+            }
+            move( rows + position + 1, rows + book.count, rows + position );
+            book.count--;
+            rows[book.count] = EMPTY_LEVEL;
+            break;
+
+        default:
+            return false;
+    }
+    applied++;
+    return true;
+}
+
+void OrderBook::clear()
+{
+    for( auto& side : sides )
+    {
+        side.rows.fill( EMPTY_LEVEL );
+        side.count = 0;
+    }
+}
+
+int OrderBook::levels( int side ) const { return sides[side].count; }
+
+const BookLevel& OrderBook::level( int side, int position ) const { return sides[side].rows[position]; }
+
+const BookLevel& OrderBook::bestBid() const { return sides[DEPTH_BID].rows[0]; }
+
+const BookLevel& OrderBook::bestAsk() const { return sides[DEPTH_ASK].rows[0]; }
+
+double OrderBook::imbalance( int rows ) const
+{
+    double bid = 0;
+    double ask = 0;
+    for( int i = 0; i < min( rows, BOOK_DEPTH ); i++ )
+    {
+        bid += (double)sides[DEPTH_BID].rows[i].size;
+        ask += (double)sides[DEPTH_ASK].rows[i].size;
+    }
+    return bid + ask > 0 ? ( bid - ask ) / ( bid + ask ) : 0;
+}
+
+double OrderBook::microprice() const
+{
+    const auto& bid = bestBid();
+    const auto& ask = bestAsk();
+    if( bid.size > 0 && ask.size > 0 )
+    {
+        return ( bid.price * (double)ask.size + ask.price * (double)bid.size ) / (double)( bid.size + ask.size );
+    }
+    if( bid.price > 0 && ask.price > 0 )
+    {
+        return ( bid.price + ask.price ) / 2;
+    }
+    return bid.price > 0 ? bid.price : ask.price;
+}
+
+uint64_t OrderBook::updates() const { return applied; }
@@ -0,0 +1,126 @@
+#include "OutboundScheduler.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+constexpr double NS_PER_SECOND = 1e9;
+
+namespace
+{
+    int64_t steadyNow()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+} // namespace
+
+OutboundScheduler::OutboundScheduler()
+{
+    tokens = OUTBOUND_BURST;
+    refilled = steadyNow();
+    queued = 0;
+    auto& metrics = Metrics::global();
+    sentCount = &metrics.counter( "tradebot_outbound_messages_total", "Requests sent to TWS" );
+    coalesced = &metrics.counter( "tradebot_outbound_coalesced_total", "Order cancels turned into modifies" );
+    queueDepth = &metrics.gauge( "tradebot_outbound_waiting", "Requests waiting for a token" );
+}
+
+void OutboundScheduler::refill()
+{
+    auto now = steadyNow();
+    tokens = min( OUTBOUND_BURST, tokens + (double)( now - refilled ) * OUTBOUND_RATE / NS_PER_SECOND );
+    refilled = now;
+}
+
+void OutboundScheduler::sendNow( function<void()>& call )
+{
+    tokens -= 1;
+    sentCount->add();
+    call();
+}
+
+void OutboundScheduler::send( OutboundLane lane, function<void()> call )
+{
+    auto index = (size_t)lane;
+    bool ahead = false;
+    for( size_t i = 0; i <= index; i++ )
+    {
+        ahead = ahead || !lanes[i].empty();
+    }
+    refill();
+    if( !ahead && tokens >= 1 )
+    {
+        sendNow( call );
+        return;
+    }
+    lanes[index].push_back( Message { move( call ), -1, string() } );
+    queueDepth->set( (int64_t)++queued );
+}
+
+void OutboundScheduler::cancel( OrderId order, const string& key, function<void()> call )
+{
+    lanes[(size_t)OutboundLane::Cancels].push_back( Message { move( call ), order, key } );
+    queueDepth->set( (int64_t)++queued );
+}
+
+OrderId OutboundScheduler::cancelled( const string& key ) const
+{
+    for( const auto& m : lanes[(size_t)OutboundLane::Cancels] )
+    {
+        if( m.key == key )
+        {
+            return m.order;
+        }
+    }
+    return -1;
+}
+
+void OutboundScheduler::replace( OrderId order )
+{
+    auto& cancels = lanes[(size_t)OutboundLane::Cancels];
+    auto  found = find_if( cancels.begin(), cancels.end(), [order]( const Message& m ) { return m.order == order; } );
+    if( found != cancels.end() )
+    {
+        cancels.erase( found );
+        coalesced->add();
+        queueDepth->set( (int64_t)--queued );
+    }
+}
+
+void OutboundScheduler::pump()
+{
+    if( queued == 0 )
+    {
+        return;
+    }
+    refill();
+    for( auto& lane : lanes )
+    {
+        while( !lane.empty() && tokens >= 1 )
+        {
+            // the message leaves the queue first, a call may queue another one
+            auto call = move( lane.front().call );
+            lane.pop_front();
+            queued--;
+            sendNow( call );
+        }
+        if( !lane.empty() )
+        {
+            break;
+        }
+    }
+    queueDepth->set( (int64_t)queued );
+}
+
+int64_t OutboundScheduler::due()
+{
+    if( queued == 0 )
+    {
+        return -1;
+    }
+    refill();
+    return tokens >= 1 ? 0 : (int64_t)( ( 1 - tokens ) * NS_PER_SECOND / OUTBOUND_RATE );
+}
+
+size_t OutboundScheduler::waiting() const { return queued; }
@@ -0,0 +1,227 @@
+#include "PnLEngine.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+constexpr int64_t NS_PER_SECOND = 1000000000;
+
+namespace
+{
+    string key( const string& symbol, const string& secType ) { return symbol + " " + secType; }
+} // namespace
+
+PnLEngine::PnLEngine()
+{
+    slots = vector<PnLSlot>();
+    contracts = unordered_map<long, int>();
+    symbols = unordered_map<string, int>();
+    lines = unordered_map<long, int>();
+    totalRealized = 0;
+    totalUnrealized = 0;
+    totalGross = 0;
+    totalNet = 0;
+}
+
+int PnLEngine::slot( long conId, const string& symbol, const string& secType, double multiplier )
+{
+    if( conId != 0 )
+    {
+        auto found = contracts.find( conId );
+        if( found != contracts.end() )
+        {
+            return found->second;
+        }
+    }
+    else
+    {
+        auto found = symbols.find( key( symbol, secType ) );
+        if( found != symbols.end() )
+        {
+            return found->second;
+        }
+    }
+    slots.push_back( PnLSlot { 0, 0, multiplier > 0 ? multiplier : 1, 0, 0, 0, 0, 0, 0, 0, -1, 0 } );
+    auto index = (int)slots.size() - 1;
+    if( conId != 0 )
+    {
+        contracts[conId] = index;
+    }
+    else
+    {
+        symbols[key( symbol, secType )] = index;
+    }
+    return index;
+}
+
+int PnLEngine::slot( const string& symbol, const string& secType, double multiplier )
+{
+    return slot( 0, symbol, secType, multiplier );
+}
+
+int PnLEngine::slot( const Contract& con )
+{
+    return slot( con.conId, con.symbol, con.secType, atof( con.multiplier.c_str() ) );
+}
+
+void PnLEngine::revalue( PnLSlot& s )
+{
+    auto value = s.mark > 0 ? s.position * s.multiplier * s.mark : 0;
+    auto unrealized = s.mark > 0 ? value - s.position * s.multiplier * s.average : 0;
+    totalNet += value - s.value;
+    totalGross += fabs( value ) - fabs( s.value );
+    totalUnrealized += unrealized - s.unrealized;
+    s.value = value;
+    s.unrealized = unrealized;
+}
+
+void PnLEngine::mark( int index, int field, double price )
+{
+    auto& s = slots[index];
+    if( field == 1 )
+    {
+        s.bid = price;
+    }
+    else if( field == 2 )
+    {
+        s.ask = price;
+    }
+    else if( field == 4 )
+    {
+        s.last = price;
+    }
+    else
+    {
+        return;
+    }
+    auto ref = s.bid > 0 && s.ask > 0 ? ( s.bid + s.ask ) / 2 : s.last;
+    if( ref > 0 && ref != s.mark )
+    {
+        s.mark = ref;
+        revalue( s );
+    }
+}
+
+void PnLEngine::fill( int index, double quantity, double price )
+{
+    auto& s = slots[index];
+    if( quantity == 0 )
+    {
+        return;
+    }
+    if( s.position == 0 || ( s.position > 0 ) == ( quantity > 0 ) )
+    {
+        s.average = ( s.position * s.average + quantity * price ) / ( s.position + quantity );
+    }
+    else
+    {
+        // the fill closes some or all of the position, and opens the other side with the rest
+        auto closed = min( fabs( quantity ), fabs( s.position ) );
+        auto gain = closed * s.multiplier * ( price - s.average ) * ( s.position > 0 ? 1 : -1 );
+        s.realized += gain;
+        totalRealized += gain;
+        if( fabs( quantity ) > fabs( s.position ) )
+        {
+            s.average = price;
+        }
+    }
+    s.position += quantity;
+    if( s.position == 0 )
+    {
+        s.average = 0;
+    }
+    if( s.mark <= 0 )
+    {
+        // valued at its fill until the first quote
+        s.mark = price;
+    }
+    revalue( s );
+}
+
+void PnLEngine::charge( int index, double commission )
+{
+    slots[index].realized -= commission;
+    totalRealized -= commission;
+}
+
+void PnLEngine::position( int index, double size, double averageCost, double marketPrice )
+{
+    auto& s = slots[index];
+    s.position = size;
+    s.average = size != 0 ? averageCost / s.multiplier : 0;
+    if( marketPrice > 0 && s.bid <= 0 && s.ask <= 0 && s.last <= 0 )
+    {
+        s.mark = marketPrice;
+    }
+    revalue( s );
+}
+
+void PnLEngine::watch( long reqId, int index )
+{
+    lines[reqId] = index;
+    slots[index].line = reqId;
+}
+
+bool PnLEngine::watched( int index ) const { return slots[index].line >= 0; }
+
+vector<long> PnLEngine::watches() const
+{
+    auto ids = vector<long>();
+    for( const auto& line : lines )
+    {
+        ids.push_back( line.first );
+    }
+    return ids;
+}
+
+bool PnLEngine::reconcile( long reqId, double size, double unrealized, double realized, double value, int64_t now )
+{
+    auto found = lines.find( reqId );
+    if( found == lines.end() )
+    {
+        return false;
+    }
+    auto& s = slots[found->second];
+    if( s.reconciled != 0 && now - s.reconciled < PNL_RECONCILE * NS_PER_SECOND )
+    {
+        return true;
+    }
+    s.reconciled = now;
+    s.position = size;
+    // TWS sends DBL_MAX for the values it does not know
+    if( realized < DBL_MAX )
+    {
+        totalRealized += realized - s.realized;
+        s.realized = realized;
+    }
+    if( size != 0 && value != 0 && value < DBL_MAX && unrealized < DBL_MAX )
+    {
+        auto price = value / ( size * s.multiplier );
+        s.average = price - unrealized / ( size * s.multiplier );
+        if( s.mark <= 0 )
+        {
+            s.mark = price;
+        }
+    }
+    else if( size == 0 )
+    {
+        s.average = 0;
+    }
+    revalue( s );
+    return true;
+}
+
+double PnLEngine::realized() const { return totalRealized; }
+
+double PnLEngine::unrealized() const { return totalUnrealized; }
+
+double PnLEngine::gross() const { return totalGross; }
+
+double PnLEngine::net() const { return totalNet; }
+
+double PnLEngine::pnl( int index ) const { return slots[index].realized + slots[index].unrealized; }
+
+double PnLEngine::exposure( int index ) const { return slots[index].value; }
+
+double PnLEngine::size( int index ) const { return slots[index].position; }
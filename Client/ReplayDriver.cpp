@@ -0,0 +1,287 @@
+#include "ReplayDriver.h"
+#include "ClientAccount.h"
+#include "ClientBrain.h"
+#include "ClientClock.h"
+#include "ClientData.h"
+#include "DataArray.h"
+#include "Execution.h"
+#include "Position.h"
+#include "SeriesCodec.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+using namespace std;
+using namespace ClientSpace;
+
+/// Tick types of a last trade
+constexpr int TICK_LAST = 4;
+constexpr int TICK_LAST_SIZE = 5;
+
+ReplayDriver::ReplayDriver( ClientBrain& newBrain ) : brain( newBrain )
+{
+    records = vector<JournalRecord>();
+    simulating = true;
+    replayed = 0;
+    fills = 0;
+    seconds = 0;
+    execCount = 0;
+}
+
+ReplayDriver::~ReplayDriver()
+{
+    brain.Broker->simulate( nullptr );
+    ClientClock::release();
+}
+
+bool ReplayDriver::loadJournal( const string& path )
+{
+    auto loaded = vector<JournalRecord>();
+    if( !Journal::load( path, loaded ) )
+    {
+        spdlog::error( "Could not read journal " + path );
+        return false;
+    }
+    records.insert( records.end(), loaded.begin(), loaded.end() );
+    spdlog::info( "Queued " + to_string( loaded.size() ) + " records from journal " + path );
+    return true;
+}
+
+bool ReplayDriver::loadHistory( const string& root, const string& interval )
+{
+    auto& data = *brain.Data;
+    data.universe.loadCache( data.universeCache );
+    auto   store = HistoryStore( root );
+    size_t queued = 0;
+    for( const auto& con : data.universe.contracts() )
+    {
+        auto series = DecodedSeries();
+        if( con.secType != "STK" || !store.load( con.conId, interval, series ) ||
+            series.kind != SeriesKind::Bars || series.rows() == 0 )
+        {
+            continue;
+        }
+        auto tickerId = data.getNextVectorId();
+        auto line = JournalRecord();
+        memset( &line, 0, sizeof( line ) );
+        line.time = series.times()[0] - 1;
+        line.type = (uint32_t)JournalType::Line;
+        line.id = tickerId;
+        line.values[0] = (double)con.conId;
+        strncpy( line.text, ( con.symbol + " " + con.exchange + " " + con.currency ).c_str(),
+                 sizeof( line.text ) - 1 );
+        records.push_back( line );
+        // a bar becomes one last trade at its close, the size completes the snapshot
+        for( size_t i = 0; i < series.rows(); i++ )
+        {
+            auto tick = JournalRecord();
+            memset( &tick, 0, sizeof( tick ) );
+            tick.time = series.times()[i];
+            tick.id = tickerId;
+            tick.type = (uint32_t)JournalType::TickPrice;
+            tick.field = TICK_LAST;
+            tick.values[0] = series.doubles( 4 )[i];
+            records.push_back( tick );
+            tick.type = (uint32_t)JournalType::TickSize;
+            tick.field = TICK_LAST_SIZE;
+            tick.values[0] = (double)series.ints( 5 )[i];
+            records.push_back( tick );
+        }
+        queued += series.rows();
+    }
+    spdlog::info( "Queued " + to_string( queued ) + " " + interval + " bars from the history store at " + root );
+    return queued > 0;
+}
+
+void ReplayDriver::load( shared_ptr<const vector<JournalRecord>> newTape )
+{
+    if( !shared )
+    {
+        shared = move( newTape );
+        return;
+    }
+    records.insert( records.end(), newTape->begin(), newTape->end() );
+}
+
+shared_ptr<const vector<JournalRecord>> ReplayDriver::tape()
+{
+    if( records.empty() )
+    {
+        return shared;
+    }
+    auto merged = make_shared<vector<JournalRecord>>();
+    if( shared )
+    {
+        merged->reserve( shared->size() + records.size() );
+        merged->insert( merged->end(), shared->begin(), shared->end() );
+    }
+    merged->insert( merged->end(), records.begin(), records.end() );
+    records.clear();
+    // journals are in arrival order already, history bars are merged in by time
+    stable_sort( merged->begin(), merged->end(),
+                 []( const JournalRecord& a, const JournalRecord& b ) { return a.time < b.time; } );
+    shared = merged;
+    return shared;
+}
+
+void ReplayDriver::simulateFills( bool fill ) { simulating = fill; }
+
+void ReplayDriver::setCash( double cash )
+{
+    brain.Account->cash = cash;
+    brain.Account->startEquity = cash;
+}
+
+void ReplayDriver::run( const function<void()>& step )
+{
+    auto replay = tape();
+    if( !replay )
+    {
+        return;
+    }
+    brain.Broker->simulate( this );
+    *brain.p_State = DATA_NEXT;
+    replayed = 0;
+    fills = 0;
+    auto start = chrono::steady_clock::now();
+    for( const auto& record : *replay )
+    {
+        ClientClock::simulate( record.time );
+        dispatch( record );
+        replayed++;
+        // what the main loop does between two socket reads
+        int steps = 0;
+        do
+        {
+            step();
+            settle();
+        } while( *brain.p_State != DATA_NEXT && ++steps < REPLAY_MAX_STEPS );
+    }
+    seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    brain.Broker->simulate( nullptr );
+    ClientClock::release();
+    spdlog::info( "Replayed " + to_string( replayed ) + " records in " + to_string( seconds ) + " s, " +
+                  to_string( replayed > 0 ? seconds * 1e9 / (double)replayed : 0.0 ) +
+                  " ns per record, " + to_string( fills ) + " simulated fills" );
+    shared.reset();
+}
+
+double ReplayDriver::equity() const
+{
+    double value = brain.Account->cash;
+    for( auto* const pos : brain.Account->positions )
+    {
+        auto last = lastPrice.find( pos->getContract()->conId );
+        auto price = last != lastPrice.end() ? last->second : pos->getAvgPrice();
+        value += pos->getPositionSize() * price;
+    }
+    return value;
+}
+
+void ReplayDriver::dispatch( const JournalRecord& record )
+{
+    switch( (JournalType)record.type )
+    {
+        case JournalType::Line:
+        {
+            auto con = Journal::contract( record );
+            lineConIds[record.id] = con.conId;
+            if( brain.Data->DataArrays.find( record.id ) == brain.Data->DataArrays.end() )
+            {
+                brain.Data->openLine( con, record.id );
+            }
+            break;
+        }
+        case JournalType::TickPrice:
+        {
+            if( record.field == TICK_LAST )
+            {
+                auto line = lineConIds.find( record.id );
+                if( line != lineConIds.end() )
+                {
+                    lastPrice[line->second] = record.values[0];
+                }
+            }
+            brain.tickPrice( record.id, (TickType)record.field, record.values[0], TickAttrib() );
+            break;
+        }
+        case JournalType::TickSize:
+            brain.tickSize( record.id, (TickType)record.field, (int)record.values[0] );
+            break;
+        case JournalType::TickOption:
+            brain.tickOptionComputation( record.id, (TickType)record.field, record.values[0],
+                                         record.values[1], record.values[2], record.values[3],
+                                         record.values[4], record.values[5], record.values[6],
+                                         record.values[7] );
+            break;
+        case JournalType::HistoricalBar:
+            if( brain.Data->DataArrays.find( record.id ) == brain.Data->DataArrays.end() )
+            {
+                // the request was made before the recording started
+                brain.Data->DataArrays.insert( make_shared<DataArray>( record.id, 0, "", "", "", "", "" ) );
+            }
+            brain.historicalData( record.id, Journal::bar( record ) );
+            break;
+        case JournalType::OrderStatus:
+            // simulated fills produce their own statuses
+            if( !simulating )
+            {
+                brain.orderStatus( record.id, Journal::text( record ), record.values[0], record.values[1],
+                                   record.values[2], 0, 0, record.values[3], (int)brain.clientID, "", 0 );
+            }
+            break;
+        case JournalType::MarketDepth:
+            if( brain.Data->book( record.id ) == nullptr )
+            {
+                // the book was subscribed before the recording started
+                brain.Data->addBook( record.id );
+            }
+            brain.updateMktDepth( record.id, record.field, (int)record.values[0], (int)record.values[1],
+                                  record.values[2], (int)record.values[3] );
+            break;
+    }
+}
+
+void ReplayDriver::placeOrder( OrderId orderId, const Contract& con, const Order& order )
+{
+    if( simulating )
+    {
+        placed.emplace_back( orderId, make_pair( con, order ) );
+    }
+}
+
+void ReplayDriver::reqExecutions( int reqId, const ExecutionFilter& filter )
+{
+    // every simulated execution was streamed when it was made, there is nothing to send again
+}
+
+void ReplayDriver::settle()
+{
+    while( !placed.empty() )
+    {
+        auto orderId = placed.front().first;
+        auto con = placed.front().second.first;
+        auto order = placed.front().second.second;
+        placed.pop_front();
+        auto last = lastPrice.find( con.conId );
+        auto price = last != lastPrice.end() ? last->second : order.lmtPrice;
+        auto quantity = (double)order.totalQuantity;
+        brain.orderStatus( orderId, "Submitted", 0, quantity, 0, 0, 0, 0, (int)brain.clientID, "", 0 );
+        // TWS streams the execution ahead of the Filled status
+        auto exec = Execution();
+        exec.execId = "replay." + to_string( ++execCount );
+        exec.orderId = orderId;
+        exec.time = HistoryStore::barTimeString( ClientClock::now() );
+        exec.acctNumber = brain.Account->accountID;
+        exec.side = order.action == "BUY" ? "BOT" : "SLD";
+        exec.shares = quantity;
+        exec.cumQty = quantity;
+        exec.price = price;
+        exec.avgPrice = price;
+        exec.clientId = brain.clientID;
+        brain.execDetails( -1, con, exec );
+        brain.orderStatus( orderId, "Filled", quantity, 0, price, 0, 0, price, (int)brain.clientID, "", 0 );
+        fills++;
+    }
+}
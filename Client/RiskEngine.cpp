@@ -0,0 +1,218 @@
+#include "RiskEngine.h"
+#include "PnLEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+constexpr int64_t NS_PER_MS = 1000000;
+constexpr int64_t NS_PER_DAY = 86400000000000;
+
+namespace
+{
+    string key( const string& symbol, const string& secType ) { return symbol + " " + secType; }
+} // namespace
+
+RiskEngine::RiskEngine()
+{
+    slots = vector<RiskSlot>();
+    contracts = unordered_map<long, int>();
+    symbols = unordered_map<string, int>();
+    booked = unordered_map<long, BookedOrder>();
+    maxDayNotional = RISK_MAX_DAY_NOTIONAL;
+    maxGross = RISK_MAX_GROSS_EXPOSURE;
+    book = nullptr;
+    dayNotional = 0;
+    day = 0;
+}
+
+int RiskEngine::add()
+{
+    auto limits = RiskLimits { RISK_MAX_POSITION, RISK_MAX_ORDER_NOTIONAL, RISK_PRICE_BAND, RISK_ORDER_GAP * NS_PER_MS };
+    slots.push_back( RiskSlot { limits, 0, 0, 0, 0, 0, 0 } );
+    return (int)slots.size() - 1;
+}
+
+int RiskEngine::slot( const Contract& con )
+{
+    if( con.conId == 0 )
+    {
+        return slot( con.symbol, con.secType );
+    }
+    auto found = contracts.find( con.conId );
+    if( found != contracts.end() )
+    {
+        return found->second;
+    }
+    return contracts[con.conId] = add();
+}
+
+int RiskEngine::slot( const string& symbol, const string& secType )
+{
+    auto found = symbols.find( key( symbol, secType ) );
+    if( found != symbols.end() )
+    {
+        return found->second;
+    }
+    return symbols[key( symbol, secType )] = add();
+}
+
+void RiskEngine::limit( const Contract& con, const RiskLimits& limits )
+{
+    auto& s = slots[slot( con )];
+    s.limits = limits;
+    s.limits.orderGap = limits.orderGap * NS_PER_MS;
+}
+
+void RiskEngine::dayLimit( double notional ) { maxDayNotional = notional; }
+
+void RiskEngine::portfolio( const PnLEngine* pnl ) { book = pnl; }
+
+void RiskEngine::grossLimit( double exposure ) { maxGross = exposure; }
+
+void RiskEngine::mark( int index, int field, double price )
+{
+    auto& s = slots[index];
+    if( field == 1 )
+    {
+        s.bid = price;
+    }
+    else if( field == 2 )
+    {
+        s.ask = price;
+    }
+    else if( field == 4 )
+    {
+        s.last = price;
+    }
+}
+
+void RiskEngine::position( const Contract& con, double size ) { slots[slot( con )].position = size; }
+
+double RiskEngine::reference( const RiskSlot& s ) const
+{
+    if( s.bid > 0 && s.ask > 0 )
+    {
+        return ( s.bid + s.ask ) / 2;
+    }
+    return s.last > 0 ? s.last : 0;
+}
+
+RiskVerdict RiskEngine::check( const Contract& con, const Order& order, long orderId, int64_t now )
+{
+    auto  index = slot( con );
+    auto& s = slots[index];
+    auto  ref = reference( s );
+    auto  side = order.action == "BUY" ? 1.0 : -1.0;
+    auto  price = ref;
+    if( order.orderType == "LMT" || order.orderType == "STP LMT" )
+    {
+        price = order.lmtPrice;
+        if( ref > 0 && fabs( price - ref ) > s.limits.priceBand * ref )
+        {
+            return RiskVerdict::PriceBand;
+        }
+    }
+    if( price <= 0 )
+    {
+        return RiskVerdict::NoPrice;
+    }
+    if( s.lastOrder != 0 && now - s.lastOrder < s.limits.orderGap )
+    {
+        return RiskVerdict::RateLimit;
+    }
+    // a modify replaces the working size and notional of the order it modifies, TWS keeps counting its fills
+    auto   old = booked.find( orderId );
+    double filled = 0;
+    double replaced = 0;
+    double counted = 0;
+    if( old != booked.end() )
+    {
+        filled = old->second.filled;
+        counted = old->second.notional;
+        if( old->second.slot == index )
+        {
+            replaced = old->second.side * old->second.remaining;
+        }
+    }
+    // orders that shrink the position always pass
+    auto before = s.position + s.working - replaced;
+    auto after = before + side * ( order.totalQuantity - filled );
+    if( fabs( after ) > s.limits.maxPosition && fabs( after ) > fabs( before ) )
+    {
+        return RiskVerdict::Position;
+    }
+    auto multiplier = atof( con.multiplier.c_str() );
+    auto notional = order.totalQuantity * price * ( multiplier > 0 ? multiplier : 1 );
+    if( notional > s.limits.maxOrderNotional )
+    {
+        return RiskVerdict::OrderNotional;
+    }
+    auto added = max( notional - counted, 0.0 );
+    if( book != nullptr && fabs( after ) > fabs( before ) && book->gross() + added > maxGross )
+    {
+        return RiskVerdict::GrossExposure;
+    }
+    if( now / NS_PER_DAY != day )
+    {
+        day = now / NS_PER_DAY;
+        dayNotional = 0;
+    }
+    if( dayNotional + added > maxDayNotional )
+    {
+        return RiskVerdict::DayNotional;
+    }
+    dayNotional += added;
+    if( old != booked.end() )
+    {
+        slots[old->second.slot].working -= old->second.side * old->second.remaining;
+    }
+    s.working += side * ( order.totalQuantity - filled );
+    s.lastOrder = now;
+    booked[orderId] = BookedOrder { index, side, filled, order.totalQuantity - filled, max( notional, counted ) };
+    return RiskVerdict::Accepted;
+}
+
+void RiskEngine::status( long orderId, double filled, double remaining )
+{
+    auto found = booked.find( orderId );
+    if( found == booked.end() )
+    {
+        return;
+    }
+    auto& b = found->second;
+    auto& s = slots[b.slot];
+    s.position += b.side * ( filled - b.filled );
+    s.working += b.side * ( remaining - b.remaining );
+    b.filled = filled;
+    b.remaining = remaining;
+    if( remaining <= 0 )
+    {
+        booked.erase( found );
+    }
+}
+
+const char* RiskEngine::name( RiskVerdict verdict )
+{
+    switch( verdict )
+    {
+        case RiskVerdict::Accepted:
+            return "accepted";
+        case RiskVerdict::NoPrice:
+            return "no price";
+        case RiskVerdict::PriceBand:
+            return "price band";
+        case RiskVerdict::Position:
+            return "position";
+        case RiskVerdict::OrderNotional:
+            return "order notional";
+        case RiskVerdict::DayNotional:
+            return "day notional";
+        case RiskVerdict::RateLimit:
+            return "rate limit";
+        case RiskVerdict::GrossExposure:
+            return "gross exposure";
+    }
+    return "unknown";
+}
@@ -0,0 +1,565 @@
+#include "SeriesCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+/// Zero bytes after every bit stream, so the reader can always load a full word
+constexpr size_t STREAM_PADDING = 8;
+/// Powers of ten the time column may be scaled down by, largest first
+constexpr int64_t TIME_SCALES[] = { 1000000000, 1000000, 1000, 1 };
+/// Powers of ten a double column may be scaled up by to make it integral
+constexpr double DECIMAL_SCALES[] = { 1, 10, 100, 1000, 10000 };
+/// First byte of a double column, decimal columns store the scale index plus one
+constexpr uint8_t DOUBLES_XOR = 0;
+
+namespace
+{
+    /// @brief Packs bit fields most significant bit first
+    class BitWriter
+    {
+    public:
+        explicit BitWriter( vector<uint8_t>& target ) : out( target ) {}
+        /// Appends the low n bits of a value, n <= 64
+        void write( uint64_t value, int n )
+        {
+            if( n == 0 )
+            {
+                return;
+            }
+            if( n < 64 )
+            {
+                value &= ( 1ULL << n ) - 1;
+            }
+            int space = 64 - fill;
+            if( n < space )
+            {
+                acc |= value << ( space - n );
+                fill += n;
+                return;
+            }
+            // the value straddles the word boundary
+            acc |= value >> ( n - space );
+            flush();
+            if( n > space )
+            {
+                fill = n - space;
+                acc = value << ( 64 - fill );
+            }
+        }
+        void finish()
+        {
+            for( int i = 0; i < ( fill + 7 ) / 8; i++ )
+            {
+                out.push_back( (uint8_t)( acc >> ( 56 - 8 * i ) ) );
+            }
+            out.insert( out.end(), STREAM_PADDING, 0 );
+            acc = 0;
+            fill = 0;
+        }
+
+    private:
+        void flush()
+        {
+            for( int i = 0; i < 8; i++ )
+            {
+                out.push_back( (uint8_t)( acc >> ( 56 - 8 * i ) ) );
+            }
+            acc = 0;
+            fill = 0;
+        }
+        vector<uint8_t>& out;
+        uint64_t         acc = 0;
+        int              fill = 0;
+    };
+
+    /// @brief Reads bit fields written by BitWriter
+    ///
+    /// Every read is one unaligned 8 byte load and two shifts, there is no refill
+    /// branch. The stream padding guarantees the load stays inside the buffer.
+    class BitReader
+    {
+    public:
+        BitReader( const uint8_t* data, size_t size ) : base( data ), bits( size * 8 ) {}
+        /// Reads n bits, n <= 56
+        uint64_t read( int n )
+        {
+            uint64_t word;
+            memcpy( &word, base + ( pos >> 3 ), sizeof( word ) );
+            word = __builtin_bswap64( word ) << ( pos & 7 );
+            pos += (size_t)n;
+            return n == 0 ? 0 : word >> ( 64 - n );
+        }
+        /// Next n bits without consuming them, n <= 56
+        uint64_t peek( int n )
+        {
+            uint64_t word;
+            memcpy( &word, base + ( pos >> 3 ), sizeof( word ) );
+            return ( __builtin_bswap64( word ) << ( pos & 7 ) ) >> ( 64 - n );
+        }
+        void     skip( int n ) { pos += (size_t)n; }
+        uint64_t read64()
+        {
+            uint64_t high = read( 32 );
+            return ( high << 32 ) | read( 32 );
+        }
+        /// Number of leading one bits, at most max, consuming the terminating zero
+        int ones( int max )
+        {
+            uint64_t word;
+            memcpy( &word, base + ( pos >> 3 ), sizeof( word ) );
+            word = __builtin_bswap64( word ) << ( pos & 7 );
+            int count = min( max, word == ~0ULL ? 64 : __builtin_clzll( ~word ) );
+            pos += (size_t)count + ( count < max ? 1 : 0 );
+            return count;
+        }
+        bool overrun() const { return pos + STREAM_PADDING * 8 > bits; }
+
+    private:
+        const uint8_t* base;
+        size_t         bits;
+        size_t         pos = 0;
+    };
+
+    uint64_t zigzag( int64_t v ) { return ( (uint64_t)v << 1 ) ^ (uint64_t)( v >> 63 ); }
+
+    int64_t unzigzag( uint64_t v ) { return (int64_t)( v >> 1 ) ^ -(int64_t)( v & 1 ); }
+
+    void putU32( vector<uint8_t>& out, uint32_t value )
+    {
+        uint8_t bytes[4];
+        memcpy( bytes, &value, sizeof( bytes ) );
+        out.insert( out.end(), bytes, bytes + sizeof( bytes ) );
+    }
+
+    uint32_t getU32( const uint8_t* in )
+    {
+        uint32_t value;
+        memcpy( &value, in, sizeof( value ) );
+        return value;
+    }
+
+    /// Bucket widths of the delta of delta encoding, the prefix selects the bucket
+    constexpr int DOD_BITS[] = { 0, 7, 9, 12, 32, 64 };
+    constexpr int DOD_BUCKETS = 6;
+
+    void encodeTimes( const int64_t* times, size_t rows, int64_t scale, vector<uint8_t>& out )
+    {
+        BitWriter bits( out );
+        int64_t   prev = times[0] / scale;
+        int64_t   prevDelta = 0;
+        bits.write( (uint64_t)prev, 64 );
+        for( size_t i = 1; i < rows; i++ )
+        {
+            int64_t t = times[i] / scale;
+            int64_t delta = t - prev;
+            int64_t dod = delta - prevDelta;
+            prev = t;
+            prevDelta = delta;
+            // bucket b is written as b ones, a zero unless it is the last bucket, then the value
+            int bucket = 0;
+            if( dod != 0 )
+            {
+                bucket = 1;
+                while( bucket < DOD_BUCKETS - 1 && ( dod < -( 1LL << ( DOD_BITS[bucket] - 1 ) ) ||
+                                                     dod >= ( 1LL << ( DOD_BITS[bucket] - 1 ) ) ) )
+                {
+                    bucket++;
+                }
+            }
+            if( bucket < DOD_BUCKETS - 1 )
+            {
+                bits.write( ( ( 1ULL << bucket ) - 1 ) << 1, bucket + 1 );
+            }
+            else
+            {
+                bits.write( ( 1ULL << bucket ) - 1, bucket );
+            }
+            bits.write( (uint64_t)dod, DOD_BITS[bucket] );
+        }
+        bits.finish();
+    }
+
+    bool decodeTimes( const uint8_t* in, size_t size, size_t rows, int64_t scale, int64_t* times )
+    {
+        BitReader bits( in, size );
+        int64_t   t = (int64_t)bits.read64();
+        int64_t   delta = 0;
+        times[0] = t * scale;
+        for( size_t i = 1; i < rows; i++ )
+        {
+            // a run of unchanged deltas is a run of zero bits, the normal case for bars
+            if( i + 56 <= rows && bits.peek( 56 ) == 0 )
+            {
+                for( size_t k = 0; k < 56; k++ )
+                {
+                    t += delta;
+                    times[i + k] = t * scale;
+                }
+                bits.skip( 56 );
+                i += 55;
+                continue;
+            }
+            int bucket = bits.ones( DOD_BUCKETS - 1 );
+            int width = DOD_BITS[bucket];
+            uint64_t raw = width == 64 ? bits.read64() : bits.read( width );
+            // sign extend the bucket value, a zero width bucket yields zero
+            int64_t dod = width == 0 ? 0 : (int64_t)( raw << ( 64 - width ) ) >> ( 64 - width );
+            delta += dod;
+            t += delta;
+            times[i] = t * scale;
+        }
+        return !bits.overrun();
+    }
+
+    void encodeXor( const int64_t* values, size_t rows, vector<uint8_t>& out )
+    {
+        BitWriter bits( out );
+        auto      prev = (uint64_t)values[0];
+        int       prevLead = 65;
+        int       prevTrail = 0;
+        bits.write( prev, 64 );
+        for( size_t i = 1; i < rows; i++ )
+        {
+            auto     v = (uint64_t)values[i];
+            uint64_t x = v ^ prev;
+            prev = v;
+            if( x == 0 )
+            {
+                bits.write( 0, 1 );
+                continue;
+            }
+            int lead = min( __builtin_clzll( x ), 31 );
+            int trail = __builtin_ctzll( x );
+            if( lead >= prevLead && trail >= prevTrail )
+            {
+                // the meaningful bits fit the previous window
+                bits.write( 0b10, 2 );
+                bits.write( x >> prevTrail, 64 - prevLead - prevTrail );
+            }
+            else
+            {
+                int length = 64 - lead - trail;
+                bits.write( 0b11, 2 );
+                bits.write( (uint64_t)lead, 5 );
+                bits.write( (uint64_t)( length - 1 ), 6 );
+                bits.write( x >> trail, length );
+                prevLead = lead;
+                prevTrail = trail;
+            }
+        }
+        bits.finish();
+    }
+
+    bool decodeXor( const uint8_t* in, size_t size, size_t rows, int64_t* values )
+    {
+        BitReader bits( in, size );
+        uint64_t  prev = bits.read64();
+        int       lead = 0;
+        int       trail = 0;
+        values[0] = (int64_t)prev;
+        for( size_t i = 1; i < rows; i++ )
+        {
+            int control = bits.ones( 2 );
+            if( control == 2 )
+            {
+                lead = (int)bits.read( 5 );
+                int length = (int)bits.read( 6 ) + 1;
+                trail = 64 - lead - length;
+            }
+            if( control != 0 )
+            {
+                int      length = 64 - lead - trail;
+                uint64_t x = length > 56 ? ( bits.read( length - 32 ) << 32 ) | bits.read( 32 ) : bits.read( length );
+                prev ^= x << trail;
+            }
+            values[i] = (int64_t)prev;
+        }
+        return !bits.overrun();
+    }
+
+    void encodeInts( const int64_t* values, size_t rows, vector<uint8_t>& out )
+    {
+        int64_t prev = 0;
+        for( size_t i = 0; i < rows; i++ )
+        {
+            uint64_t v = zigzag( (int64_t)( (uint64_t)values[i] - (uint64_t)prev ) );
+            prev = values[i];
+            while( v >= 0x80 )
+            {
+                out.push_back( (uint8_t)( v | 0x80 ) );
+                v >>= 7;
+            }
+            out.push_back( (uint8_t)v );
+        }
+        out.insert( out.end(), STREAM_PADDING, 0 );
+    }
+
+    bool decodeInts( const uint8_t* in, size_t size, size_t rows, int64_t* values )
+    {
+        const uint8_t* pos = in;
+        const uint8_t* end = in + size - STREAM_PADDING;
+        int64_t        prev = 0;
+        size_t         i = 0;
+        while( i < rows && pos < end )
+        {
+            uint64_t word;
+            memcpy( &word, pos, sizeof( word ) );
+            // eight single byte deltas in a row, the common case for volumes and sizes
+            if( ( word & 0x8080808080808080ULL ) == 0 && i + 8 <= rows && pos + 8 <= end )
+            {
+                for( int b = 0; b < 8; b++ )
+                {
+                    prev += unzigzag( ( word >> ( 8 * b ) ) & 0xFF );
+                    values[i + b] = prev;
+                }
+                i += 8;
+                pos += 8;
+                continue;
+            }
+            uint64_t v = 0;
+            int      shift = 0;
+            while( pos < end && ( *pos & 0x80 ) != 0 && shift < 63 )
+            {
+                v |= (uint64_t)( *pos++ & 0x7F ) << shift;
+                shift += 7;
+            }
+            if( pos >= end )
+            {
+                return false;
+            }
+            v |= (uint64_t)*pos++ << shift;
+            prev = (int64_t)( (uint64_t)prev + (uint64_t)unzigzag( v ) );
+            values[i++] = prev;
+        }
+        return i == rows;
+    }
+
+    /// Smallest power of ten that turns every value of a double column into an
+    /// integer which converts back to exactly the same double, -1 if there is none
+    int decimalScale( const int64_t* values, size_t rows )
+    {
+        for( int s = 0; s < (int)( sizeof( DECIMAL_SCALES ) / sizeof( DECIMAL_SCALES[0] ) ); s++ )
+        {
+            bool exact = true;
+            for( size_t i = 0; i < rows && exact; i++ )
+            {
+                double v;
+                memcpy( &v, &values[i], sizeof( v ) );
+                double scaled = nearbyint( v * DECIMAL_SCALES[s] );
+                double back = scaled / DECIMAL_SCALES[s];
+                exact = fabs( scaled ) < 9007199254740992.0 && memcmp( &back, &values[i], sizeof( back ) ) == 0;
+            }
+            if( exact )
+            {
+                return s;
+            }
+        }
+        return -1;
+    }
+
+    /// Prices sit on a decimal tick grid, where the scaled integers delta encode far
+    /// better than the XOR of the doubles. Anything off the grid falls back to XOR.
+    void encodeDoubles( const int64_t* values, size_t rows, vector<uint8_t>& out )
+    {
+        int scale = decimalScale( values, rows );
+        if( scale < 0 )
+        {
+            out.push_back( DOUBLES_XOR );
+            encodeXor( values, rows, out );
+            return;
+        }
+        out.push_back( (uint8_t)( scale + 1 ) );
+        auto scaled = vector<int64_t>( rows );
+        for( size_t i = 0; i < rows; i++ )
+        {
+            double v;
+            memcpy( &v, &values[i], sizeof( v ) );
+            scaled[i] = (int64_t)nearbyint( v * DECIMAL_SCALES[scale] );
+        }
+        encodeInts( scaled.data(), rows, out );
+    }
+
+    bool decodeDoubles( const uint8_t* in, size_t size, size_t rows, int64_t* values )
+    {
+        uint8_t mode = in[0];
+        if( mode == DOUBLES_XOR )
+        {
+            return decodeXor( in + 1, size - 1, rows, values );
+        }
+        if( mode > sizeof( DECIMAL_SCALES ) / sizeof( DECIMAL_SCALES[0] ) || !decodeInts( in + 1, size - 1, rows, values ) )
+        {
+            return false;
+        }
+        double scale = DECIMAL_SCALES[mode - 1];
+        for( size_t i = 0; i < rows; i++ )
+        {
+            double v = (double)values[i] / scale;
+            memcpy( &values[i], &v, sizeof( v ) );
+        }
+        return true;
+    }
+
+    /// Largest power of ten dividing every time of a block
+    uint8_t timeScale( const int64_t* times, size_t rows )
+    {
+        for( uint8_t s = 0; s < sizeof( TIME_SCALES ) / sizeof( TIME_SCALES[0] ); s++ )
+        {
+            if( all_of( times, times + rows, [&]( int64_t t ) { return t % TIME_SCALES[s] == 0; } ) )
+            {
+                return s;
+            }
+        }
+        return (uint8_t)( sizeof( TIME_SCALES ) / sizeof( TIME_SCALES[0] ) - 1 );
+    }
+} // namespace
+
+vector<uint8_t> SeriesCodec::encodeBlock( const vector<ColumnType>& types, const vector<const int64_t*>& columns, size_t rows )
+{
+    auto out = vector<uint8_t>();
+    putU32( out, (uint32_t)rows );
+    if( rows == 0 )
+    {
+        return out;
+    }
+    auto scale = timeScale( columns[0], rows );
+    out.push_back( scale );
+    auto stream = vector<uint8_t>();
+    for( size_t c = 0; c < types.size(); c++ )
+    {
+        stream.clear();
+        if( c == 0 )
+        {
+            encodeTimes( columns[c], rows, TIME_SCALES[scale], stream );
+        }
+        else if( types[c] == ColumnType::Double )
+        {
+            encodeDoubles( columns[c], rows, stream );
+        }
+        else
+        {
+            encodeInts( columns[c], rows, stream );
+        }
+        putU32( out, (uint32_t)stream.size() );
+        out.insert( out.end(), stream.begin(), stream.end() );
+    }
+    return out;
+}
+
+bool SeriesCodec::decodeBlock( const vector<ColumnType>& types, const uint8_t* in, size_t size, vector<vector<int64_t>>& columns )
+{
+    if( size < sizeof( uint32_t ) )
+    {
+        return false;
+    }
+    size_t rows = getU32( in );
+    size_t pos = sizeof( uint32_t );
+    columns.resize( types.size() );
+    if( rows == 0 )
+    {
+        return true;
+    }
+    if( pos >= size || in[pos] >= sizeof( TIME_SCALES ) / sizeof( TIME_SCALES[0] ) )
+    {
+        return false;
+    }
+    auto scale = TIME_SCALES[in[pos++]];
+    for( size_t c = 0; c < types.size(); c++ )
+    {
+        if( pos + sizeof( uint32_t ) > size )
+        {
+            return false;
+        }
+        size_t length = getU32( in + pos );
+        pos += sizeof( uint32_t );
+        if( length <= STREAM_PADDING || pos + length > size )
+        {
+            return false;
+        }
+        auto& column = columns[c];
+        auto  first = column.size();
+        column.resize( first + rows );
+        bool ok;
+        if( c == 0 )
+        {
+            ok = decodeTimes( in + pos, length, rows, scale, column.data() + first );
+        }
+        else if( types[c] == ColumnType::Double )
+        {
+            ok = decodeDoubles( in + pos, length, rows, column.data() + first );
+        }
+        else
+        {
+            ok = decodeInts( in + pos, length, rows, column.data() + first );
+        }
+        if( !ok )
+        {
+            return false;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+vector<uint8_t> SeriesCodec::encode( const vector<ColumnType>& types, const vector<const int64_t*>& columns, size_t rows,
+                                     vector<BlockInfo>& blocks )
+{
+    auto out = vector<uint8_t>();
+    auto view = vector<const int64_t*>( columns.size() );
+    blocks.clear();
+    for( size_t first = 0; first < rows; first += CODEC_BLOCK_ROWS )
+    {
+        auto count = min( CODEC_BLOCK_ROWS, rows - first );
+        for( size_t c = 0; c < columns.size(); c++ )
+        {
+            view[c] = columns[c] + first;
+        }
+        auto block = encodeBlock( types, view, count );
+        blocks.push_back( BlockInfo { columns[0][first], columns[0][first + count - 1], out.size(), block.size(), count } );
+        out.insert( out.end(), block.begin(), block.end() );
+    }
+    return out;
+}
+
+bool SeriesCodec::decode( const vector<ColumnType>& types, const uint8_t* in, const vector<BlockInfo>& blocks,
+                          DecodedSeries& series, int64_t from, int64_t to )
+{
+    series.columns.assign( types.size(), vector<int64_t>() );
+    size_t total = 0;
+    for( const auto& block : blocks )
+    {
+        if( block.lastTime >= from && block.firstTime < to )
+        {
+            total += block.rows;
+        }
+    }
+    for( auto& column : series.columns )
+    {
+        column.reserve( total );
+    }
+    for( const auto& block : blocks )
+    {
+        if( block.lastTime < from || block.firstTime >= to )
+        {
+            continue;
+        }
+        if( !decodeBlock( types, in + block.offset, block.size, series.columns ) )
+        {
+            series.columns.assign( types.size(), vector<int64_t>() );
+            return false;
+        }
+    }
+    // the first and last blocks may stick out of the range
+    const auto& t = series.columns[0];
+    size_t      begin = (size_t)( lower_bound( t.begin(), t.end(), from ) - t.begin() );
+    size_t      end = (size_t)( lower_bound( t.begin(), t.end(), to ) - t.begin() );
+    if( begin > 0 || end < t.size() )
+    {
+        for( auto& column : series.columns )
+        {
+            column = vector<int64_t>( column.begin() + (long)begin, column.begin() + (long)end );
+        }
+    }
+    return true;
+}
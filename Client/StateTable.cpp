@@ -0,0 +1,72 @@
+#include "StateTable.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+using namespace std;
+using namespace ClientSpace;
+
+StateTimer::StateTimer()
+{
+    entered.fill( 0 );
+    spent.fill( 0 );
+    state = CONNECT;
+    since = 0;
+    strays = 0;
+}
+
+void StateTimer::observe( State next, int64_t now )
+{
+    if( since == 0 )
+    {
+        entered[next]++;
+        state = next;
+        since = now;
+        return;
+    }
+    spent[state] += now - since;
+    since = now;
+    if( next == state )
+    {
+        return;
+    }
+    if( !allowed( state, next ) )
+    {
+        strays++;
+        spdlog::debug( string( "Unexpected state change from " ) + stateName( state ) + " to " + stateName( next ) );
+    }
+    entered[next]++;
+    state = next;
+}
+
+uint64_t StateTimer::entries( State s ) const { return entered[s]; }
+
+int64_t StateTimer::time( State s ) const { return spent[s]; }
+
+State StateTimer::current() const { return state; }
+
+uint64_t StateTimer::unexpected() const { return strays; }
+
+string StateTimer::summary() const
+{
+    auto order = vector<size_t>();
+    for( size_t i = 0; i < STATE_COUNT; i++ )
+    {
+        if( entered[i] > 0 )
+        {
+            order.push_back( i );
+        }
+    }
+    sort( order.begin(), order.end(), [this]( size_t a, size_t b ) { return spent[a] > spent[b]; } );
+    string out;
+    for( auto i : order )
+    {
+        out += string( STATE_NAMES[i] ) + ": entered " + to_string( entered[i] ) + " times, " +
+               to_string( (double)spent[i] / 1e9 ) + " s\n";
+    }
+    if( strays > 0 )
+    {
+        out += to_string( strays ) + " state changes outside the state table\n";
+    }
+    return out;
+}
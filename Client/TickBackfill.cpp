@@ -0,0 +1,240 @@
+#include "TickBackfill.h"
+#include "HarvestPlanner.h"
+#include "TickStream.h"
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+using namespace std;
+
+constexpr int64_t NS_PER_SECOND = 1000000000;
+
+namespace
+{
+    void put( RawRow& row, size_t column, double value ) { memcpy( &row.values[column], &value, sizeof( uint64_t ) ); }
+
+    void put( RawRow& row, size_t column, int64_t value ) { memcpy( &row.values[column], &value, sizeof( uint64_t ) ); }
+
+    /// Series name and kind of a tick type
+    pair<string, SeriesKind> target( const string& whatToShow )
+    {
+        if( whatToShow == "BID_ASK" )
+        {
+            return { "quotes", SeriesKind::Snaps };
+        }
+        if( whatToShow == "MIDPOINT" )
+        {
+            return { "midpoints", SeriesKind::Trades };
+        }
+        return { "trades", SeriesKind::Trades };
+    }
+} // namespace
+
+TickBackfill::TickBackfill()
+{
+    series = vector<Series>();
+    waiting = deque<size_t>();
+    inFlight = map<long, size_t>();
+}
+
+void TickBackfill::add( const Contract& con, int64_t from, int64_t to, const string& whatToShow )
+{
+    waiting.push_back( series.size() );
+    series.push_back( Series { con, whatToShow, from, to, vector<RawRow>(), 0, 0, 0, 0, 0, false } );
+}
+
+bool TickBackfill::ready() const { return !waiting.empty() && inFlight.size() < TICK_PAGES_OPEN; }
+
+bool TickBackfill::next( long reqId, Contract& con, string& start, string& whatToShow )
+{
+    if( !ready() )
+    {
+        return false;
+    }
+    auto  index = waiting.front();
+    auto& s = series[index];
+    waiting.pop_front();
+    inFlight[reqId] = index;
+    con = s.contract;
+    // TWS reads times without a zone in its own login timezone
+    start = HarvestPlanner::endDateTime( s.from );
+    whatToShow = s.whatToShow;
+    return true;
+}
+
+bool TickBackfill::contains( long reqId ) const { return inFlight.find( reqId ) != inFlight.end(); }
+
+TickBackfill::Series* TickBackfill::page( long reqId )
+{
+    auto found = inFlight.find( reqId );
+    return found != inFlight.end() ? &series[found->second] : nullptr;
+}
+
+void TickBackfill::ticks( long reqId, const vector<HistoricalTick>& ticks )
+{
+    auto* s = page( reqId );
+    if( s == nullptr )
+    {
+        return;
+    }
+    auto first = s->rows.size();
+    s->rows.resize( first + ticks.size() );
+    auto* row = s->rows.data() + first;
+    for( const auto& tick : ticks )
+    {
+        row->time = (int64_t)tick.time;
+        put( *row, 0, tick.price );
+        put( *row, 1, (int64_t)tick.size );
+        put( *row, 2, (int64_t)0 );
+        row++;
+    }
+}
+
+void TickBackfill::ticks( long reqId, const vector<HistoricalTickBidAsk>& ticks )
+{
+    auto* s = page( reqId );
+    if( s == nullptr )
+    {
+        return;
+    }
+    auto first = s->rows.size();
+    s->rows.resize( first + ticks.size() );
+    auto* row = s->rows.data() + first;
+    for( const auto& tick : ticks )
+    {
+        row->time = (int64_t)tick.time;
+        put( *row, 0, tick.priceBid );
+        put( *row, 1, tick.priceAsk );
+        put( *row, 2, (int64_t)tick.sizeBid );
+        put( *row, 3, (int64_t)tick.sizeAsk );
+        row++;
+    }
+}
+
+void TickBackfill::ticks( long reqId, const vector<HistoricalTickLast>& ticks )
+{
+    auto* s = page( reqId );
+    if( s == nullptr )
+    {
+        return;
+    }
+    auto first = s->rows.size();
+    s->rows.resize( first + ticks.size() );
+    auto* row = s->rows.data() + first;
+    for( const auto& tick : ticks )
+    {
+        row->time = (int64_t)tick.time;
+        put( *row, 0, tick.price );
+        put( *row, 1, (int64_t)tick.size );
+        put( *row, 2, ( tick.tickAttribLast.pastLimit ? TRADE_PAST_LIMIT : 0 ) |
+                            ( tick.tickAttribLast.unreported ? TRADE_UNREPORTED : 0 ) );
+        row++;
+    }
+}
+
+void TickBackfill::done( long reqId )
+{
+    auto* s = page( reqId );
+    if( s == nullptr )
+    {
+        return;
+    }
+    auto index = inFlight[reqId];
+    inFlight.erase( reqId );
+    auto& rows = s->rows;
+    auto  begin = s->pageStart;
+    auto  received = rows.size() - begin;
+    // ticks past the end of the window are not wanted
+    while( rows.size() > begin && rows.back().time >= s->to )
+    {
+        rows.pop_back();
+    }
+    bool more = (int)received >= TICK_PAGE_SIZE && rows.size() - begin == received;
+    if( more )
+    {
+        auto last = rows.back().time;
+        if( last > rows[begin].time )
+        {
+            // the next page starts at the last second and returns all of it
+            while( rows.back().time == last )
+            {
+                rows.pop_back();
+            }
+            s->from = last;
+        }
+        else
+        {
+            s->from = last + 1;
+        }
+    }
+    for( size_t i = begin; i < rows.size(); i++ )
+    {
+        auto second = rows[i].time;
+        if( second > s->second )
+        {
+            s->second = second;
+            s->sequence = 0;
+        }
+        else
+        {
+            s->sequence++;
+        }
+        rows[i].time = s->second * NS_PER_SECOND + s->sequence;
+    }
+    s->pageStart = rows.size();
+    s->pages++;
+    s->retries = 0;
+    if( more )
+    {
+        waiting.push_back( index );
+    }
+    else
+    {
+        s->finished = true;
+        spdlog::info( "Backfilled " + to_string( rows.size() ) + " " + s->whatToShow + " ticks of " +
+                      s->contract.symbol + " in " + to_string( s->pages ) + " pages" );
+    }
+}
+
+void TickBackfill::failed( long reqId )
+{
+    auto* s = page( reqId );
+    if( s == nullptr )
+    {
+        return;
+    }
+    auto index = inFlight[reqId];
+    inFlight.erase( reqId );
+    s->rows.resize( s->pageStart );
+    if( ++s->retries <= TICK_PAGE_RETRIES )
+    {
+        waiting.push_back( index );
+    }
+    else
+    {
+        spdlog::error( "Giving up the " + s->whatToShow + " tick backfill of " + s->contract.symbol +
+                       " after " + to_string( s->pages ) + " pages" );
+        s->finished = true;
+    }
+}
+
+size_t TickBackfill::store( HistoryStore& history, bool all )
+{
+    size_t written = 0;
+    for( auto& s : series )
+    {
+        if( ( !s.finished && !all ) || s.pageStart == 0 )
+        {
+            continue;
+        }
+        // a page still in flight is not stamped yet
+        s.rows.resize( s.pageStart );
+        auto name = target( s.whatToShow );
+        written += s.rows.size();
+        history.write( s.contract.conId, name.first, name.second, move( s.rows ) );
+        s.rows = vector<RawRow>();
+        s.pageStart = 0;
+    }
+    return written;
+}
+
+bool TickBackfill::finished() const { return waiting.empty() && inFlight.empty(); }
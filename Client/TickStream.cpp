@@ -0,0 +1,142 @@
+#include "TickStream.h"
+#include <algorithm>
+
+using namespace std;
+
+constexpr int64_t NS_PER_SECOND = 1000000000;
+
+TickStreams::TickStreams()
+{
+    streams = map<long, TickStream>();
+    fed = set<pair<long, int>>();
+    capacity = MAXIMUM_TICK_STREAMS;
+}
+
+TickStream& TickStreams::add( long id, const Contract& con, TickKind kind, int priority, long line )
+{
+    auto& stream = streams[id];
+    stream.contract = con;
+    stream.kind = kind;
+    stream.priority = priority;
+    stream.line = line;
+    stream.active = false;
+    stream.second = 0;
+    stream.sequence = 0;
+    stream.received = 0;
+    return stream;
+}
+
+bool TickStreams::remove( long id )
+{
+    auto found = streams.find( id );
+    if( found == streams.end() )
+    {
+        return false;
+    }
+    fed.erase( make_pair( found->second.line, (int)found->second.kind ) );
+    streams.erase( found );
+    return true;
+}
+
+TickStream* TickStreams::find( long id )
+{
+    auto found = streams.find( id );
+    return found != streams.end() ? &found->second : nullptr;
+}
+
+const TickStream* TickStreams::find( long id ) const
+{
+    auto found = streams.find( id );
+    return found != streams.end() ? &found->second : nullptr;
+}
+
+const map<long, TickStream>& TickStreams::all() const { return streams; }
+
+void TickStreams::limit( int slots ) { capacity = max( slots, 0 ); }
+
+int TickStreams::limit() const { return capacity; }
+
+void TickStreams::allocate( vector<long>& stop, vector<long>& start )
+{
+    auto ranked = vector<pair<int, long>>();
+    for( const auto& stream : streams )
+    {
+        ranked.emplace_back( -stream.second.priority, stream.first );
+    }
+    sort( ranked.begin(), ranked.end() );
+    fed.clear();
+    for( size_t i = 0; i < ranked.size(); i++ )
+    {
+        auto& stream = streams[ranked[i].second];
+        bool  wanted = (int)i < capacity;
+        if( stream.active && !wanted )
+        {
+            stop.push_back( ranked[i].second );
+        }
+        else if( !stream.active && wanted )
+        {
+            start.push_back( ranked[i].second );
+        }
+        stream.active = wanted;
+        if( wanted && stream.line != 0 )
+        {
+            fed.emplace( stream.line, (int)stream.kind );
+        }
+    }
+}
+
+bool TickStreams::refuse( long id )
+{
+    auto* stream = find( id );
+    if( stream == nullptr || !stream->active )
+    {
+        return false;
+    }
+    stream->active = false;
+    fed.erase( make_pair( stream->line, (int)stream->kind ) );
+    capacity = (int)count_if( streams.begin(), streams.end(),
+                              []( const pair<const long, TickStream>& entry ) { return entry.second.active; } );
+    return true;
+}
+
+bool TickStreams::feeds( long line, TickKind kind ) const
+{
+    return !fed.empty() && fed.count( make_pair( line, (int)kind ) ) != 0;
+}
+
+TickStream* TickStreams::trade( long id, int64_t second, double price, int64_t size, int64_t flags )
+{
+    auto* stream = find( id );
+    if( stream != nullptr )
+    {
+        stream->trades.push_back( TradeRow { stamp( *stream, second ), price, size, flags } );
+    }
+    return stream;
+}
+
+TickStream* TickStreams::quote( long id, int64_t second, double bidPrice, double askPrice,
+                                int64_t bidSize, int64_t askSize )
+{
+    auto* stream = find( id );
+    if( stream != nullptr )
+    {
+        stream->quotes.push_back( QuoteRow { stamp( *stream, second ), bidPrice, askPrice, bidSize, askSize } );
+    }
+    return stream;
+}
+
+int64_t TickStreams::stamp( TickStream& stream, int64_t second )
+{
+    // a second that went backwards is kept in the last one so the times still increase
+    if( second > stream.second )
+    {
+        stream.second = second;
+        stream.sequence = 0;
+    }
+    else
+    {
+        stream.sequence++;
+    }
+    stream.received++;
+    return stream.second * NS_PER_SECOND + stream.sequence;
+}
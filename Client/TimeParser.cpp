@@ -0,0 +1,135 @@
+#include "TimeParser.h"
+#include <ctime>
+
+using namespace std;
+
+constexpr int64_t NS_PER_SECOND = 1000000000;
+constexpr int64_t SECONDS_PER_DAY = 86400;
+
+namespace
+{
+    inline bool digit( char c ) { return c >= '0' && c <= '9'; }
+
+    /// Value of count digits, -1 when one of them is not a digit
+    inline int digits( const char* text, int count )
+    {
+        int value = 0;
+        for( int i = 0; i < count; i++ )
+        {
+            if( !digit( text[i] ) )
+            {
+                return -1;
+            }
+            value = value * 10 + ( text[i] - '0' );
+        }
+        return value;
+    }
+
+    /// Days from 1970-01-01 to a civil date
+    int64_t daysFromCivil( int year, int month, int day )
+    {
+        year -= month <= 2;
+        int64_t era = ( year >= 0 ? year : year - 399 ) / 400;
+        int64_t yearOfEra = year - era * 400;
+        int64_t dayOfYear = ( 153 * ( month + ( month > 2 ? -3 : 9 ) ) + 2 ) / 5 + day - 1;
+        int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + dayOfEra - 719468;
+    }
+
+    int64_t localMktime( int year, int month, int day, int hour, int minute, int second )
+    {
+        struct tm parts
+        {
+        };
+        parts.tm_year = year - 1900;
+        parts.tm_mon = month - 1;
+        parts.tm_mday = day;
+        parts.tm_hour = hour;
+        parts.tm_min = minute;
+        parts.tm_sec = second;
+        parts.tm_isdst = -1;
+        return (int64_t)mktime( &parts );
+    }
+} // namespace
+
+TimeParser::TimeParser()
+{
+    cachedDate = -1;
+    cachedMidnight = 0;
+    cachedLength = 0;
+}
+
+int64_t TimeParser::parse( const string& text ) { return parse( text.data(), text.size() ); }
+
+int64_t TimeParser::parse( const char* text, size_t size )
+{
+    if( size < 8 )
+    {
+        return 0;
+    }
+    // epoch seconds are all digits and never 8 long
+    if( size != 8 && digit( text[8] ) )
+    {
+        int64_t seconds = 0;
+        for( size_t i = 0; i < size && digit( text[i] ); i++ )
+        {
+            seconds = seconds * 10 + ( text[i] - '0' );
+        }
+        return seconds * NS_PER_SECOND;
+    }
+    int year = digits( text, 4 );
+    int month = digits( text + 4, 2 );
+    int day = digits( text + 6, 2 );
+    if( year < 0 || month < 1 || month > 12 || day < 1 || day > 31 )
+    {
+        return 0;
+    }
+    int  hour = 0, minute = 0, second = 0;
+    bool utcTime = size > 8 && text[8] == '-';
+    if( size > 8 )
+    {
+        // one separator for bar times, two spaces for execution times
+        size_t at = 9;
+        while( at < size && text[at] == ' ' )
+        {
+            at++;
+        }
+        if( at + 8 <= size && text[at + 2] == ':' && text[at + 5] == ':' )
+        {
+            hour = digits( text + at, 2 );
+            minute = digits( text + at + 3, 2 );
+            second = digits( text + at + 6, 2 );
+            if( hour < 0 || minute < 0 || second < 0 )
+            {
+                return 0;
+            }
+        }
+    }
+    if( utcTime )
+    {
+        return utc( year, month, day, hour, minute, second ) * NS_PER_SECOND;
+    }
+    return local( year, month, day, hour, minute, second ) * NS_PER_SECOND;
+}
+
+int64_t TimeParser::utc( int year, int month, int day, int hour, int minute, int second )
+{
+    return daysFromCivil( year, month, day ) * SECONDS_PER_DAY + hour * 3600 + minute * 60 + second;
+}
+
+int64_t TimeParser::local( int year, int month, int day, int hour, int minute, int second )
+{
+    int date = year * 10000 + month * 100 + day;
+    if( date != cachedDate )
+    {
+        cachedDate = date;
+        cachedMidnight = localMktime( year, month, day, 0, 0, 0 );
+        cachedLength = localMktime( year, month, day + 1, 0, 0, 0 ) - cachedMidnight;
+    }
+    if( cachedLength != SECONDS_PER_DAY )
+    {
+        // the clocks change on this date
+        return localMktime( year, month, day, hour, minute, second );
+    }
+    return cachedMidnight + hour * 3600 + minute * 60 + second;
+}
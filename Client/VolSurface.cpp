@@ -0,0 +1,212 @@
+#include "VolSurface.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+constexpr int64_t NS_PER_DAY = 86400LL * 1000000000LL;
+constexpr double  NS_PER_YEAR = 365.0 * 86400.0 * 1e9;
+/// Largest strike bucket table of one expiry, coarser steps above it
+constexpr size_t MAX_STRIKE_BUCKETS = 1 << 16;
+/// Strikes closer than this are the same strike
+constexpr double STRIKE_EPSILON = 1e-6;
+
+VolSurface::VolSurface()
+{
+    smiles = vector<Smile>();
+    options = vector<pair<int64_t, double>>();
+    values = vector<double>();
+    cells = vector<pair<uint32_t, uint32_t>>();
+    days = vector<uint32_t>();
+}
+
+void VolSurface::add( size_t slot, int64_t expiry, double strike )
+{
+    if( slot >= options.size() )
+    {
+        options.resize( slot + 1, make_pair( 0, 0.0 ) );
+        values.resize( slot + 1, numeric_limits<double>::quiet_NaN() );
+    }
+    options[slot] = make_pair( expiry, strike );
+    index();
+}
+
+void VolSurface::update( size_t slot, double iv )
+{
+    if( slot >= cells.size() )
+    {
+        return;
+    }
+    values[slot] = iv;
+    smiles[cells[slot].first].vols[cells[slot].second] = iv;
+}
+
+double VolSurface::vol( double strike, int64_t expiry, int64_t now ) const
+{
+    const double nan = numeric_limits<double>::quiet_NaN();
+    if( smiles.empty() )
+    {
+        return nan;
+    }
+    // the last expiry at or before the wanted one, through the day table
+    size_t at = 0;
+    if( expiry > smiles.front().expiry )
+    {
+        auto day = (size_t)( ( expiry - smiles.front().expiry ) / NS_PER_DAY );
+        at = days[min( day, days.size() - 1 )];
+        if( at + 1 < smiles.size() && smiles[at + 1].expiry <= expiry )
+        {
+            at++;
+        }
+    }
+    auto near = smileVol( smiles[at], strike );
+    if( expiry <= smiles[at].expiry || at + 1 == smiles.size() )
+    {
+        return near;
+    }
+    auto far = smileVol( smiles[at + 1], strike );
+    if( std::isnan( near ) || std::isnan( far ) )
+    {
+        return std::isnan( near ) ? far : near;
+    }
+    // linear in total variance between the two expiries
+    double t = (double)( expiry - now ) / NS_PER_YEAR;
+    double t0 = (double)( smiles[at].expiry - now ) / NS_PER_YEAR;
+    double t1 = (double)( smiles[at + 1].expiry - now ) / NS_PER_YEAR;
+    if( t <= 0 || t0 <= 0 || t1 <= t0 )
+    {
+        return near;
+    }
+    double w = ( t - t0 ) / ( t1 - t0 );
+    double variance = ( 1 - w ) * near * near * t0 + w * far * far * t1;
+    return sqrt( max( variance, 0.0 ) / t );
+}
+
+vector<int64_t> VolSurface::expiries() const
+{
+    auto out = vector<int64_t>();
+    for( const auto& smile : smiles )
+    {
+        out.push_back( smile.expiry );
+    }
+    return out;
+}
+
+const vector<double>& VolSurface::strikes( size_t expiry ) const { return smiles[expiry].strikes; }
+
+double VolSurface::at( size_t expiry, size_t strike ) const { return smiles[expiry].vols[strike]; }
+
+void VolSurface::index()
+{
+    auto expiryList = vector<int64_t>();
+    for( const auto& option : options )
+    {
+        expiryList.push_back( option.first );
+    }
+    sort( expiryList.begin(), expiryList.end() );
+    expiryList.erase( unique( expiryList.begin(), expiryList.end() ), expiryList.end() );
+
+    smiles = vector<Smile>( expiryList.size() );
+    for( size_t e = 0; e < expiryList.size(); e++ )
+    {
+        smiles[e].expiry = expiryList[e];
+    }
+    for( const auto& option : options )
+    {
+        auto e = (size_t)( lower_bound( expiryList.begin(), expiryList.end(), option.first ) - expiryList.begin() );
+        smiles[e].strikes.push_back( option.second );
+    }
+    for( auto& smile : smiles )
+    {
+        auto& k = smile.strikes;
+        sort( k.begin(), k.end() );
+        k.erase( unique( k.begin(), k.end(), []( double a, double b ) { return fabs( a - b ) < STRIKE_EPSILON; } ), k.end() );
+        smile.vols = vector<double>( k.size(), numeric_limits<double>::quiet_NaN() );
+        // the smallest gap gives at most one strike per bucket
+        smile.low = k.front();
+        smile.step = numeric_limits<double>::max();
+        for( size_t i = 1; i < k.size(); i++ )
+        {
+            smile.step = min( smile.step, k[i] - k[i - 1] );
+        }
+        double range = k.back() - k.front();
+        if( k.size() < 2 || range <= 0 )
+        {
+            smile.step = 1;
+            range = 0;
+        }
+        smile.step = max( smile.step, range / (double)MAX_STRIKE_BUCKETS );
+        auto count = (size_t)( range / smile.step ) + 1;
+        smile.buckets = vector<uint32_t>( count );
+        size_t i = 0;
+        for( size_t b = 0; b < count; b++ )
+        {
+            double edge = smile.low + (double)b * smile.step + STRIKE_EPSILON;
+            while( i + 1 < k.size() && k[i + 1] <= edge )
+            {
+                i++;
+            }
+            smile.buckets[b] = (uint32_t)i;
+        }
+    }
+
+    cells = vector<pair<uint32_t, uint32_t>>( options.size() );
+    for( size_t slot = 0; slot < options.size(); slot++ )
+    {
+        auto  e = (size_t)( lower_bound( expiryList.begin(), expiryList.end(), options[slot].first ) - expiryList.begin() );
+        auto& smile = smiles[e];
+        auto  s = lower( smile, options[slot].second );
+        cells[slot] = make_pair( (uint32_t)e, (uint32_t)s );
+        smile.vols[s] = values[slot];
+    }
+
+    days = vector<uint32_t>();
+    if( !smiles.empty() )
+    {
+        auto   span = (size_t)( ( smiles.back().expiry - smiles.front().expiry ) / NS_PER_DAY ) + 1;
+        size_t e = 0;
+        for( size_t d = 0; d < span; d++ )
+        {
+            auto edge = smiles.front().expiry + (int64_t)d * NS_PER_DAY;
+            while( e + 1 < smiles.size() && smiles[e + 1].expiry <= edge )
+            {
+                e++;
+            }
+            days.push_back( (uint32_t)e );
+        }
+    }
+}
+
+size_t VolSurface::lower( const Smile& smile, double strike ) const
+{
+    if( strike <= smile.low )
+    {
+        return 0;
+    }
+    auto b = min( (size_t)( ( strike - smile.low ) / smile.step ), smile.buckets.size() - 1 );
+    size_t i = smile.buckets[b];
+    // with the smallest gap as the step this runs at most once
+    while( i + 1 < smile.strikes.size() && smile.strikes[i + 1] <= strike + STRIKE_EPSILON )
+    {
+        i++;
+    }
+    return i;
+}
+
+double VolSurface::smileVol( const Smile& smile, double strike ) const
+{
+    auto i = lower( smile, strike );
+    if( strike <= smile.strikes[i] || i + 1 == smile.strikes.size() )
+    {
+        return smile.vols[i];
+    }
+    double v0 = smile.vols[i];
+    double v1 = smile.vols[i + 1];
+    if( std::isnan( v0 ) || std::isnan( v1 ) )
+    {
+        return std::isnan( v0 ) ? v1 : v0;
+    }
+    double w = ( strike - smile.strikes[i] ) / ( smile.strikes[i + 1] - smile.strikes[i] );
+    return v0 + w * ( v1 - v0 );
+}
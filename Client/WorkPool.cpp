@@ -0,0 +1,73 @@
+#include "WorkPool.h"
+#include <spdlog/spdlog.h>
+#include <thread>
+
+using namespace std;
+
+WorkPool::WorkPool( unsigned newThreads )
+{
+    threads = newThreads > 0 ? newThreads : max( 1U, thread::hardware_concurrency() );
+    queues = vector<unique_ptr<WorkQueue>>();
+    for( unsigned i = 0; i < threads; i++ )
+    {
+        queues.push_back( make_unique<WorkQueue>() );
+    }
+}
+
+unsigned WorkPool::size() const { return threads; }
+
+void WorkPool::run( size_t tasks, const function<void( size_t, unsigned )>& task )
+{
+    for( size_t i = 0; i < tasks; i++ )
+    {
+        queues[i % threads]->tasks.push_back( i );
+    }
+    auto workers = vector<thread>();
+    for( unsigned worker = 0; worker < threads; worker++ )
+    {
+        workers.emplace_back( [this, worker, &task]() {
+            size_t index = 0;
+            while( next( worker, index ) )
+            {
+                try
+                {
+                    task( index, worker );
+                }
+                catch( const exception& e )
+                {
+                    spdlog::error( "Task " + to_string( index ) + " failed: " + e.what() );
+                }
+            }
+        } );
+    }
+    for( auto& worker : workers )
+    {
+        worker.join();
+    }
+}
+
+bool WorkPool::next( unsigned worker, size_t& index )
+{
+    {
+        auto& own = *queues[worker];
+        lock_guard<mutex> guard( own.lock );
+        if( !own.tasks.empty() )
+        {
+            index = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for( unsigned i = 1; i < threads; i++ )
+    {
+        auto&             victim = *queues[( worker + i ) % threads];
+        lock_guard<mutex> guard( victim.lock );
+        if( !victim.tasks.empty() )
+        {
+            index = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
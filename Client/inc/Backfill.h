@@ -0,0 +1,124 @@
+#pragma once
+#include "Client.h"
+#include "ClientData.h"
+#include "bar.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/// Historical requests allowed per pacing window for bars of 30 seconds or less
+constexpr int PACING_SMALL_BAR_REQUESTS = 60;
+/// Length of the small bar pacing window, in seconds
+constexpr int PACING_SMALL_BAR_WINDOW = 600;
+/// Requests allowed for the same contract within PACING_CONTRACT_WINDOW
+constexpr int PACING_CONTRACT_REQUESTS = 6;
+/// Length of the per-contract pacing window, in seconds
+constexpr int PACING_CONTRACT_WINDOW = 2;
+/// Minimum time between two identical requests, in seconds
+constexpr int PACING_IDENTICAL_WINDOW = 15;
+/// Open historical requests allowed on one backfill connection
+constexpr int BACKFILL_OPEN_PER_CONNECTION = 10;
+/// Time allowed for the last answers of a backfill to arrive, in seconds
+constexpr int BACKFILL_TIMEOUT = 300;
+
+/// @brief Historical data pacing budget shared by every backfill connection
+///
+/// Implements the IB pacing rules: no identical request within 15 seconds, at
+/// most 6 requests for one contract within 2 seconds and at most 60 small bar
+/// requests within 10 minutes. Pacing is enforced by TWS across all client IDs,
+/// so a single budget guards every connection.
+class PacingBudget
+{
+public:
+    PacingBudget() = default;
+    /// Blocks until the request can be sent without violating pacing, then books it
+    void acquire( const HistRequest& );
+
+private:
+    using Clock = std::chrono::steady_clock;
+    /// Returns how long the request has to wait, zero if it can go now
+    Clock::duration wait( const HistRequest&, Clock::time_point ) const;
+
+    std::mutex                                      lock;
+    std::deque<Clock::time_point>                   smallBars;
+    std::map<long, std::deque<Clock::time_point>>   contracts;
+    std::map<std::string, Clock::time_point>        identical;
+};
+
+/// @brief One TWS connection of a backfill
+///
+/// Owns its own socket and EReader thread and collects the bars of its
+/// requests, so connections never share state while the backfill runs.
+class BackfillConnection : public ClientSpace::Client
+{
+public:
+    BackfillConnection();
+    ~BackfillConnection();
+
+    /// Connects and starts the reader thread. Blocks until the API is ready
+    bool open( const char* host, int port, int clientId );
+    void close();
+    /// Sends a request, returns the request Id used
+    long request( HistRequest& );
+    /// Blocks until fewer than the given number of requests are open, or the timeout passes
+    bool waitOpen( size_t, std::chrono::seconds );
+    /// Marks every request still open as failed, returns how many there were
+    size_t abandon();
+
+    /// Requests sent by this connection and the bars they returned
+    std::map<long, HistRequest>      requests;
+    std::map<long, std::vector<Bar>> results;
+    /// Requests that ended with an error
+    std::set<long> failed;
+
+private:
+    void historicalData( TickerId, const Bar& );
+    void historicalDataEnd( int, const std::string&, const std::string& );
+    void error( int, int, const std::string& );
+    void nextValidId( OrderId );
+    void connectAck();
+    void connectionClosed();
+    void readLoop();
+    void finish( long );
+
+    long                    nextReqId;
+    std::set<long>          pending;
+    std::atomic<bool>       running;
+    std::atomic<bool>       ready;
+    std::thread             reader;
+    std::mutex              lock;
+    std::condition_variable changed;
+};
+
+/// @brief Splits a historical request plan across several TWS connections
+///
+/// Each connection uses its own client ID and pulls the next request from a
+/// shared queue once it has room, so faster connections take more of the plan.
+/// All connections draw from the same PacingBudget, so harvest time scales
+/// with the number of connections until pacing becomes the bottleneck.
+class BackfillCoordinator
+{
+public:
+    BackfillCoordinator( std::string host, int port, int firstClientId, int connections );
+    /// Runs the plan to completion (or timeout). Returns the number of requests answered
+    size_t run( const std::vector<HistRequest>& );
+    /// Moves every answered request into the data store
+    void merge( ClientData& );
+
+private:
+    void dispatch( BackfillConnection& );
+    /// Fails the requests a connection gave up waiting for
+    void abandon( BackfillConnection& );
+    bool next( HistRequest& );
+
+    std::string                                      host;
+    int                                              port;
+    int                                              firstClientId;
+    std::vector<std::unique_ptr<BackfillConnection>> connections;
+    PacingBudget                                     pacing;
+    std::mutex                                       queueLock;
+    std::deque<HistRequest>                          queue;
+};
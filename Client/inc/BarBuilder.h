@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Bar lengths, in seconds, built for every live stock line by default
+constexpr int DEFAULT_BAR_SECONDS[] = { 1, 5, 60, 300 };
+
+/// Price that moves a streaming bar
+enum class BarSource
+{
+    Trades,  // last trade price, like TRADES bars
+    Midpoint // midpoint of the last bid and ask, like MIDPOINT bars
+};
+
+/// A bar of a BarBuilder, open or just closed
+struct StreamBar
+{
+    /// Start of the bar in epoch nanoseconds
+    int64_t start;
+    double  open;
+    double  high;
+    double  low;
+    double  close;
+    int64_t volume;
+    /// False until the first price of the bar arrives
+    bool active;
+};
+
+/// A bar that ended, with the index of its length in the builder
+struct ClosedBar
+{
+    size_t    length;
+    StreamBar bar;
+};
+
+/// @brief Aggregates the ticks of one market data line into bars of several lengths
+///
+/// Takes the bid (1), ask (2), last (4) and last size (5) tick types as they
+/// arrive and keeps one open bar per length up to date. A bar closes when the
+/// first tick of a later bar arrives or when advance() passes its end, so the
+/// closed bars are the ones reqRealTimeBars would have delivered, without the
+/// line. Bars without any price are skipped, as IB does.
+class BarBuilder
+{
+public:
+    BarBuilder( const std::vector<int>&, BarSource );
+
+    /// Adds a tick at the given epoch nanoseconds, appending the bars it closed
+    void tick( int64_t, int, double, std::vector<ClosedBar>& );
+    /// Closes the bars that ended by the given epoch nanoseconds
+    void advance( int64_t, std::vector<ClosedBar>& );
+    /// Open bar of a length
+    const StreamBar& current( size_t ) const;
+    /// Bar lengths in seconds
+    const std::vector<int>& lengths() const;
+
+    /// Interval name of a bar length, in the form historical vectors use ("5secs", "1min")
+    static std::string interval( int );
+
+private:
+    /// Closes the open bars that end before the given time
+    void roll( int64_t, std::vector<ClosedBar>& );
+    void price( int64_t, double );
+
+    std::vector<int>       seconds;
+    std::vector<int64_t>   spans;
+    std::vector<StreamBar> bars;
+    BarSource              source;
+    double                 bid;
+    double                 ask;
+};
@@ -15,6 +15,7 @@
 #include <vector>
 
 class EClientSocket;
+class OutboundScheduler;
 
 namespace ClientSpace
 {
@@ -153,9 +154,6 @@ namespace ClientSpace
         INT
     };
 
-    /// map storing the string version of each state
-    extern std::map<int, std::string> StateMap;
-
     /// @brief Client class from IB
     ///
     /// This class must exist because EWrapper_prototypes.h mandates that all of its
@@ -234,6 +232,8 @@ namespace ClientSpace
         EReaderOSSignal                m_osSignal;
         std::shared_ptr<EClientSocket> p_Client;
         std::shared_ptr<State>         p_State;
+        /// Rate limits the requests sent through p_Client
+        std::shared_ptr<OutboundScheduler> p_Outbound;
         /// sleep delay time in milliseconds
         time_t m_sleepDeadline;
 
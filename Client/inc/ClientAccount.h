@@ -1,6 +1,7 @@
 #pragma once
 #include "Account.h"
 #include "Client.h"
+#include "PnLEngine.h"
 
 class Position;
 
@@ -18,10 +19,17 @@ public:
     std::vector<Position*> getPositions() const;
     void                   addClient( std::shared_ptr<EClientSocket> newClient );
     void                   addState( std::shared_ptr<ClientSpace::State> newState );
+    void                   addOutbound( std::shared_ptr<OutboundScheduler> );
     /// Initializes account by subscribing to updates
     void init();
     /// Cancels account update subscriptions
     void closeSubscriptions();
+    /// Profit, loss and exposure of the account, updated on every tick and fill
+    PnLEngine& pnl();
+    /// Subscribes to the pnlSingle updates of a contract under a request id, once per slot
+    void trackPnL( int, const Contract&, long );
+    /// Copies the PnL of the engine into the account fields the strategy reads
+    void sync();
     /// ID for requesting account updates
     unsigned long accReqId;
     /// Unique account identifier, used to request updates
@@ -33,4 +41,5 @@ public:
 private:
     /// Shows that the account is ready for trading
     bool valid;
+    PnLEngine pnlEngine;
 };
\ No newline at end of file
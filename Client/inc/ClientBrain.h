@@ -1,10 +1,16 @@
 #pragma once
 #include "Brain.h"
 #include "Client.h"
+#include "EvalScheduler.h"
+#include "StateTable.h"
 
 class ClientAccount;
 class ClientData;
 class ClientBroker;
+class Journal;
+class MetricCounter;
+class MetricGauge;
+class MetricHistogram;
 
 /// Global flag indicating a keyboard interrupt
 extern bool inter;
@@ -30,6 +36,8 @@ constexpr int MAXIMUM_DATALINES_BUFFER_SIZE = 100;
 /// trading bot. Callback functions must be defined in here.
 class ClientBrain : public ClientSpace::Client
 {
+    friend class ReplayDriver;
+
 public:
     ClientBrain();
     ClientBrain( std::shared_ptr<BTStrategy> );
@@ -42,17 +50,60 @@ public:
 
     void setConnectOptions( const std::string& );
     void processMessages();
+    /// Runs the state machine once without waiting on the socket. Like
+    /// processMessages it is defined by the binary that uses it
+    void processState();
+    /// Starts recording the market data and order callbacks, beginning with the open data lines
+    void record( std::shared_ptr<Journal> );
+    /// Sets when the strategy is evaluated, on every tick by default
+    void evaluate( const EvalScheduler& );
     bool connect( const char* host, int port, int clientId = 0 );
     void disconnect() const;
     bool isConnected() const;
     /// Initializes all members: Account (and more to come)
     void init();
+    /// Entries into and time spent in each state of the main loop
+    const ClientSpace::StateTimer& stateTimes() const;
 
 private:
     std::shared_ptr<ClientAccount> Account;
     std::shared_ptr<ClientData>    Data;
     std::shared_ptr<ClientBroker>  Broker;
     std::shared_ptr<BTStrategy>    Strategy;
+    /// Receives the callbacks while recording
+    std::shared_ptr<Journal> journal;
+    /// Decides when DATA_NEXT moves on to TRADING
+    EvalScheduler scheduler;
+    /// Fed the state at the top of every pass of the state machine
+    ClientSpace::StateTimer stateTimer;
+    /// Registers the metrics of the main loop, called by every constructor
+    void initMetrics();
+    /// Top of a pass of the state machine: times the state and updates the loop metrics
+    void beginPass();
+    /// Sleeps for a number of milliseconds, waking to pump the outbound scheduler whenever a token frees up
+    void idle( int );
+    /// Counter of a state, registered the first time the state shows up
+    MetricCounter& stateCounter( std::array<MetricCounter*, ClientSpace::STATE_COUNT>&, const std::string&,
+                                 const std::string&, ClientSpace::State, double );
+    MetricCounter*                                         reconnects;
+    MetricGauge*                                           histRequests;
+    MetricGauge*                                           dataLines;
+    MetricGauge*                                           pendingOrders;
+    MetricGauge*                                           openOrders;
+    MetricGauge*                                           realizedPnL;
+    MetricGauge*                                           unrealizedPnL;
+    MetricGauge*                                           grossExposure;
+    MetricGauge*                                           netExposure;
+    MetricHistogram*                                       loopTime;
+    std::array<MetricCounter*, ClientSpace::STATE_COUNT> stateEntries;
+    std::array<MetricCounter*, ClientSpace::STATE_COUNT> stateTime;
+    /// Steady clock nanoseconds of the last pass, 0 before the first
+    int64_t lastPass;
+    /// Calls to connect so far
+    unsigned connects;
+    /// ClientClock time the connection was last lost, or the brain was made before that.
+    /// Executions from then on are asked for again on reconnecting
+    int64_t dropped;
     void                           connectionClosed();
     void                           connectAck();
     void                           reqHeadTimestamp();
@@ -135,6 +186,24 @@ private:
                                 bool );
     void historicalTicksLast( int, const std::vector<HistoricalTickLast>&, bool );
     void historicalDataUpdate( TickerId, const Bar& );
+    /// Callback from reqRealTimeBars, time is the bar start in epoch seconds
+    void realtimeBar( TickerId, long, double, double, double, double, long, double, int );
+    /// Callbacks from reqTickByTickData, stored and fed to the bars of the stream
+    void tickByTickAllLast( int, int, time_t, double, int, const TickAttribLast&,
+                            const std::string&, const std::string& );
+    void tickByTickBidAsk( int, time_t, double, double, int, int, const TickAttribBidAsk& );
+    /// Callbacks from reqMktDepth, applied to the book of the request
+    void updateMktDepth( TickerId, int, int, int, double, int );
+    void updateMktDepthL2( TickerId, int, const std::string&, int, int, double, int, bool );
+    /// Callbacks from reqContractDetails, used to resolve the contract universe
+    void contractDetails( int, const ContractDetails& );
+    void contractDetailsEnd( int );
+    /// Callbacks from reqSecDefOptParams, used to generate option chains
+    void securityDefinitionOptionalParameter( int, const std::string&, int,
+                                              const std::string&, const std::string&,
+                                              const std::set<std::string>&,
+                                              const std::set<double>& );
+    void securityDefinitionOptionalParameterEnd( int );
 
     /* Callbacks for ClientBroker */
     /// Gives up-to-date information about each order every time its state
@@ -152,6 +221,12 @@ private:
     void completedOrder( const Contract&, const Order&, const OrderState& );
     /// Notifies end of completed order updates
     void completedOrdersEnd();
+    /// Books each execution as it is reported, whether streamed after a fill or
+    /// sent again by reqExecutions. Duplicates are dropped by execId
     void execDetails( int, const Contract&, const Execution& );
     void execDetailsEnd( int );
+    /// Follows the execDetails of each execution with its commission
+    void commissionReport( const CommissionReport& );
+    /// Update of the pnlSingle subscription of a position, reconciles the PnL engine
+    void pnlSingle( int, int, double, double, double, double );
 };
\ No newline at end of file
@@ -4,13 +4,49 @@
 #include "Client.h"
 #include "Order.h"
 #include "Position.h"
+#include "RiskEngine.h"
 #include <map>
+#include <unordered_map>
 
+class MetricCounter;
+struct CommissionReport;
+struct Execution;
 struct ExecutionFilter;
 
+/// @brief One execution of an order, taken from execDetails and completed by commissionReport
+struct Fill
+{
+    OrderId     orderId;
+    long        conId;
+    std::string symbol;
+    std::string secType;
+    /// Signed shares, negative for a sale
+    double shares;
+    double price;
+    /// 0 until the commission report of the execution arrives
+    double commission;
+    double realizedPNL;
+    /// ClientClock time the execution reached the client, epoch nanoseconds
+    int64_t received;
+    /// Whether the commission report of the execution arrived
+    bool reported;
+};
+
+/// @brief Receives the requests of a ClientBroker that trades without TWS
+///
+/// Used by ReplayDriver to fill orders against a recorded session.
+class OrderSink
+{
+public:
+    virtual ~OrderSink() = default;
+    virtual void placeOrder( OrderId, const Contract&, const Order& ) = 0;
+    virtual void reqExecutions( int, const ExecutionFilter& ) = 0;
+};
+
 class ClientBroker : public ClientSpace::Client, public BTBroker
 {
     friend class ClientBrain;
+    friend class ReplayDriver;
 
 public:
     ClientBroker( const std::shared_ptr<EClientSocket>&,
@@ -18,14 +54,35 @@ public:
                   const std::shared_ptr<OrderId>& );
     ~ClientBroker() = default;
 
-    void placeOrder( std::pair<Contract, Order>& );
-    void filledOrder( long, const ExecutionFilter& );
+    /// Sends an order that passes the pre-trade checks, false when it is rejected
+    bool placeOrder( std::pair<Contract, Order>& );
+    /// Cancels an order. The cancel waits for the next pump of the outbound scheduler, so an
+    /// order for the same symbol placed before then modifies this one instead
+    void cancelOrder( OrderId );
+    /// Asks TWS for the executions a filter matches, to catch the fills missed while disconnected
+    void requestExecutions( long, const ExecutionFilter& );
+    /// Books an execution, nullptr when its execId was booked before
+    const Fill* fill( const Contract&, const Execution& );
+    /// Adds the commission report of a booked execution, nullptr when the execId is
+    /// unknown or its report was added already
+    const Fill* commission( const CommissionReport& );
+    /// Every execution booked so far, by execId
+    const std::unordered_map<std::string, Fill>& fills() const;
+    /// Sends orders and execution requests to a sink instead of TWS, nullptr restores TWS
+    void simulate( OrderSink* );
+    /// Pre-trade checks every order goes through
+    RiskEngine& risk();
+    void        addOutbound( std::shared_ptr<OutboundScheduler> );
 
 private:
-    /// When servicing execDetails callbacks, this will map the id back to a
-    /// corresponding contract
-    std::map<long, std::pair<Contract, Order>> executionMap;
+    /// Executions booked so far, by execId
+    std::unordered_map<std::string, Fill> executions;
+    MetricCounter*                        booked;
+    MetricCounter*                        duplicates;
     /// Contains all orders that have been submitted to IB but have not been
     /// accepted
     std::set<std::pair<Contract, Order>, OrderCompare> pendingOrders;
+    /// Receives the requests while simulating
+    OrderSink* sink;
+    RiskEngine riskEngine;
 };
\ No newline at end of file
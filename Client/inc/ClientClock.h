@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+/// @brief Wall clock of the client that a replay can take over
+///
+/// Everything that stamps or schedules by time reads ClientClock::now() instead
+/// of the system clock, so a replay can run faster than real time and still see
+/// the times of the recorded session. Simulated time belongs to the thread that
+/// set it.
+class ClientClock
+{
+public:
+    /// Current time in epoch nanoseconds, simulated while a replay is running
+    static int64_t now();
+    /// Switches to simulated time and moves it to the given epoch nanoseconds
+    static void simulate( int64_t );
+    /// Switches back to the system clock
+    static void release();
+    static bool simulated();
+};
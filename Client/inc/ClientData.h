@@ -1,26 +1,53 @@
 #pragma once
+#include "BarBuilder.h"
 #include "Client.h"
+#include "ContractUniverse.h"
 #include "Data.h"
 #include "DataStruct.h"
 #include "DataTypes.h"
+#include "HarvestPlanner.h"
+#include "HistoryStore.h"
+#include "OptionPricer.h"
+#include "OrderBook.h"
+#include "TickBackfill.h"
+#include "TickStream.h"
+#include <deque>
 
 class DataArray;
+class MetricCounter;
+struct Bar;
 
 struct SnapHold
 {
     SnapStruct bidAsk;
     SnapStruct lastTrade;
+    /// Ticks received on the line
+    MetricCounter* ticks;
+    /// Contract of the line
+    Contract contract;
+    /// RiskEngine slot of the contract, -1 until the first tick
+    int riskSlot;
+    /// PnLEngine slot of the contract, -1 until the first tick
+    int pnlSlot;
 };
 
 struct OptionHold
 {
     OptionStruct bidAsk;
     OptionStruct lastTrade;
+    MetricCounter* ticks;
+    /// Contract of the line
+    Contract contract;
+    /// RiskEngine slot of the contract, -1 until the first tick
+    int riskSlot;
+    /// PnLEngine slot of the contract, -1 until the first tick
+    int pnlSlot;
 };
 
 class ClientData : public ClientSpace::Client, public BTData
 {
     friend class ClientBrain;
+    friend class ReplayDriver;
 
 public:
     ClientData( std::vector<BTIndicator*>& );
@@ -29,8 +56,52 @@ public:
     ClientData();
     void addClient( std::shared_ptr<EClientSocket> );
     void addState( std::shared_ptr<ClientSpace::State> );
+    void addOutbound( std::shared_ptr<OutboundScheduler> );
     void init();
+    /// Sets the universe config and contract cache files used by init()
+    void setUniverse( const std::string&, const std::string& );
     void harvest( int );
+    /// Historical requests made by one harvest index
+    std::vector<HistRequest> harvestPlan( int ) const;
+    /// Historical requests made by all harvest indices
+    std::vector<HistRequest> harvestPlan() const;
+    /// Adds the bars of a request answered outside of this client (see BackfillCoordinator)
+    void addHistory( HistRequest&, const std::vector<Bar>& );
+    /// Records the range of a finished historical request in the harvest catalog
+    void histRequestDone( long );
+    /// Writes the harvest catalog, call once the harvested data has been saved
+    void saveHarvest();
+    /// Writes every harvested bar to the columnar history store
+    void writeStore( const std::string& );
+    /// Creates a historical vector per stock from the history store
+    void loadHistory( const std::string&, const std::string& );
+    /// Opens the live stock lines that end a harvest
+    void startHarvestLive();
+    /// Creates the vector and snapshot holder of a market data line without requesting it
+    std::shared_ptr<DataArray> openLine( const Contract&, long );
+    /// Creates the vector of a historical request, its bars are kept for the history store
+    std::shared_ptr<DataArray> newHistVector( Contract&, long, const std::string& );
+    /// Bar lengths, in seconds, and price source of the streaming bars built for
+    /// the stock lines opened from now on. No lengths turns them off
+    void streamBars( const std::vector<int>&, BarSource );
+    /// Adds a bar length, in seconds, to the streaming bars when it is not built yet
+    void streamBar( int );
+    /// Closes the streaming bars that have ended and reports whether a bar of the
+    /// given length in seconds, or of any length for 0, closed since the last check.
+    /// Lets a strategy trade on bar close instead of every tick
+    bool barsClosed( int = 0 );
+    /// Vectors holding the closed streaming bars of a line, one per bar length
+    std::vector<std::shared_ptr<DataArray>> barVectors( long ) const;
+    /// Subscribes to the 5 second real-time bars of a contract under the given id.
+    /// The bars continue the 5secs historical vector of the contract, once the bars
+    /// missing between its last bar and now have been requested, or start a vector
+    /// of their own when there is none
+    void openRealTimeBars( const Contract&, long, const std::string& = "TRADES" );
+    /// Cancels every real-time bar subscription
+    void closeRealTimeBars();
+    /// Vector the bars of a real-time bar subscription are added to
+    std::shared_ptr<DataArray> realTimeVector( long ) const;
+    void                       updateRealTimeBar( TickerId, const Bar& );
     void startTimer();
     bool checkTimer();
     void updateCandle( TickerId, const Bar& );
@@ -40,18 +111,157 @@ public:
     void updateSize( TickerId, OptionStruct&, int, int );
     void updateOptionGreeks( TickerId, OptionStruct&, double, double, double,
                              double, double, double, double, int );
+    /// Prices option lines locally from the underlying line, at the given risk
+    /// free rate, instead of taking the tickOptionComputation greeks from TWS
+    void priceOptions( bool, double = RISK_FREE_RATE );
+    /// Subscribes to the market depth of a contract, kept in a book under the given id
+    void openBook( const Contract&, long, int = BOOK_DEPTH, bool = true );
+    /// Creates the book of an id without subscribing, used when depth arrives from elsewhere
+    OrderBook& addBook( long );
+    /// Book of a depth subscription, nullptr when there is none
+    const OrderBook* book( long ) const;
+    void             updateBook( TickerId, int, int, int, double, int );
+    /// Empties a book TWS reset with error 317, its rows are sent again. False for other ids
+    bool resetBook( long );
+    /// Number of stocks, the first listed in the universe, whose market depth is
+    /// subscribed when the live data starts
+    void streamDepth( int );
+    /// Tick-by-tick slots TWS allows and the history store root the tick
+    /// records are written to
+    void streamTicks( int, const std::string& = HISTORY_ROOT );
+    /// Wants the tick-by-tick trades or quotes of a contract under the given id,
+    /// with the given priority, feeding the streaming bars of the given line.
+    /// The stream is requested once it wins a slot from lower priority streams
+    void openTicks( const Contract&, long, TickKind, int, long = 0 );
+    /// Cancels a tick stream and hands its slot to the next waiting one
+    void closeTicks( long );
+    /// Takes back the slot of a tick stream TWS refused for having too many open
+    void ticksRefused( long );
+    /// Tick stream of an id, nullptr when there is none
+    const TickStream* tickStream( long ) const;
+    void              updateTrade( int, time_t, double, int, const TickAttribLast& );
+    void              updateQuote( int, time_t, double, double, int, int );
+    /// Writes the buffered tick records to the history store and merges every
+    /// tick series with the parts written along the day
+    void writeTicks();
+    /// Queues a backfill of the historical TRADES, BID_ASK or MIDPOINT ticks of
+    /// every stock over the given number of seconds up to now
+    void harvestTicks( int64_t, const std::string& );
+    /// Sends the next tick backfill page when pacing allows. False once the
+    /// backfill is finished
+    bool pageTicks();
+    /// Callbacks of the tick backfill pages
+    void updateHistTicks( int, const std::vector<HistoricalTick>&, bool );
+    void updateHistTicks( int, const std::vector<HistoricalTickBidAsk>&, bool );
+    void updateHistTicks( int, const std::vector<HistoricalTickLast>&, bool );
+    /// A tick backfill page TWS answered with an error. False for other requests
+    bool tickPageFailed( long );
+    /// A real-time gap request TWS answered with an error, the held bars are added
+    /// without the gap. False for other requests
+    bool gapFailed( long );
+    /// Writes every backfilled tick received so far, finished or not
+    void writeTickBackfill();
+    /// Locally priced chain of an underlying symbol, nullptr when there is none.
+    /// Its surface() answers volatility queries for any strike and expiry
+    const OptionChain* chain( const std::string& ) const;
     bool updated();
     bool updated() const;
+    /// True when a line has been updated since the last updated() call, without consuming it
+    bool pending() const;
+    /// Callbacks for the reqContractDetails lookups made while resolving the universe
+    void contractResolved( int, const ContractDetails& );
+    void contractResolvedEnd( int );
+    /// Callbacks for the reqSecDefOptParams lookups made while resolving option chains
+    void chainResolved( int, const std::string&, const std::string&,
+                        const std::set<std::string>&, const std::set<double>& );
+    void chainResolvedEnd( int );
+    /// Callbacks for the snapshot of the underlying of an option entry. False when
+    /// the id is not such a snapshot
+    bool underlyingTick( long, int, double );
+    void underlyingSnapshotEnd( long );
+    /// A universe lookup TWS answered with an error, the entry falls back to the
+    /// contract cache. False for other requests
+    bool lookupFailed( long );
+    /// Gives up on the universe lookups still in flight after RESOLVE_TIMEOUT
+    void checkLookups();
 
 private:
+    /// Stage of an outstanding universe lookup
+    enum ResolveStage
+    {
+        RESOLVE_STOCK,      // contract details of a stock entry
+        RESOLVE_UNDERLYING, // contract details of the underlying of an option entry
+        RESOLVE_PRICE,      // snapshot of the underlying the strike window is centered on
+        RESOLVE_CHAIN,      // option chain parameters of an option entry
+        RESOLVE_OPTIONS     // contract details of one expiry and right of an option chain
+    };
+    /// An outstanding universe lookup
+    struct Resolution
+    {
+        size_t                entry;
+        ResolveStage          stage;
+        std::vector<Contract> found;
+        /// Strikes wanted from an RESOLVE_OPTIONS lookup
+        std::set<double> strikes;
+        /// Chain parameters gathered by an RESOLVE_CHAIN lookup
+        std::set<std::string> expirations;
+        std::set<double>      chainStrikes;
+        std::string           multiplier;
+        /// Last and closing price of the underlying from an RESOLVE_PRICE lookup, 0 until known
+        double last;
+        double close;
+    };
+    /// Looks up the option chain of a resolved underlying, centered on a price
+    void resolveChain( size_t, const Contract&, double );
+
+    /// A real-time bar subscription
+    struct RealTimeLine
+    {
+        /// Vector the bars are added to
+        long vector;
+        /// Start of the last bar of the vector, epoch nanoseconds
+        int64_t last;
+        /// Request for the bars between the history and now, 0 when there is none
+        long gapRequest;
+        /// Bars that arrived while the gap was being filled
+        std::vector<Bar> held;
+    };
+
     void initContractVectors();
+    void resolveEntry( size_t );
+    void resolveOptions( size_t, const Resolution& );
+    void entryResolved( size_t );
+    void addContracts( const std::vector<Contract>& );
+    void finishInit();
     void startLiveData();
-    void newHistRequest( Contract&, long, const std::string&,
-                         const std::string&, const std::string& );
-    void newLiveRequest( Contract&, long );
+    void newHistRequest( HistRequest&, long );
+    void                       newLiveRequest( Contract&, long );
     void addPoint( long, SnapStruct );
     void addPoint( long, OptionStruct );
     void updateTimeLine( const std::shared_ptr<DataArray>& vec );
+    /// Adds a bar to the vector of a real-time line when it is newer than the last one
+    void appendRealTimeBar( RealTimeLine&, const Bar& );
+    /// Ends the gap request of a real-time line and adds the bars held back meanwhile.
+    /// False for other requests
+    bool gapFilled( long );
+    /// Feeds a stock line tick to the bar builder of its line, unless a tick
+    /// stream feeds the line with the same data
+    void streamTick( long, int, double );
+    void barTick( long, int, double );
+    /// Requests and cancels tick streams until the highest priorities hold the slots
+    void allocateTicks();
+    /// Appends the buffered records of one tick stream to the history store as a
+    /// part of its series, merging the parts into the series when asked
+    void writeTicks( TickStream&, bool = false );
+    /// Ends a page of historical ticks and stores the series it completed
+    void histTicksDone( int );
+    /// Feeds a quote or trade of a stock or option line to its option chain,
+    /// repricing the chain when the underlying moved
+    void chainTick( long, int, double );
+    /// Copies the solved greeks of a chain slot into the snapshots of its line
+    void storeGreeks( const OptionChain&, size_t );
+    /// Adds the closed bars of a line to its bar vectors
+    void closeBars( long, const std::vector<ClosedBar>& );
 
     /// Keeps the starting point of the timer
     std::chrono::_V2::system_clock::time_point start;
@@ -62,6 +272,14 @@ private:
     /// Contains all historical data requests that have not been answered yet
     /// Up to 50 open Hist requests are allowed at once
     std::set<long> openHistRequests;
+    /// Historical requests that have been sent, keyed by vectorId
+    std::map<long, HistRequest> histRequests;
+    /// Ranges that have already been harvested
+    HarvestCatalog catalog;
+    /// Series (conId, interval) of each historical vector
+    std::map<long, std::pair<long, std::string>> storeSeries;
+    /// Harvested bars waiting to be written to the history store, keyed by vectorId
+    std::map<long, std::vector<BarRow>> barRows;
     /// Contains all market data lines that are currently active
     /// Up to 100 (including those on the TWS watchlist) can be open at once.
     std::set<long> openDataLines;
@@ -76,9 +294,65 @@ private:
     std::vector<Contract> stockContracts;
     std::vector<Contract> optionContracts;
 
+    /// Universe of contracts to trade, loaded from the config file
+    ContractUniverse universe;
+    std::string      universeConfig;
+    std::string      universeCache;
+    /// Universe lookups waiting on TWS, keyed by request Id
+    std::map<long, Resolution> resolutions;
+    /// Contracts resolved so far for each universe entry with lookups in flight
+    std::map<size_t, std::vector<Contract>> resolved;
+    /// Number of lookups in flight for each universe entry
+    std::map<size_t, int> pendingLookups;
+    /// Universe entries with a lookup that failed, they are not written to the cache
+    std::set<size_t> failedEntries;
+    /// ClientClock time the universe lookups are given up at, epoch nanoseconds
+    int64_t lookupDeadline;
+
     /// Set of data lines that have been updated since last check
     std::set<long> updatedLines;
 
+    /// Start of the last candle of every candle vector, epoch nanoseconds
+    std::map<long, int64_t> lastBars;
+    /// Real-time bar subscriptions by request id, and the subscription of each gap request
+    std::map<long, RealTimeLine> realTimeLines;
+    std::map<long, long>         gapRequests;
+
+    /// Streaming bar settings for new lines
+    std::vector<int> barSeconds;
+    BarSource        barSource;
+    /// Bar builder of each live stock line
+    std::map<long, BarBuilder> barBuilders;
+    /// Bar vector ids of each live stock line, in the order of the bar lengths
+    std::map<long, std::vector<long>> barLines;
+    /// Next id of a bar vector, kept apart from the request ids
+    long nextBarVector;
+    /// Bar lengths, in seconds, that closed a bar since the last check
+    std::set<int> closedBars;
+    /// Scratch list of the bars closed by one tick
+    std::vector<ClosedBar> closing;
+
+    /// Tick-by-tick subscriptions, keyed by their request id
+    TickStreams tickStreams;
+    /// History store root of the tick records
+    std::string tickRoot;
+
+    /// Historical tick pages and the times the last ones were sent, for pacing
+    TickBackfill                                    tickBackfill;
+    std::deque<std::chrono::steady_clock::time_point> tickPagesSent;
+
+    /// Order books of the depth subscriptions, keyed by their request id
+    std::map<long, OrderBook> books;
+    int                       depthBooks;
+
+    /// Option chains by underlying symbol
+    std::map<std::string, OptionChain> chains;
+    /// Underlying symbol of every stock and option line with a chain
+    std::map<long, std::string> chainLines;
+    /// Greeks are computed locally rather than taken from TWS
+    bool   localGreeks;
+    double riskFreeRate;
+
     /// Flag showing that this object is ready for trading
     bool valid;
 };
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#include "Contract.h"
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/// Default lifetime of a contract cache entry, in seconds
+constexpr int64_t CONTRACT_CACHE_TTL = 24 * 60 * 60;
+/// Longest time the universe lookups may take before the client starts with the
+/// contracts it has, in seconds
+constexpr int64_t RESOLVE_TIMEOUT = 120;
+
+/// @brief One line of the universe config file
+///
+/// Stock lines read "STK symbol exchange primaryExchange currency [rtbars]",
+/// where rtbars subscribes the stock to 5 second real-time bars as well.
+/// Option lines read "OPT symbol exchange currency expiries strikes [center]",
+/// which generates the chain from the nearest expiries and the strikes closest
+/// to center (or the price of the underlying when no center is given).
+struct UniverseEntry
+{
+    std::string secType;
+    std::string symbol;
+    std::string exchange;
+    std::string primaryExchange;
+    std::string currency;
+    /// Number of upcoming expiries to take from the option chain
+    int expiries = 0;
+    /// Number of strikes closest to the center to take for each expiry
+    int strikes = 0;
+    /// Strike the option window is centered on, 0 means the price of the underlying
+    double center = 0;
+    /// Whether the live stock line also subscribes to real-time bars
+    bool realTime = false;
+    /// Key of this entry in the contract cache
+    std::string key() const;
+};
+
+/// @brief Contract universe loaded from a config file
+///
+/// Resolved contracts are kept in a compact binary cache on disk, keyed by
+/// symbol, so a cold start only goes to TWS for entries that are missing or
+/// older than the cache lifetime.
+class ContractUniverse
+{
+public:
+    ContractUniverse();
+    /// Parses the universe config. Returns false if the file can't be read
+    bool loadConfig( const std::string& );
+    /// Reads the binary contract cache. A missing or corrupt cache is treated as empty
+    bool loadCache( const std::string& );
+    /// Writes every cache entry back to disk
+    bool saveCache( const std::string& ) const;
+    /// Fills the contracts of an entry from the cache if it is present and fresh
+    bool cached( const UniverseEntry&, std::vector<Contract>& ) const;
+    /// Fills the contracts of an entry from the cache whatever their age, without
+    /// the expired options. Used when TWS can't resolve the entry
+    bool stale( const UniverseEntry&, std::vector<Contract>& ) const;
+    /// Stores freshly resolved contracts for an entry
+    void store( const UniverseEntry&, const std::vector<Contract>& );
+    /// Every contract in the cache, fresh or not
+    std::vector<Contract> contracts() const;
+    /// Contract used to look up the stock (or the underlying of an option entry)
+    static Contract underlying( const UniverseEntry& );
+    /// Picks the nearest expiries of a chain that haven't passed yet
+    static std::vector<std::string> selectExpiries( const UniverseEntry&,
+                                                    const std::set<std::string>& );
+    /// Picks the strikes of a chain closest to the entry center, or to the price of
+    /// the underlying without one, or to the middle strike without either
+    static std::set<double> selectStrikes( const UniverseEntry&, const std::set<double>&, double = 0 );
+
+    std::vector<UniverseEntry> entries;
+    /// Maximum age of a cache entry, in seconds
+    int64_t ttl;
+
+private:
+    struct CacheEntry
+    {
+        int64_t               written;
+        std::vector<Contract> contracts;
+    };
+    std::map<std::string, CacheEntry> cache;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class ClientData;
+
+/// When the strategy is run
+enum class EvalMode
+{
+    EveryTick, // after every new point, the original behaviour
+    BarClose,  // when a streaming bar of the chosen length closes
+    Timer,     // every period, whether or not anything changed
+    Coalesced  // at most once per period, only when something changed since the last run
+};
+
+/// @brief Decides when the DATA_NEXT state hands over to TRADING
+///
+/// Every mode except Timer waits for new data. Updates that arrive between two
+/// evaluations are folded into the next one, because the strategy reads the
+/// whole data set anyway, so strategy CPU follows the decision rate rather
+/// than the tick rate. Times come from ClientClock, so replays keep the
+/// schedule of the recorded session.
+class EvalScheduler
+{
+public:
+    EvalScheduler();
+    /// Bar length in seconds for BarClose, period in milliseconds for Timer and Coalesced
+    EvalScheduler( EvalMode, int );
+
+    /// True when the strategy should run now. Consumes the pending updates when it is
+    bool due( ClientData& );
+    EvalMode mode() const;
+    /// Bar length in seconds for BarClose, period in milliseconds for Timer and Coalesced
+    int interval() const;
+    /// Evaluations granted so far
+    size_t evaluations() const;
+
+    /// Reads "tick", "bar:<seconds>", "timer:<ms>" or "coalesce:<ms>". False when malformed
+    static bool parse( const std::string&, EvalScheduler& );
+
+private:
+    EvalMode evalMode;
+    int      period;
+    /// Epoch nanoseconds of the last evaluation and of the next timer evaluation
+    int64_t last;
+    int64_t next;
+    size_t  count;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Records kept per thread, a power of two
+constexpr size_t FLIGHT_RECORDS = 4096;
+/// Threads that can record, later threads record nothing
+constexpr size_t FLIGHT_THREADS = 32;
+/// File the Trader dumps its flight records to
+constexpr const char* FLIGHT_PATH = "flight.rec";
+
+/// Kind of event a flight record holds
+enum class FlightEvent : uint16_t
+{
+    State = 0,    // id is the state left, field the state entered
+    TickPrice,    // id is the tickerId, field the tick type, value the price
+    TickSize,     // id is the tickerId, field the tick type, value the size
+    OrderStatus,  // id is the orderId, field the status as FlightRecorder::orderStatus numbers it, value the filled size
+    Execution,    // id is the orderId, field the reqId, -1 when streamed, value the shares
+    OrderPlaced,  // id is the orderId, field 1 to buy and -1 to sell, value the quantity
+    Error,        // id is the request id, field the error code
+    Disconnect,   // the connection to TWS closed
+    OrderRejected,    // id is the orderId it would have had, field the RiskVerdict, value the quantity
+    OptionComputation // id is the tickerId, field the tick type, value the implied volatility
+};
+
+/// @brief One recorded event, 32 bytes
+struct FlightRecord
+{
+    /// ClientClock time, epoch nanoseconds
+    int64_t  time;
+    double   value;
+    int32_t  id;
+    int32_t  field;
+    uint16_t event;
+    /// Index of the recording thread
+    uint16_t thread;
+    uint32_t spare;
+};
+
+/// @brief Always-on record of the last events of every thread, dumped when the process dies
+///
+/// Each thread writes into a ring of FLIGHT_RECORDS fixed-size records of its own,
+/// so recording takes no lock and does no I/O: the record is filled in and the
+/// write count is bumped with one relaxed store. Nothing is written to disk
+/// until dump(), which only uses open, write and close so it can run inside a
+/// signal handler. install() makes a crash, abort or exit dump every ring to a
+/// file that load() reads back in time order.
+class FlightRecorder
+{
+public:
+    static void record( FlightEvent, int32_t, int32_t = 0, double = 0 );
+    /// Dumps to a path on SIGSEGV, SIGABRT and exit
+    static void install( const std::string& );
+    /// Writes every ring to the installed path. Async signal safe, does nothing before install
+    static void dump();
+    /// Reads the records of a dump, oldest first
+    static bool load( const std::string&, std::vector<FlightRecord>& );
+    /// One line describing a record
+    static std::string describe( const FlightRecord& );
+    /// Number of an orderStatus status for OrderStatus records, -1 when unknown
+    static int32_t orderStatus( const std::string& );
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include "Contract.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/// Number of request batches in a full historical harvest
+constexpr int HARVEST_INDICES = 4;
+
+/// @brief A single historical data request of a harvest
+struct HistRequest
+{
+    Contract    contract;
+    std::string duration;
+    std::string barSize;
+    std::string whatToShow;
+    /// End of the requested window in IB format, empty means now
+    std::string endDateTime;
+    /// Requested window in epoch seconds, filled in by HarvestPlanner
+    int64_t windowStart = 0;
+    int64_t windowEnd = 0;
+};
+
+/// A closed time range in epoch seconds
+using TimeRange = std::pair<int64_t, int64_t>;
+
+/// @brief Local record of the historical ranges already harvested
+///
+/// Coverage is kept per series, a series being one (conId, barSize, whatToShow)
+/// combination. Stored as a small tab separated text file so it can be
+/// inspected and edited by hand.
+class HarvestCatalog
+{
+public:
+    HarvestCatalog() = default;
+    bool load( const std::string& );
+    bool save( const std::string& ) const;
+    /// Marks a range of a series as harvested at a time in epoch seconds, merging it
+    /// with its neighbours. The range is cut at the start of the bar still in
+    /// progress at that time, so a partial bar is asked for again
+    void add( const HistRequest&, TimeRange, int64_t );
+    /// Harvested ranges of a series, sorted and non-overlapping
+    const std::vector<TimeRange>& covered( const HistRequest& ) const;
+    /// Key of the series a request belongs to
+    static std::string key( const HistRequest& );
+
+private:
+    void                                          insert( const std::string&, TimeRange );
+    std::map<std::string, std::vector<TimeRange>> series;
+};
+
+/// @brief Turns the harvest windows into requests for the ranges that are missing
+///
+/// Each window of the harvest plan is compared against the catalog and only the
+/// gaps are requested, with an explicit endDateTime. Gaps longer than the window
+/// duration are split so every request stays within the duration IB allows for
+/// its bar size.
+class HarvestPlanner
+{
+public:
+    explicit HarvestPlanner( const HarvestCatalog& );
+    /// Gap requests for a plan of windows ending at the given time
+    std::vector<HistRequest> plan( const std::vector<HistRequest>&, int64_t now ) const;
+
+    /// Length of an IB duration string ("1800 S", "2 D", "1 W", "1 M", "1 Y") in seconds
+    static int64_t durationSeconds( const std::string& );
+    /// Length of an IB bar size string ("5 secs", "1 min", "1 hour", "1 day") in seconds
+    static int64_t barSeconds( const std::string& );
+    /// End of the last bar of a bar size closed at an epoch time, in epoch seconds
+    static int64_t lastClose( const std::string&, int64_t );
+    /// IB duration string covering the given number of seconds
+    static std::string durationString( int64_t );
+    /// IB endDateTime string for an epoch time
+    static std::string endDateTime( int64_t );
+
+private:
+    const HarvestCatalog& catalog;
+};
@@ -0,0 +1,201 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <limits>
+#include <vector>
+
+/// Default root directory of the history store, relative to the working directory
+constexpr const char* HISTORY_ROOT = "history";
+/// Rows between two entries of a segment's sparse time index
+constexpr uint64_t STORE_INDEX_STRIDE = 1024;
+/// Most columns a segment can hold, the time column included
+constexpr size_t STORE_MAX_COLUMNS = 8;
+
+/// Kind of series held by a segment, each kind has a fixed column layout
+enum class SeriesKind : uint32_t
+{
+    Bars = 0,  // time, open, high, low, close, volume
+    Snaps = 1, // time, bidPrice, askPrice, bidSize, askSize
+    Trades = 2 // time, price, size, flags
+};
+
+enum class ColumnType : uint32_t
+{
+    Int64,
+    Double
+};
+
+/// @brief Column layout of a series kind
+///
+/// Column 0 is always the time of the row in epoch nanoseconds. Every column is
+/// 8 bytes wide so a segment can be viewed as plain arrays.
+struct SeriesSchema
+{
+    SeriesKind               kind;
+    std::vector<ColumnType>  types;
+    std::vector<std::string> names;
+    static const SeriesSchema& get( SeriesKind );
+};
+
+/// One candle as it is stored
+struct BarRow
+{
+    /// epoch nanoseconds
+    int64_t time;
+    double  open;
+    double  high;
+    double  low;
+    double  close;
+    int64_t volume;
+};
+
+/// One tick-by-tick trade print as it is stored
+struct TradeRow
+{
+    /// epoch nanoseconds
+    int64_t time;
+    double  price;
+    int64_t size;
+    /// TRADE_PAST_LIMIT and TRADE_UNREPORTED bits
+    int64_t flags;
+};
+
+/// One tick-by-tick quote as it is stored, in the Snaps layout
+struct QuoteRow
+{
+    /// epoch nanoseconds
+    int64_t time;
+    double  bidPrice;
+    double  askPrice;
+    int64_t bidSize;
+    int64_t askSize;
+};
+
+/// Per column statistics kept in a segment footer
+struct ColumnStats
+{
+    double min;
+    double max;
+    double sum;
+};
+
+/// Half open range of rows [begin, end)
+struct RowRange
+{
+    size_t begin;
+    size_t end;
+    size_t size() const { return end - begin; }
+};
+
+/// One row of a segment in raw form, used when merging new rows into a segment
+struct RawRow
+{
+    int64_t  time;
+    uint64_t values[STORE_MAX_COLUMNS - 1];
+};
+
+/// @brief Read-only memory mapped view of one segment file
+///
+/// A segment holds one series, e.g. the 1 minute bars of one conId. Columns are
+/// stored back to back, so the pointers handed out point straight into the
+/// mapping and scanning a column is a sequential read of the file.
+class Segment
+{
+public:
+    Segment() = default;
+    ~Segment();
+    Segment( const Segment& ) = delete;
+    Segment& operator=( const Segment& ) = delete;
+
+    /// Maps a segment file. Returns false if it is missing or not a valid segment
+    bool open( const std::string& );
+    void close();
+
+    SeriesKind  kind() const;
+    size_t      rows() const;
+    size_t      columns() const;
+    long        conId() const;
+    std::string interval() const;
+    /// Time column, epoch nanoseconds
+    const int64_t* times() const;
+    const double*  doubles( size_t ) const;
+    const int64_t* ints( size_t ) const;
+    /// Footer statistics of a column
+    const ColumnStats& stats( size_t ) const;
+    /// Rows with from <= time < to, found through the sparse index
+    RowRange range( int64_t, int64_t ) const;
+    /// Copies the rows of a range out of the mapping
+    std::vector<RawRow> raw( RowRange ) const;
+    std::vector<BarRow> bars( RowRange ) const;
+
+private:
+    const uint8_t*     base = nullptr;
+    size_t             length = 0;
+    const void*        header = nullptr;
+    const int64_t*     index = nullptr;
+    const ColumnStats* footer = nullptr;
+};
+
+struct DecodedSeries;
+
+/// @brief On disk columnar history, one segment per (conId, interval)
+///
+/// Segments live at root/conId/interval.seg. Writing to a series merges the new
+/// rows with what is already stored (new rows win on equal times) and replaces
+/// the segment atomically, so readers never see a partially written file.
+///
+/// Rows can also be appended as a part, root/conId/interval.<first time>.part,
+/// a segment of their own written without reading the series. merge() folds the
+/// parts into the series, and compacting a series merges it first. Until then
+/// the parts are not seen by open() and load().
+///
+/// A series can be compacted into root/conId/interval.segz, the SeriesCodec
+/// encoding of the segment. Compacted series can't be mapped, they are read
+/// through load(), which handles both forms.
+class HistoryStore
+{
+public:
+    explicit HistoryStore( std::string );
+    bool write( long, const std::string&, SeriesKind, std::vector<RawRow> );
+    bool write( long, const std::string&, const std::vector<BarRow>& );
+    bool write( long, const std::string&, const std::vector<TradeRow>& );
+    bool write( long, const std::string&, const std::vector<QuoteRow>& );
+    /// Writes rows as a new part of a series, in time proportional to the rows alone
+    bool append( long, const std::string&, SeriesKind, std::vector<RawRow> );
+    bool append( long, const std::string&, const std::vector<TradeRow>& );
+    bool append( long, const std::string&, const std::vector<QuoteRow>& );
+    /// Merges the parts of a series into it and deletes them
+    bool merge( long, const std::string& );
+    /// Maps the segment of a series, nullptr if it doesn't exist or is compacted
+    std::unique_ptr<Segment> open( long, const std::string& ) const;
+    /// Reads the rows of a series with from <= time < to, compacted or not
+    bool load( long, const std::string&, DecodedSeries&,
+               int64_t from = std::numeric_limits<int64_t>::min(),
+               int64_t to = std::numeric_limits<int64_t>::max() ) const;
+    /// Replaces the segment of a series with its compressed form
+    bool        compact( long, const std::string& );
+    std::string path( long, const std::string& ) const;
+    std::string compactPath( long, const std::string& ) const;
+    /// Path of the part of a series starting at a time
+    std::string partPath( long, const std::string&, int64_t ) const;
+    /// Intervals stored for a conId
+    std::vector<std::string> intervals( long ) const;
+    /// Every conId with at least one stored series
+    std::vector<long> conIds() const;
+
+    /// Parses an IB bar time ("yyyymmdd hh:mm:ss", "yyyymmdd" or epoch seconds) to epoch nanoseconds
+    static int64_t barTime( const std::string& );
+    /// Formats epoch nanoseconds the way IB formats bar times
+    static std::string barTimeString( int64_t );
+    /// Formats epoch nanoseconds as an IB UTC time, "yyyymmdd-hh:mm:ss", which TWS
+    /// reads the same whatever its login timezone
+    static std::string utcTimeString( int64_t );
+
+private:
+    /// Writes sorted rows to a segment file, replacing it atomically
+    bool writeSegment( const std::string&, long, const std::string&, SeriesKind, const std::vector<RawRow>& );
+
+    std::string root;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include "Contract.h"
+#include "EWrapper.h"
+#include "bar.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Records buffered by a journal before they are written out
+constexpr size_t JOURNAL_FLUSH_RECORDS = 4096;
+
+/// Kind of callback a journal record holds
+enum class JournalType : uint32_t
+{
+    Line = 0,      // a market data line, id is the tickerId
+    TickPrice,     // field is the tick type, values[0] the price
+    TickSize,      // field is the tick type, values[0] the size
+    TickOption,    // field is the tick type, values are the eight computation arguments
+    HistoricalBar, // id is the reqId, values are open, high, low, close, wap, volume, count
+    OrderStatus,   // id is the orderId, text the status, values filled, remaining, avgFillPrice, lastFillPrice
+    MarketDepth    // id is the reqId, field the position, values operation, side, price, size
+};
+
+/// @brief One recorded callback
+///
+/// Records are fixed size so a journal can be read back with a single read and
+/// indexed directly.
+struct JournalRecord
+{
+    /// Arrival time, epoch nanoseconds
+    int64_t  time;
+    uint32_t type;
+    int32_t  field;
+    int64_t  id;
+    double   values[8];
+    char     text[24];
+};
+
+/// @brief Binary journal of the market data and order callbacks of a session
+///
+/// Written by ClientBrain while trading and read back by ReplayDriver. The file
+/// is a 16 byte header followed by JournalRecords in arrival order.
+class Journal
+{
+public:
+    Journal() = default;
+    ~Journal();
+    Journal( const Journal& ) = delete;
+    Journal& operator=( const Journal& ) = delete;
+
+    /// Creates the journal file, replacing an existing one
+    bool open( const std::string& );
+    void close();
+    void flush();
+
+    void line( TickerId, const Contract& );
+    void tickPrice( TickerId, TickType, double );
+    void tickSize( TickerId, TickType, int );
+    void tickOptionComputation( TickerId, TickType, double, double, double, double,
+                                double, double, double, double );
+    void historicalData( TickerId, const Bar& );
+    void orderStatus( OrderId, const std::string&, double, double, double, double );
+    void marketDepth( TickerId, int, int, int, double, int );
+
+    /// Reads every record of a journal file
+    static bool load( const std::string&, std::vector<JournalRecord>& );
+    /// Contract of a Line record
+    static Contract contract( const JournalRecord& );
+    /// Bar of a HistoricalBar record
+    static Bar bar( const JournalRecord& );
+    /// Text field of a record
+    static std::string text( const JournalRecord& );
+
+private:
+    JournalRecord& next( JournalType, int, int64_t );
+
+    int                        fd = -1;
+    std::vector<JournalRecord> buffer;
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Metrics a registry can hold, counting every label set
+constexpr size_t MAXIMUM_METRICS = 4096;
+/// Port of the Trader metrics listener, the DataHarvester uses the one after it
+constexpr int METRICS_PORT = 9464;
+/// Longest the listener waits on a scraper, in milliseconds
+constexpr int METRICS_TIMEOUT = 1000;
+
+/// Value that only goes up
+class MetricCounter
+{
+public:
+    MetricCounter();
+    void     add( uint64_t = 1 );
+    uint64_t value() const;
+
+private:
+    std::atomic<uint64_t> count;
+};
+
+/// Value that is set to the current level of something
+class MetricGauge
+{
+public:
+    MetricGauge();
+    void    set( int64_t );
+    int64_t value() const;
+
+private:
+    std::atomic<int64_t> level;
+};
+
+/// Counts of observed values under fixed upper bounds, plus their sum
+class MetricHistogram
+{
+public:
+    /// Upper bounds in ascending order, the +Inf bucket is implied
+    explicit MetricHistogram( std::vector<int64_t> );
+    void                        observe( int64_t );
+    const std::vector<int64_t>& bounds() const;
+    /// Observations at or under the bound of a bucket, not cumulative
+    uint64_t bucket( size_t ) const;
+    uint64_t count() const;
+    int64_t  sum() const;
+
+private:
+    std::vector<int64_t>                     limits;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+    std::atomic<uint64_t>                    total;
+    std::atomic<int64_t>                     added;
+};
+
+/// @brief Registry of the counters, gauges and histograms of the process
+///
+/// Updating a metric is one relaxed atomic operation, so the trading thread never
+/// waits on a scrape. Metrics are registered once and never removed. A new
+/// entry is filled in before the entry count is published, so render() reads
+/// every published entry without taking the lock that registrations share.
+/// Registering a name and label set that already exists returns the same metric.
+///
+/// Values are integers. A metric kept in nanoseconds is given a scale of 1e-9
+/// and rendered in seconds.
+class Metrics
+{
+public:
+    Metrics();
+
+    /// Registry the client library reports to
+    static Metrics& global();
+
+    /// Name, help text, then labels as they go between the braces: line="7",symbol="SPY"
+    MetricCounter&   counter( const std::string&, const std::string&, const std::string& = "", double = 1 );
+    MetricGauge&     gauge( const std::string&, const std::string&, const std::string& = "", double = 1 );
+    MetricHistogram& histogram( const std::string&, const std::string&, const std::vector<int64_t>&,
+                                const std::string& = "", double = 1 );
+    /// Every metric in the Prometheus text format
+    std::string render() const;
+
+private:
+    enum class Kind
+    {
+        Counter,
+        Gauge,
+        Histogram
+    };
+    struct Entry
+    {
+        Kind                             kind;
+        std::string                      name;
+        std::string                      help;
+        std::string                      labels;
+        double                           scale;
+        std::unique_ptr<MetricCounter>   counter;
+        std::unique_ptr<MetricGauge>     gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+    /// Existing entry of a name and label set, or a new one filled by the function. Returns its
+    /// index, MAXIMUM_METRICS when the registry is full and the caller gets a metric nobody reads
+    template <typename Fill>
+    size_t entry( Kind, const std::string&, const std::string&, const std::string&, double, Fill );
+
+    std::array<Entry, MAXIMUM_METRICS> entries;
+    std::atomic<size_t>                published;
+    std::mutex                         registering;
+};
+
+/// @brief Serves a registry at http://127.0.0.1:<port>/metrics from a thread of its own
+///
+/// The thread renders the registry for each request and answers with HTTP/1.0, so
+/// a scrape never touches the trading thread. Only localhost is listened on.
+class MetricsServer
+{
+public:
+    explicit MetricsServer( const Metrics& );
+    ~MetricsServer();
+
+    /// Starts listening on a port, false when it cannot be bound
+    bool start( int );
+    void stop();
+
+private:
+    void serve();
+    void answer( int );
+
+    const Metrics&    metrics;
+    int               listener;
+    std::atomic<bool> running;
+    std::thread       worker;
+};
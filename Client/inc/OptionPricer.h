@@ -0,0 +1,105 @@
+#pragma once
+#include "Contract.h"
+#include "VolSurface.h"
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+/// Annual risk free rate used to price option chains unless set otherwise
+constexpr double RISK_FREE_RATE = 0.05;
+
+/// @brief Structure-of-arrays inputs and outputs of one pricing pass, one slot per option
+///
+/// Greeks follow the TWS conventions: vega per volatility point and theta per
+/// calendar day. Slots whose price has no implied volatility get NaN outputs.
+struct PricingBatch
+{
+    std::vector<double> strike;
+    /// Years to expiry
+    std::vector<double> years;
+    /// 1 for calls, -1 for puts
+    std::vector<double> sign;
+    /// Option price to solve for
+    std::vector<double> price;
+    std::vector<double> iv;
+    std::vector<double> delta;
+    std::vector<double> gamma;
+    std::vector<double> vega;
+    std::vector<double> theta;
+    /// Scratch space of the solver: the volatility bracket and the terms that
+    /// do not depend on the volatility
+    std::vector<double> lower;
+    std::vector<double> upper;
+    std::vector<double> logMoney;
+    std::vector<double> root;
+    std::vector<double> discount;
+
+    void   resize( size_t );
+    size_t size() const;
+};
+
+/// @brief Black-Scholes pricing and implied volatility over whole batches of options
+///
+/// The solver runs a fixed number of bracketed Newton steps for every slot, with
+/// no data dependent branches, so each loop is a straight pass over the batch
+/// arrays that the compiler can vectorize.
+class OptionPricer
+{
+public:
+    /// Solves the implied volatility and greeks at one underlying price, of every
+    /// slot or of the given count of slots from the given one
+    static void solve( double, double, PricingBatch&, size_t = 0,
+                       size_t = std::numeric_limits<size_t>::max() );
+    /// Black-Scholes value of one option from spot, strike, years, rate, volatility and call flag
+    static double value( double, double, double, double, double, bool );
+};
+
+/// @brief Options of one underlying, repriced together whenever the underlying moves
+class OptionChain
+{
+public:
+    OptionChain();
+
+    /// Adds the option of a market data line
+    void add( long, const Contract& );
+    bool contains( long ) const;
+    /// Slot of an option line in the batches
+    size_t slot( long ) const;
+    /// Records a bid (1), ask (2) or last (4) tick of an option line
+    void quote( long, int, double );
+    /// Records a bid (1), ask (2) or last (4) tick of the underlying
+    void underlying( int, double );
+    /// Underlying price, the quote midpoint when there is one, else the last trade
+    double spot() const;
+    /// Reprices every option at the given epoch nanoseconds. False without an underlying price
+    bool solve( int64_t, double );
+    /// Reprices the option of one line after its quote changed
+    bool solve( long, int64_t, double );
+    /// Midpoint of the bid and ask implied volatility of every strike, taken from
+    /// the out of the money option where both a call and a put are listed
+    const VolSurface& surface() const;
+
+    /// Option line of every slot
+    std::vector<long> lines;
+    /// Results of the last solve, from the option bids and asks
+    const PricingBatch& bids() const;
+    const PricingBatch& asks() const;
+
+private:
+    /// Sets the years to expiry of slots and passes their solved volatility to the surface
+    void prepare( size_t, size_t, int64_t );
+    void publish( size_t, size_t );
+
+    std::map<long, size_t> slots;
+    /// Expiry of every slot in epoch nanoseconds
+    std::vector<int64_t> expiries;
+    /// Slot of the call or put with the same expiry and strike, the slot itself when there is none
+    std::vector<size_t> siblings;
+    PricingBatch         bidBatch;
+    PricingBatch         askBatch;
+    VolSurface           volSurface;
+    double               underBid;
+    double               underAsk;
+    double               underLast;
+};
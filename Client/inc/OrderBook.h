@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+/// Rows kept per side of a book, TWS sends at most this many for smart depth
+constexpr int BOOK_DEPTH = 10;
+/// Depth subscriptions TWS allows at once without market data booster packs
+constexpr int MAXIMUM_DEPTH_BOOKS = 3;
+
+/// Market depth operations and sides as TWS numbers them
+constexpr int DEPTH_INSERT = 0;
+constexpr int DEPTH_UPDATE = 1;
+constexpr int DEPTH_DELETE = 2;
+constexpr int DEPTH_ASK = 0;
+constexpr int DEPTH_BID = 1;
+
+/// One price level of a book
+struct BookLevel
+{
+    double  price;
+    int64_t size;
+};
+
+/// @brief Limit order book of one contract, built from market depth updates
+///
+/// Each side is a fixed array of BOOK_DEPTH levels kept in the row order TWS
+/// uses, so an update is applied by position: an insert shifts the rows
+/// below it down, a delete shifts them up and an update overwrites in place.
+/// No update touches more than BOOK_DEPTH rows and nothing is allocated.
+class OrderBook
+{
+public:
+    OrderBook();
+
+    /// Applies an updateMktDepth or updateMktDepthL2 operation. False when the
+    /// position or operation is out of range
+    bool apply( int, int, int, double, int64_t );
+    void clear();
+
+    /// Rows on a side
+    int            levels( int ) const;
+    const BookLevel& level( int, int ) const;
+    /// Best bid and ask, a zero level when the side is empty
+    const BookLevel& bestBid() const;
+    const BookLevel& bestAsk() const;
+    /// (bid size - ask size) / (bid size + ask size) over the given number of top rows, in [-1, 1]
+    double imbalance( int = BOOK_DEPTH ) const;
+    /// Top of book price weighted by the opposite sizes, the midpoint when a size is missing
+    double microprice() const;
+    /// Updates applied so far
+    uint64_t updates() const;
+
+private:
+    struct Side
+    {
+        std::array<BookLevel, BOOK_DEPTH> rows;
+        int                               count;
+    };
+
+    Side     sides[2];
+    uint64_t applied;
+};
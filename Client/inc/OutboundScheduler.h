@@ -0,0 +1,81 @@
+#pragma once
+#include "CommonDefs.h"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+
+class MetricCounter;
+class MetricGauge;
+
+/// Messages per second the scheduler sends at most, after the burst
+constexpr double OUTBOUND_RATE = 40;
+/// Messages that can go out at once after a quiet period. TWS disconnects a client
+/// that sends more than 50 messages in a second, so the burst plus a second of the
+/// rate stays under it
+constexpr double OUTBOUND_BURST = 10;
+constexpr size_t OUTBOUND_LANES = 4;
+
+/// Priority of an outbound message, the lower lanes wait for the higher ones
+enum class OutboundLane : int
+{
+    Cancels = 0, // order cancels
+    Orders,      // new and modified orders, execution requests
+    MarketData,  // market data, depth, real-time bar and tick-by-tick subscriptions
+    Historical   // historical data and contract lookups
+};
+
+/// @brief Single gate for the requests sent to TWS, shared by every component of a client
+///
+/// A token bucket refilled at OUTBOUND_RATE holds up to OUTBOUND_BURST tokens
+/// and every message takes one. A message goes out at once when a token is
+/// free and nothing of its lane or a higher one waits, otherwise it is queued
+/// in its lane. pump() sends the queued messages, highest lane first and in
+/// order within a lane, for as long as tokens last. The main loop pumps while
+/// it waits, so the queue drains at the rate limit.
+///
+/// Order cancels always wait for the next pump. Each cancel carries a key
+/// naming what a modify may change, the caller decides what it holds. If an
+/// order with the same key is placed before then, the cancel is taken back and
+/// the new order is sent under the id of the cancelled one, which TWS treats as
+/// a modify: one message instead of two.
+class OutboundScheduler
+{
+public:
+    OutboundScheduler();
+
+    void send( OutboundLane, std::function<void()> );
+    /// Queues the cancel of an order under a key
+    void cancel( OrderId, const std::string&, std::function<void()> );
+    /// Order id of a queued cancel with a key, -1 when none waits
+    OrderId cancelled( const std::string& ) const;
+    /// Takes back the queued cancel of an order
+    void replace( OrderId );
+    /// Sends queued messages while tokens last
+    void pump();
+    /// Nanoseconds until the next queued message can go, -1 when nothing waits
+    int64_t due();
+    size_t  waiting() const;
+
+private:
+    struct Message
+    {
+        std::function<void()> call;
+        /// Order and key of a cancel
+        OrderId     order;
+        std::string key;
+    };
+    /// Adds the tokens earned since the last refill
+    void refill();
+    void sendNow( std::function<void()>& );
+
+    std::array<std::deque<Message>, OUTBOUND_LANES> lanes;
+    double                                          tokens;
+    /// Steady clock nanoseconds of the last refill
+    int64_t        refilled;
+    size_t         queued;
+    MetricCounter* sentCount;
+    MetricCounter* coalesced;
+    MetricGauge*   queueDepth;
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include "Contract.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Shortest time between two reconciliations of a contract against pnlSingle, in seconds
+constexpr int64_t PNL_RECONCILE = 60;
+
+/// @brief Profit, loss and exposure of the account, kept up to date tick by tick
+///
+/// Every contract has a slot in a dense table holding its position, average cost,
+/// multiplier and mark. A tick moves the mark of one slot, and the unrealized
+/// PnL and exposure of the slot and of the portfolio move by the difference, so
+/// a tick and every query cost O(1) whatever the size of the portfolio. Fills
+/// move the position and average cost and realize the PnL of what they close.
+/// The mark is the quote midpoint, or the last trade when one side is missing.
+///
+/// The positions TWS reports reset their slots. The pnlSingle subscription of
+/// each position corrects the drift at most every PNL_RECONCILE seconds: the
+/// position and realized PnL are taken as they are, and the average cost is set
+/// so the unrealized PnL matches TWS at the mark it used. A contract is its
+/// conId, as in RiskEngine, so each option series is valued on its own, and
+/// falls back to its ticker and security type without one. Stock and option
+/// lines mark their contracts, other positions are valued at the prices TWS
+/// reports for them.
+class PnLEngine
+{
+public:
+    PnLEngine();
+
+    /// Slot of a conId, or of a ticker and security type when the conId is 0,
+    /// made flat with a multiplier the first time
+    int slot( long, const std::string&, const std::string& = "STK", double = 1 );
+    /// Slot of a ticker and security type, for contracts without a conId
+    int slot( const std::string&, const std::string& = "STK", double = 1 );
+    /// Slot of a contract, with the multiplier of the contract
+    int slot( const Contract& );
+    /// Latest price of a slot, with the tick type of tickPrice: 1 bid, 2 ask, 4 last
+    void mark( int, int, double );
+    /// Books a fill of a slot: signed quantity and price
+    void fill( int, double, double );
+    /// Takes a commission off the realized PnL of a slot
+    void charge( int, double );
+    /// Position TWS reports for a slot: size, average cost per contract and market price
+    void position( int, double, double, double );
+
+    /// Ties a pnlSingle request id to a slot
+    void watch( long, int );
+    /// Whether a slot has a pnlSingle subscription
+    bool watched( int ) const;
+    /// Request ids of the pnlSingle subscriptions
+    std::vector<long> watches() const;
+    /// Update of a pnlSingle subscription: position, unrealized and realized PnL,
+    /// market value, at a time in epoch nanoseconds. False when the request id is unknown
+    bool reconcile( long, double, double, double, double, int64_t );
+
+    double realized() const;
+    double unrealized() const;
+    /// Sum of the absolute market values of the positions
+    double gross() const;
+    /// Sum of the signed market values of the positions
+    double net() const;
+    /// Realized plus unrealized PnL of a slot
+    double pnl( int ) const;
+    double exposure( int ) const;
+    /// Signed size of the position of a slot
+    double size( int ) const;
+
+private:
+    struct PnLSlot
+    {
+        double position;
+        /// Average cost per unit of the position
+        double average;
+        double multiplier;
+        double bid;
+        double ask;
+        double last;
+        /// Price the slot is valued at, 0 without a quote
+        double mark;
+        /// Signed market value of the position
+        double value;
+        double realized;
+        double unrealized;
+        /// pnlSingle request id, -1 without a subscription
+        long line;
+        /// Epoch nanoseconds of the last reconciliation
+        int64_t reconciled;
+    };
+    /// Recomputes the value and unrealized PnL of a slot and moves the totals by the change
+    void revalue( PnLSlot& );
+
+    std::vector<PnLSlot>                 slots;
+    std::unordered_map<long, int>        contracts;
+    std::unordered_map<std::string, int> symbols;
+    /// Slot of each pnlSingle request id
+    std::unordered_map<long, int> lines;
+    double                        totalRealized;
+    double                        totalUnrealized;
+    double                        totalGross;
+    double                        totalNet;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include "ClientBroker.h"
+#include "Journal.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ClientBrain;
+
+/// Most state machine steps run after one replayed record
+constexpr int REPLAY_MAX_STEPS = 8;
+
+/// @brief Replays a recorded session through the real ClientBrain callbacks
+///
+/// Records come from a Journal or from the bars of a history store and are
+/// handed to tickPrice, tickSize, tickOptionComputation, historicalData,
+/// updateMktDepth and orderStatus in timestamp order, with ClientClock
+/// following the record times. After every record the state machine is
+/// stepped until it is back in DATA_NEXT, so the strategy sees each tick the
+/// way it would live, minus the socket and the main loop delay.
+///
+/// Orders never reach TWS. By default they are filled at the last replayed
+/// price of their contract through the same orderStatus and execDetails path a
+/// live fill takes. Without simulated fills they are dropped and the recorded
+/// order statuses are replayed instead.
+class ReplayDriver : public OrderSink
+{
+public:
+    explicit ReplayDriver( ClientBrain& );
+    ~ReplayDriver() override;
+
+    /// Queues every record of a journal
+    bool loadJournal( const std::string& );
+    /// Queues the bars of one interval of every stored stock as last trade ticks.
+    /// Contracts are taken from the contract cache
+    bool loadHistory( const std::string&, const std::string& );
+    /// Queues the records of a tape shared with other drivers. The tape is
+    /// only read, so one copy of the history can feed several replays at once
+    void load( std::shared_ptr<const std::vector<JournalRecord>> );
+    /// Sorts the queued records into a tape that other drivers can load
+    std::shared_ptr<const std::vector<JournalRecord>> tape();
+    void simulateFills( bool );
+    /// Cash the account holds when the replay starts
+    void setCash( double );
+    /// Replays the queued records, calling the step function to run the state machine
+    void run( const std::function<void()>& );
+
+    void placeOrder( OrderId, const Contract&, const Order& ) override;
+    void reqExecutions( int, const ExecutionFilter& ) override;
+
+    /// Cash plus every position marked at the last replayed price of its contract
+    double equity() const;
+
+    /// Records replayed by the last run
+    size_t replayed;
+    /// Simulated fills of the last run
+    size_t fills;
+    /// Wall time of the last run, in seconds
+    double seconds;
+
+private:
+    void dispatch( const JournalRecord& );
+    /// Delivers the status and execution callbacks of the orders placed so far
+    void settle();
+
+    ClientBrain&                                             brain;
+    std::vector<JournalRecord>                               records;
+    /// Sorted records, possibly shared with other drivers
+    std::shared_ptr<const std::vector<JournalRecord>>        shared;
+    bool                                                     simulating;
+    /// conId of each replayed line
+    std::map<long, long>                                     lineConIds;
+    /// Last trade price of each conId
+    std::map<long, double>                                   lastPrice;
+    std::deque<std::pair<OrderId, std::pair<Contract, Order>>> placed;
+    long                                                     execCount;
+};
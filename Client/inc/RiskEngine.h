@@ -0,0 +1,128 @@
+#pragma once
+#include "Contract.h"
+#include "Order.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PnLEngine;
+
+/// Largest position in shares or contracts a contract may reach, either side
+constexpr double RISK_MAX_POSITION = 2000;
+/// Largest value of one order
+constexpr double RISK_MAX_ORDER_NOTIONAL = 100000;
+/// Largest value of all the orders accepted in a day
+constexpr double RISK_MAX_DAY_NOTIONAL = 1000000;
+/// Largest sum of the absolute market values of the positions, open orders not counted
+constexpr double RISK_MAX_GROSS_EXPOSURE = 500000;
+/// Furthest a limit price may be from the reference price, as a fraction of it
+constexpr double RISK_PRICE_BAND = 0.05;
+/// Shortest time between two orders of a contract, in milliseconds
+constexpr int64_t RISK_ORDER_GAP = 1000;
+
+/// Outcome of a pre-trade check, Accepted or the first limit the order breaks
+enum class RiskVerdict : int32_t
+{
+    Accepted = 0,
+    NoPrice,       // a market order for a contract without a quote yet
+    PriceBand,     // the limit price is too far from the quote
+    Position,      // the position would pass its limit
+    OrderNotional, // the order is worth too much
+    DayNotional,   // the orders of the day would be worth too much
+    RateLimit,     // the last order of the contract was too recent
+    GrossExposure  // the portfolio would be worth too much
+};
+
+/// Limits of a contract, the RISK_ constants unless set with RiskEngine::limit
+struct RiskLimits
+{
+    double  maxPosition;
+    double  maxOrderNotional;
+    double  priceBand;
+    int64_t orderGap;
+};
+
+/// @brief Pre-trade checks of the order path, run before an order leaves the process
+///
+/// Every contract has a slot holding its limits, with the order gap already in
+/// nanoseconds, and the state the checks need: the latest bid, ask and trade,
+/// the position, the working quantity of its open orders and the time of its
+/// last order. Market data marks the slot it was given once, so a tick costs a
+/// store. A check reads one slot and compares, nothing waits and nothing is
+/// sent, so a broken limit is rejected here instead of by TWS.
+///
+/// Positions move with the fills reported by orderStatus and are reset by the
+/// positions TWS reports. A contract is its conId, so every option series has a
+/// slot of its own, marked by its own market data line. A contract without a
+/// conId falls back to its ticker and security type. Market orders are valued at the quote
+/// midpoint, or the last trade when one side is missing. With a portfolio to
+/// watch, an order that grows a position is also checked against the gross
+/// exposure the PnLEngine keeps.
+class RiskEngine
+{
+public:
+    RiskEngine();
+
+    /// Slot of a contract, made with the default limits the first time
+    int slot( const Contract& );
+    /// Slot of a ticker and security type, for contracts without a conId
+    int slot( const std::string&, const std::string& = "STK" );
+    /// Changes the limits of a contract
+    void limit( const Contract&, const RiskLimits& );
+    /// Changes the limit on the orders of a day
+    void dayLimit( double );
+    /// Checks the gross exposure of a portfolio, nullptr stops checking it
+    void portfolio( const PnLEngine* );
+    /// Changes the limit on the gross exposure
+    void grossLimit( double );
+    /// Latest price of a slot, with the tick type of tickPrice: 1 bid, 2 ask, 4 last
+    void mark( int, int, double );
+    /// Position TWS reports for a contract
+    void position( const Contract&, double );
+
+    /// Checks an order about to be sent under an order id at a time in epoch nanoseconds.
+    /// An accepted order is booked as working on its contract
+    RiskVerdict check( const Contract&, const Order&, long, int64_t );
+    /// Status of a booked order: filled and remaining size
+    void status( long, double, double );
+
+    static const char* name( RiskVerdict );
+
+private:
+    struct RiskSlot
+    {
+        RiskLimits limits;
+        double     bid;
+        double     ask;
+        double     last;
+        double     position;
+        /// Signed size of the open orders not filled yet
+        double  working;
+        int64_t lastOrder;
+    };
+    struct BookedOrder
+    {
+        int    slot;
+        double side;
+        double filled;
+        double remaining;
+        /// Notional counted in the orders of the day, a modify only adds what it grows by
+        double notional;
+    };
+    /// Reference price of a slot, 0 without a quote
+    double reference( const RiskSlot& ) const;
+    /// Appends a slot with the default limits
+    int add();
+
+    std::vector<RiskSlot>                slots;
+    std::unordered_map<long, int>        contracts;
+    std::unordered_map<std::string, int> symbols;
+    std::unordered_map<long, BookedOrder> booked;
+    double                               maxDayNotional;
+    double                               maxGross;
+    const PnLEngine*                     book;
+    double                               dayNotional;
+    /// Day of dayNotional, in days since the epoch
+    int64_t day;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include "HistoryStore.h"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/// Rows encoded together in one compressed block
+constexpr size_t CODEC_BLOCK_ROWS = 4096;
+
+/// @brief Columns of a series decoded from its compressed form
+///
+/// Every column is kept as 8 byte words, the same layout a Segment maps, so
+/// readers can use either interchangeably.
+struct DecodedSeries
+{
+    SeriesKind                        kind = SeriesKind::Bars;
+    std::vector<std::vector<int64_t>> columns;
+    size_t                            rows() const { return columns.empty() ? 0 : columns[0].size(); }
+    const int64_t*                    times() const { return columns[0].data(); }
+    const int64_t*                    ints( size_t column ) const { return columns[column].data(); }
+    const double*                     doubles( size_t column ) const
+    {
+        return reinterpret_cast<const double*>( columns[column].data() );
+    }
+};
+
+/// Position of one compressed block inside an encoded series
+struct BlockInfo
+{
+    int64_t  firstTime;
+    int64_t  lastTime;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t rows;
+};
+
+/// @brief Compression of history columns
+///
+/// Each column type has its own encoding:
+/// - the time column is delta-of-delta encoded, after dividing out the largest
+///   common power of ten so second aligned bars collapse to single bits
+/// - double columns whose values all sit on a decimal grid (cents, hundredths of
+///   a cent) are scaled to integers and encoded like int columns, any other
+///   double column is XOR encoded against the previous value (Gorilla)
+/// - int columns (volumes, sizes) are zigzag varints of the delta to the
+///   previous value
+///
+/// Rows are encoded in blocks of CODEC_BLOCK_ROWS with their time bounds kept
+/// in a directory, so a range read only decodes the blocks it touches.
+class SeriesCodec
+{
+public:
+    /// Encodes one block of rows, columns are given as 8 byte words
+    static std::vector<uint8_t> encodeBlock( const std::vector<ColumnType>&,
+                                             const std::vector<const int64_t*>&, size_t );
+    /// Decodes one block, appending its rows to the output columns
+    static bool decodeBlock( const std::vector<ColumnType>&, const uint8_t*, size_t,
+                             std::vector<std::vector<int64_t>>& );
+    /// Encodes a whole series into blocks, filling in the block directory
+    static std::vector<uint8_t> encode( const std::vector<ColumnType>&,
+                                        const std::vector<const int64_t*>&, size_t,
+                                        std::vector<BlockInfo>& );
+    /// Decodes the blocks overlapping [from, to) and trims the rows outside of it
+    static bool decode( const std::vector<ColumnType>&, const uint8_t*,
+                        const std::vector<BlockInfo>&, DecodedSeries&,
+                        int64_t from = std::numeric_limits<int64_t>::min(),
+                        int64_t to = std::numeric_limits<int64_t>::max() );
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include "Client.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ClientSpace
+{
+    constexpr size_t STATE_COUNT = INT + 1;
+
+    /// Name of every state, in the order of the State enum
+    constexpr std::array<const char*, STATE_COUNT> STATE_NAMES = {
+        "CONNECT", "CONNECTSUCCESS", "CONNECTFAIL", "DISCONNECTED", "INIT", "INITSUCCESS",
+        "INITFAIL", "ACTIVETRADING", "PASSIVETRADING", "ACCOUNTID", "ACCOUNTIDSUCCESS",
+        "ACCOUNTINIT", "ACCOUNTINITSUCCESS", "ACCOUNTCLOSE", "ACCOUNTCLOSESUCCESS",
+        "ACCOUNTCLOSEFAIL", "DATAINIT", "DATAINITSUCCESS", "DATAHARVEST",
+        "DATAHARVEST_TIMEOUT_0", "DATAHARVEST_TIMEOUT_1", "DATAHARVEST_TIMEOUT_2",
+        "DATAHARVEST_LIVE", "DATAHARVEST_DONE", "DATA_NEXT", "TRADING", "ORDERING",
+        "TICKDATAOPERATION", "TICKDATAOPERATION_ACK", "TICKOPTIONCOMPUTATIONOPERATION",
+        "TICKOPTIONCOMPUTATIONOPERATION_ACK", "DELAYEDTICKDATAOPERATION",
+        "DELAYEDTICKDATAOPERATION_ACK", "MARKETDEPTHOPERATION", "MARKETDEPTHOPERATION_ACK",
+        "REALTIMEBARS", "REALTIMEBARS_ACK", "MARKETDATATYPE", "MARKETDATATYPE_ACK",
+        "HISTORICALDATAREQUESTS", "HISTORICALDATAREQUESTS_ACK", "OPTIONSOPERATIONS",
+        "OPTIONSOPERATIONS_ACK", "CONTRACTOPERATION", "CONTRACTOPERATION_ACK", "MARKETSCANNERS",
+        "MARKETSCANNERS_ACK", "FUNDAMENTALS", "FUNDAMENTALS_ACK", "BULLETINS", "BULLETINS_ACK",
+        "ACCOUNTOPERATIONS", "ACCOUNTOPERATIONS_ACK", "ORDEROPERATIONS", "ORDEROPERATIONS_ACK",
+        "OCASAMPLES", "OCASAMPLES_ACK", "CONDITIONSAMPLES", "CONDITIONSAMPLES_ACK",
+        "BRACKETSAMPLES", "BRACKETSAMPLES_ACK", "HEDGESAMPLES", "HEDGESAMPLES_ACK",
+        "TESTALGOSAMPLES", "TESTALGOSAMPLES_ACK", "FAORDERSAMPLES", "FAORDERSAMPLES_ACK",
+        "FAOPERATIONS", "FAOPERATIONS_ACK", "DISPLAYGROUPS", "DISPLAYGROUPS_ACK",
+        "MISCELANEOUS", "MISCELANEOUS_ACK", "CANCELORDER", "CANCELORDER_ACK", "FAMILYCODES",
+        "FAMILYCODES_ACK", "SYMBOLSAMPLES", "SYMBOLSAMPLES_ACK", "REQMKTDEPTHEXCHANGES",
+        "REQMKTDEPTHEXCHANGES_ACK", "REQNEWSTICKS", "REQNEWSTICKS_ACK", "REQSMARTCOMPONENTS",
+        "REQSMARTCOMPONENTS_ACK", "NEWSPROVIDERS", "NEWSPROVIDERS_ACK", "REQNEWSARTICLE",
+        "REQNEWSARTICLE_ACK", "REQHISTORICALNEWS", "REQHISTORICALNEWS_ACK", "REQHEADTIMESTAMP",
+        "REQHEADTIMESTAMP_ACK", "REQHISTOGRAMDATA", "REQHISTOGRAMDATA_ACK", "REROUTECFD",
+        "REROUTECFD_ACK", "MARKETRULE", "MARKETRULE_ACK", "PNL", "PNL_ACK", "PNLSINGLE",
+        "PNLSINGLE_ACK", "CONTFUT", "CONTFUT_ACK", "PING", "PING_ACK", "REQHISTORICALTICKS",
+        "REQHISTORICALTICKS_ACK", "REQTICKBYTICKDATA", "REQTICKBYTICKDATA_ACK", "WHATIFSAMPLES",
+        "WHATIFSAMPLES_ACK", "IDLE", "INT" };
+
+    constexpr bool sameName( const char* a, const char* b )
+    {
+        return *a == *b && ( *a == '\0' || sameName( a + 1, b + 1 ) );
+    }
+
+    // the names drift from the enum when a state is added to only one of them
+    static_assert( sameName( STATE_NAMES[DISCONNECTED], "DISCONNECTED" ), "STATE_NAMES is out of order" );
+    static_assert( sameName( STATE_NAMES[DATA_NEXT], "DATA_NEXT" ), "STATE_NAMES is out of order" );
+    static_assert( sameName( STATE_NAMES[ORDERING], "ORDERING" ), "STATE_NAMES is out of order" );
+    static_assert( sameName( STATE_NAMES[PING_ACK], "PING_ACK" ), "STATE_NAMES is out of order" );
+    static_assert( sameName( STATE_NAMES[IDLE], "IDLE" ), "STATE_NAMES is out of order" );
+    static_assert( sameName( STATE_NAMES[INT], "INT" ), "STATE_NAMES is out of order" );
+
+    constexpr const char* stateName( State state )
+    {
+        return (size_t)state < STATE_COUNT ? STATE_NAMES[state] : "UNKNOWN";
+    }
+
+    struct StateTransition
+    {
+        State from;
+        State to;
+    };
+
+    /// Moves between the TradeManager states, as seen from one pass of the main loop to the next.
+    /// A pass can go through several states, DATAHARVEST requests two batches before it
+    /// waits, so some moves skip the states in between
+    constexpr StateTransition STATE_TRANSITIONS[] = {
+        { CONNECT, CONNECTSUCCESS },
+        { CONNECT, CONNECTFAIL },
+        { CONNECTSUCCESS, INIT },
+        { INIT, INITSUCCESS },
+        { INIT, DATAINIT },
+        { INITSUCCESS, DATA_NEXT },
+        { INITSUCCESS, DATAHARVEST },
+        { ACCOUNTINITSUCCESS, DATA_NEXT },
+        { DATAINIT, DATAHARVEST },
+        { DATAHARVEST, DATAHARVEST_TIMEOUT_1 },
+        { DATAHARVEST, DATAHARVEST_LIVE },
+        { DATAHARVEST, REQHISTORICALTICKS },
+        { DATAHARVEST_TIMEOUT_0, DATAHARVEST_TIMEOUT_2 },
+        { DATAHARVEST_TIMEOUT_1, DATAHARVEST_TIMEOUT_2 },
+        { DATAHARVEST_TIMEOUT_1, DATAHARVEST_LIVE },
+        { DATAHARVEST_TIMEOUT_2, DATAHARVEST_LIVE },
+        { DATAHARVEST_DONE, DATAHARVEST_LIVE },
+        { DATA_NEXT, TRADING },
+        { TRADING, DATA_NEXT },
+        { TRADING, ORDERING },
+        { ORDERING, DATA_NEXT },
+        { ACCOUNTCLOSE, IDLE },
+        { PING_ACK, IDLE },
+    };
+
+    /// States any state can move to: the connection changes, interrupts and the
+    /// callbacks that set a state of their own
+    constexpr State ANY_STATE_TRANSITIONS[] = { CONNECT, DISCONNECTED, INT, ACCOUNTCLOSE, ACCOUNTCLOSESUCCESS,
+                                                PING_ACK, REQHEADTIMESTAMP_ACK };
+
+    using StateTable = std::array<std::array<bool, STATE_COUNT>, STATE_COUNT>;
+
+    constexpr StateTable makeStateTable()
+    {
+        auto table = StateTable {};
+        for( const auto& move : STATE_TRANSITIONS )
+        {
+            table[move.from][move.to] = true;
+        }
+        for( auto to : ANY_STATE_TRANSITIONS )
+        {
+            for( size_t from = 0; from < STATE_COUNT; from++ )
+            {
+                table[from][to] = true;
+            }
+        }
+        return table;
+    }
+
+    /// Allowed moves, indexed by the state left and then the state entered
+    constexpr StateTable STATE_TABLE = makeStateTable();
+
+    /// True when the table has the move, or the state stays the same
+    constexpr bool allowed( State from, State to ) { return from == to || STATE_TABLE[from][to]; }
+
+    static_assert( allowed( DATA_NEXT, TRADING ) && !allowed( DATA_NEXT, ORDERING ), "STATE_TABLE is wrong" );
+    static_assert( allowed( DATAHARVEST_LIVE, INT ), "STATE_TABLE is wrong" );
+
+    /// @brief Counts the entries into each state and the time spent in it
+    ///
+    /// The main loop shows it the state at the top of every pass. Time between two
+    /// passes goes to the state of the first one, so the time of a state includes
+    /// the socket reads made while in it. Moves missing from STATE_TABLE are
+    /// counted and logged at debug level, they are not stopped.
+    class StateTimer
+    {
+    public:
+        StateTimer();
+
+        /// Records the state of a pass at a time in epoch nanoseconds
+        void observe( State, int64_t );
+        /// Times a state has been entered
+        uint64_t entries( State ) const;
+        /// Nanoseconds spent in a state
+        int64_t time( State ) const;
+        State   current() const;
+        /// Moves seen that STATE_TABLE does not have
+        uint64_t unexpected() const;
+        /// One line per state entered so far, longest time first
+        std::string summary() const;
+
+    private:
+        std::array<uint64_t, STATE_COUNT> entered;
+        std::array<int64_t, STATE_COUNT>  spent;
+        State                             state;
+        /// Time of the last pass, 0 before the first one
+        int64_t  since;
+        uint64_t strays;
+    };
+} // namespace ClientSpace
@@ -0,0 +1,86 @@
+#pragma once
+#include "Contract.h"
+#include "EWrapper.h"
+#include "HistoryStore.h"
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+/// Ticks asked for by one reqHistoricalTicks page
+constexpr int TICK_PAGE_SIZE = 1000;
+/// Pages of a tick backfill waiting on TWS at once
+constexpr size_t TICK_PAGES_OPEN = 5;
+/// Times a failed page is sent again before its series is given up
+constexpr int TICK_PAGE_RETRIES = 3;
+
+/// @brief Pages the historical ticks of several contracts into history store rows
+///
+/// reqHistoricalTicks returns at most TICK_PAGE_SIZE ticks from a start time, plus
+/// the rest of the last second, so a window is walked page by page. Each page
+/// starts at the last second of the one before it. That second is dropped from
+/// the earlier page because the next page returns all of it again, unless the
+/// whole page is that one second. A page that comes back short or passes the
+/// end of the window finishes the series.
+///
+/// Ticks are converted once, straight into the raw rows of their series, and a
+/// finished series is moved into the store as a whole. Rows are stamped the way
+/// TickStreams stamps live ticks, the second plus the order within it in
+/// nanoseconds, so backfilled and recorded ticks of a second land on the same
+/// times. TRADES go to the "trades" series, BID_ASK to "quotes" and MIDPOINT
+/// to "midpoints".
+class TickBackfill
+{
+public:
+    TickBackfill();
+
+    /// Adds the ticks of a contract between two epoch seconds, of TRADES, BID_ASK or MIDPOINT
+    void add( const Contract&, int64_t, int64_t, const std::string& );
+    /// True when a page can be sent now
+    bool ready() const;
+    /// Takes the next page under the given request id, filling its contract, start time
+    /// in UTC and tick type. False when no page can be sent
+    bool next( long, Contract&, std::string&, std::string& );
+    bool contains( long ) const;
+    /// Appends the ticks of a page as they arrive
+    void ticks( long, const std::vector<HistoricalTick>& );
+    void ticks( long, const std::vector<HistoricalTickBidAsk>& );
+    void ticks( long, const std::vector<HistoricalTickLast>& );
+    /// Ends a page, queueing the page after it or finishing its series
+    void done( long );
+    /// Drops a page TWS answered with an error and sends it again, up to TICK_PAGE_RETRIES times
+    void failed( long );
+    /// Moves the finished series, or every series with the flag, into the store.
+    /// Returns the rows written
+    size_t store( HistoryStore&, bool = false );
+    /// True when no page is waiting or in flight
+    bool finished() const;
+
+private:
+    struct Series
+    {
+        Contract    contract;
+        std::string whatToShow;
+        /// Start of the next page and end of the window, epoch seconds
+        int64_t from;
+        int64_t to;
+        /// Rows of the stamped pages, then the page in flight with times in epoch seconds
+        std::vector<RawRow> rows;
+        size_t              pageStart;
+        /// Second of the last stamped row and the rows stamped in it so far
+        int64_t second;
+        int64_t sequence;
+        int     retries;
+        size_t  pages;
+        bool    finished;
+    };
+    /// Series a page belongs to, nullptr for a foreign request
+    Series* page( long );
+
+    std::vector<Series> series;
+    /// Series with a page waiting to be sent
+    std::deque<size_t> waiting;
+    /// Series of the pages in flight, by request id
+    std::map<long, size_t> inFlight;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include "Contract.h"
+#include "HistoryStore.h"
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+/// Tick-by-tick subscriptions TWS allows at once without market data boosters
+constexpr int MAXIMUM_TICK_STREAMS = 3;
+/// Records a stream buffers before they are written to the history store
+constexpr size_t TICK_FLUSH_ROWS = 65536;
+/// Flag bits of a stored trade print
+constexpr int64_t TRADE_PAST_LIMIT = 1;
+constexpr int64_t TRADE_UNREPORTED = 2;
+
+/// Kind of tick-by-tick data a stream carries
+enum class TickKind
+{
+    Trades, // every trade print, the "AllLast" tick type
+    Quotes  // every change of the top of book, the "BidAsk" tick type
+};
+
+/// A tick-by-tick subscription and the records it has not stored yet
+struct TickStream
+{
+    Contract contract;
+    TickKind kind;
+    /// Streams with a higher priority take the subscription slots first
+    int priority;
+    /// Market data line whose streaming bars the stream feeds, 0 for none
+    long line;
+    /// True while the stream holds a slot
+    bool active;
+    std::vector<TradeRow> trades;
+    std::vector<QuoteRow> quotes;
+    /// Exchange second of the last record and the records seen in it so far
+    int64_t second;
+    int64_t sequence;
+    /// Records received since the stream was added
+    uint64_t received;
+};
+
+/// @brief Tick-by-tick subscriptions, allocated to the slots TWS allows by priority
+///
+/// TWS only accepts a few tick-by-tick subscriptions at once. Every wanted
+/// stream is kept here, and allocate() hands the slots to the highest
+/// priorities, so dropping a stream or lowering the limit moves a waiting
+/// stream up without the caller tracking which ones were refused.
+///
+/// Tick-by-tick times only have second resolution. Records are stamped with
+/// the second plus their order within it in nanoseconds, so every record of a
+/// stream has a unique, increasing time in the history store.
+class TickStreams
+{
+public:
+    TickStreams();
+
+    /// Adds a stream under its request id, it waits for a slot until the next allocate()
+    TickStream& add( long, const Contract&, TickKind, int, long );
+    /// Removes a stream, false when there is none
+    bool              remove( long );
+    TickStream*       find( long );
+    const TickStream* find( long ) const;
+    /// Every stream by request id
+    const std::map<long, TickStream>& all() const;
+    /// Slots TWS allows
+    void limit( int );
+    int  limit() const;
+    /// Gives the slots to the highest priority streams, ties going to the oldest
+    /// request. Fills the ids to cancel and the ids to request
+    void allocate( std::vector<long>&, std::vector<long>& );
+    /// Takes the slot back from a stream TWS refused and lowers the limit to the
+    /// slots actually held. False when the stream was not active
+    bool refuse( long );
+    /// True when an active stream of the kind feeds the bars of a line
+    bool feeds( long, TickKind ) const;
+
+    /// Appends a trade print at the given exchange second, nullptr for an unknown stream
+    TickStream* trade( long, int64_t, double, int64_t, int64_t );
+    /// Appends a quote at the given exchange second, nullptr for an unknown stream
+    TickStream* quote( long, int64_t, double, double, int64_t, int64_t );
+
+private:
+    /// Unique time of the next record of a stream in epoch nanoseconds
+    static int64_t stamp( TickStream&, int64_t );
+
+    std::map<long, TickStream> streams;
+    /// Lines fed by an active stream of each kind
+    std::set<std::pair<long, int>> fed;
+    int                            capacity;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// @brief Allocation free parser of the time strings TWS sends, to epoch nanoseconds
+///
+/// Reads "yyyymmdd hh:mm:ss" bar times, "yyyymmdd  hh:mm:ss" execution times,
+/// "yyyymmdd" daily bar dates and epoch seconds, all in the local time zone of
+/// TWS, and "yyyymmdd-hh:mm:ss" times in UTC. A time zone name after the time
+/// is ignored. Bars of one response nearly always share their date, so the
+/// local midnight of the last date is kept and a time costs a few digit reads
+/// and an add. Dates where daylight saving time changes go through mktime.
+class TimeParser
+{
+public:
+    TimeParser();
+
+    /// Epoch nanoseconds of a time string, 0 when it is not a time
+    int64_t parse( const char*, size_t );
+    int64_t parse( const std::string& );
+
+    /// Epoch seconds of a UTC date and time
+    static int64_t utc( int, int, int, int = 0, int = 0, int = 0 );
+
+private:
+    /// Local epoch seconds of a date and time
+    int64_t local( int, int, int, int, int, int );
+
+    /// Date of the cached midnight as yyyymmdd, its epoch seconds and the length of that day
+    int     cachedDate;
+    int64_t cachedMidnight;
+    int64_t cachedLength;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// @brief Implied volatility surface of one underlying, grouped by expiry and strike
+///
+/// Every option of the chain owns one cell of the grid, so an update is a
+/// single store. Lookups land on their expiry and strike through bucket tables
+/// sized by the smallest strike and expiry gaps, so a query costs the same
+/// for ten strikes as for a thousand. Between strikes the volatility is
+/// interpolated linearly, between expiries linearly in total variance, and
+/// beyond the grid it is held flat. Cells without a volatility are skipped in
+/// favour of their neighbour.
+class VolSurface
+{
+public:
+    VolSurface();
+
+    /// Adds the option of a chain slot with its expiry in epoch nanoseconds and its strike
+    void add( size_t, int64_t, double );
+    /// Sets the implied volatility of a chain slot, NaN when it has none
+    void update( size_t, double );
+    /// Volatility at a strike and an expiry in epoch nanoseconds, seen at the given
+    /// epoch nanoseconds. NaN when the surface has no volatility near that point
+    double vol( double, int64_t, int64_t ) const;
+
+    /// Expiries of the grid in epoch nanoseconds, ascending
+    std::vector<int64_t> expiries() const;
+    /// Strikes of one expiry, ascending
+    const std::vector<double>& strikes( size_t ) const;
+    /// Volatility of one grid cell
+    double at( size_t, size_t ) const;
+
+private:
+    /// The strikes of one expiry
+    struct Smile
+    {
+        int64_t             expiry;
+        std::vector<double> strikes;
+        std::vector<double> vols;
+        /// Index of the last strike at or below each step of the bucket table
+        std::vector<uint32_t> buckets;
+        double                low;
+        double                step;
+    };
+    /// Rebuilds the grid and bucket tables after the chain changed
+    void index();
+    /// Index of the last strike at or below the given one, the first strike below the range
+    size_t lower( const Smile&, double ) const;
+    /// Volatility of one expiry at a strike
+    double smileVol( const Smile&, double ) const;
+
+    std::vector<Smile> smiles;
+    /// Expiry, strike and volatility of every slot, and the cell it landed in
+    std::vector<std::pair<int64_t, double>>    options;
+    std::vector<double>                        values;
+    std::vector<std::pair<uint32_t, uint32_t>> cells;
+    /// Index of the last expiry at or before each day after the first expiry
+    std::vector<uint32_t> days;
+};
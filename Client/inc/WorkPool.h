@@ -0,0 +1,36 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// @brief Runs a batch of independent tasks across a fixed set of threads
+///
+/// Tasks are dealt round robin into one queue per worker. A worker takes its
+/// own tasks from the back of its queue and, once that is empty, steals from
+/// the front of the other queues, so a few long tasks do not leave the other
+/// cores idle at the end of a batch.
+class WorkPool
+{
+public:
+    /// Zero threads uses every hardware thread
+    explicit WorkPool( unsigned threads = 0 );
+
+    /// Calls the task function with every task index in [0, tasks) and the
+    /// index of the worker running it. Blocks until all tasks are done
+    void run( size_t tasks, const std::function<void( size_t, unsigned )>& );
+    unsigned size() const;
+
+private:
+    struct WorkQueue
+    {
+        std::mutex         lock;
+        std::deque<size_t> tasks;
+    };
+    /// Next task of a worker, its own first. False when every queue is empty
+    bool next( unsigned, size_t& );
+
+    unsigned                                threads;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+};
@@ -5,10 +5,13 @@
 #include "StdAfx.h"
 
 #include "Account.h"
+#include "Backfill.h"
 #include "Broker.h"
 #include "ClientBrain.h"
 #include "ClientData.h"
 #include "HalvedPositionSMA.h"
+#include "Metrics.h"
+#include "OutboundScheduler.h"
 #include <chrono>
 #include <csignal>
 #include <cstdlib>
@@ -24,80 +27,14 @@ constexpr unsigned MAX_ATTEMPTS = 10;
 constexpr unsigned SLEEP_TIME = 3;
 
 bool inter = false;
+/// Number of TWS connections the historical harvest is spread across
+int backfillConnections = 1;
+/// Seconds of historical ticks to backfill instead of harvesting bars, 0 for a bar harvest
+int64_t tickSeconds = 0;
+/// Tick type of the tick backfill, TRADES, BID_ASK or MIDPOINT
+string tickType = "TRADES";
 void sigint( int sigint ) { inter = true; }
 
-array<string, 120> StateArray = {
-    // TradeManager Contribution
-    "CONNECT",             // attempting a new connection
-    "CONNECTSUCCESS",      // used just after a successful connection
-    "CONNECTFAIL",         // a connection attempt has just failed
-    "INIT",                // A new connection has just been established and the trading bot
-                           // needs to be initialized
-    "INITSUCCESS",         // Trading bot is fully and successfully initialized and
-                           // ready to trade
-    "INITFAIL",            // Something went wrong in the initialization function; leads to
-                           // immediate disconnect and termination of the program
-    "ACTIVETRADING",       // The trading bot is actively processing data and placing
-                           // trades
-    "PASSIVETRADING",      // The trading bot is actively processing data but not
-                           // placing orders
-    "ACCOUNTID",           // Waiting to get account ID string. Required to initialize
-                           // account
-    "ACCOUNTIDSUCCESS",    // Successfully received account ID string from TWS
-    "ACCOUNTINIT",         // ClientAccount is being initialized by TWS
-    "ACCOUNTINITSUCCESS",  // ClientAccount has just been fully and successfully
-                           // initialized
-    "ACCOUNTCLOSE",        // ClientAccount is closing its subscriptions
-    "ACCOUNTCLOSESUCCESS", // ClientAccount has successfully closed its account
-                           // subscriptions
-    "ACCOUNTCLOSEFAIL",    // An error occurred when trying to close account
-                           // subscriptions
-    "DATAINIT", "DATAINITSUCCESS", "DATAHARVEST", "DATAHARVEST_TIMEOUT_0",
-    "DATAHARVEST_TIMEOUT_1", "DATAHARVEST_TIMEOUT_2", "DATAHARVEST_DONE",
-    // IB API
-    "TICKDATAOPERATION", "TICKDATAOPERATION_ACK",
-    "TICKOPTIONCOMPUTATIONOPERATION", "TICKOPTIONCOMPUTATIONOPERATION_ACK",
-    "DELAYEDTICKDATAOPERATION", "DELAYEDTICKDATAOPERATION_ACK",
-    "MARKETDEPTHOPERATION", "MARKETDEPTHOPERATION_ACK", "REALTIMEBARS",
-    "REALTIMEBARS_ACK", "MARKETDATATYPE", "MARKETDATATYPE_ACK",
-    "HISTORICALDATAREQUESTS", "HISTORICALDATAREQUESTS_ACK", "OPTIONSOPERATIONS",
-    "OPTIONSOPERATIONS_ACK", "CONTRACTOPERATION", "CONTRACTOPERATION_ACK",
-    "MARKETSCANNERS", "MARKETSCANNERS_ACK", "FUNDAMENTALS", "FUNDAMENTALS_ACK",
-    "BULLETINS", "BULLETINS_ACK", "ACCOUNTOPERATIONS", "ACCOUNTOPERATIONS_ACK",
-    "ORDEROPERATIONS", "ORDEROPERATIONS_ACK", "OCASAMPLES", "OCASAMPLES_ACK",
-    "CONDITIONSAMPLES", "CONDITIONSAMPLES_ACK", "BRACKETSAMPLES",
-    "BRACKETSAMPLES_ACK", "HEDGESAMPLES", "HEDGESAMPLES_ACK", "TESTALGOSAMPLES",
-    "TESTALGOSAMPLES_ACK", "FAORDERSAMPLES", "FAORDERSAMPLES_ACK",
-    "FAOPERATIONS", "FAOPERATIONS_ACK", "DISPLAYGROUPS", "DISPLAYGROUPS_ACK",
-    "MISCELANEOUS", "MISCELANEOUS_ACK", "CANCELORDER", "CANCELORDER_ACK",
-    "FAMILYCODES", "FAMILYCODES_ACK", "SYMBOLSAMPLES", "SYMBOLSAMPLES_ACK",
-    "REQMKTDEPTHEXCHANGES", "REQMKTDEPTHEXCHANGES_ACK", "REQNEWSTICKS",
-    "REQNEWSTICKS_ACK", "REQSMARTCOMPONENTS", "REQSMARTCOMPONENTS_ACK",
-    "NEWSPROVIDERS", "NEWSPROVIDERS_ACK", "REQNEWSARTICLE",
-    "REQNEWSARTICLE_ACK", "REQHISTORICALNEWS", "REQHISTORICALNEWS_ACK",
-    "REQHEADTIMESTAMP", "REQHEADTIMESTAMP_ACK", "REQHISTOGRAMDATA",
-    "REQHISTOGRAMDATA_ACK", "REROUTECFD", "REROUTECFD_ACK", "MARKETRULE",
-    "MARKETRULE_ACK", "PNL", "PNL_ACK", "PNLSINGLE", "PNLSINGLE_ACK", "CONTFUT",
-    "CONTFUT_ACK", "PING", "PING_ACK", "REQHISTORICALTICKS",
-    "REQHISTORICALTICKS_ACK", "REQTICKBYTICKDATA", "REQTICKBYTICKDATA_ACK",
-    "WHATIFSAMPLES", "WHATIFSAMPLES_ACK", "IDLE",
-    // TradeManager contribution
-    "INT" };
-
-namespace ClientSpace
-{
-    map<int, string> StateMap;
-    void             initStateMap()
-    {
-        int indexer = 0;
-        for( auto& ind : StateArray )
-        {
-            StateMap[indexer] = ind;
-            indexer++;
-        }
-    }
-} // namespace ClientSpace
-
 using namespace ClientSpace;
 
 void ClientBrain::processMessages()
@@ -106,6 +43,7 @@ void ClientBrain::processMessages()
     {
         *p_State = INT;
     }
+    beginPass();
     switch( *p_State )
     {
         case CONNECT:
@@ -122,7 +60,16 @@ void ClientBrain::processMessages()
 
         case INIT:
             Data->init();
-            *p_State = DATAHARVEST;
+            *p_State = DATAINIT;
+            break;
+
+        case DATAINIT:
+            // waiting on the contract universe to be resolved
+            Data->checkLookups();
+            if( Data->valid )
+            {
+                *p_State = DATAHARVEST;
+            }
             break;
 
         case INITSUCCESS:
@@ -130,6 +77,22 @@ void ClientBrain::processMessages()
             break;
 
         case DATAHARVEST:
+            if( tickSeconds > 0 )
+            {
+                Data->harvestTicks( tickSeconds, tickType );
+                *p_State = REQHISTORICALTICKS;
+                break;
+            }
+            if( backfillConnections > 1 )
+            {
+                // fan the whole plan out over several client IDs, then go live
+                auto backfill = BackfillCoordinator( "", SOCKETID, CLIENTID + 1,
+                                                     backfillConnections );
+                backfill.run( Data->harvestPlan() );
+                backfill.merge( *Data );
+                Data->startHarvestLive();
+                break;
+            }
             Data->harvest( 0 );
             Data->harvest( 1 );
             break;
@@ -191,6 +154,8 @@ void ClientBrain::processMessages()
             if( Data->openHistRequests.empty() )
             {
                 Data->printCSVs();
+                Data->writeStore( HISTORY_ROOT );
+                Data->saveHarvest();
                 disconnect();
                 exit( DATAHARVEST_DONE );
             }
@@ -209,6 +174,16 @@ void ClientBrain::processMessages()
         case DATAHARVEST_LIVE:
             break;
 
+        case REQHISTORICALTICKS:
+            if( !Data->pageTicks() )
+            {
+                spdlog::info( "Tick backfill has completed." );
+                Data->writeTickBackfill();
+                disconnect();
+                exit( DATAHARVEST_DONE );
+            }
+            break;
+
         case ACCOUNTCLOSE:
             // Account has ended is subscriptions and is waiting for callback
             *p_State = IDLE;
@@ -227,24 +202,46 @@ void ClientBrain::processMessages()
 
         case INT:
             spdlog::critical( "Stopping harvest and printing data to csv..." );
+            spdlog::info( "Time spent in each state:\n" + stateTimer.summary() );
             Data->printCSVs();
+            Data->writeStore( HISTORY_ROOT );
+            Data->writeTickBackfill();
+            Data->saveHarvest();
             disconnect();
             exit( INT );
     }
-    spdlog::info( "Current state is " + StateMap[*p_State] );
-    std::this_thread::sleep_for( std::chrono::milliseconds( MAINLOOPDELAY ) );
-    m_osSignal.waitForSignal();
+    spdlog::info( string( "Current state is " ) + stateName( *p_State ) );
+    idle( MAINLOOPDELAY );
+    // requests still queued are sent by the next pass, it must not block on the socket
+    if( p_Outbound->waiting() == 0 )
+    {
+        m_osSignal.waitForSignal();
+    }
     // global error status
     errno = 0;
     p_Reader->processMsgs();
 }
 
+/// Usage: DataHarvester [connections] | DataHarvester ticks <hours> [TRADES | BID_ASK | MIDPOINT]
 int main( int argc, char** argv )
 {
     signal( SIGINT, sigint );
-    ClientSpace::initStateMap();
+    if( argc > 2 && string( argv[1] ) == "ticks" )
+    {
+        tickSeconds = (int64_t)( atof( argv[2] ) * 3600 );
+        if( argc > 3 )
+        {
+            tickType = argv[3];
+        }
+    }
+    else if( argc > 1 )
+    {
+        backfillConnections = max( 1, atoi( argv[1] ) );
+    }
     unsigned    attempt = 0;
     ClientBrain client = ClientBrain();
+    MetricsServer metricsServer( Metrics::global() );
+    metricsServer.start( METRICS_PORT + 1 );
     for( ;; )
     {
         ++attempt;
@@ -14,14 +14,20 @@
 #include "DataStruct.h"
 #include "DataTypes.h"
 #include "Execution.h"
+#include "FlightRecorder.h"
 #include "HalvedPositionSMA.h"
+#include "Journal.h"
+#include "Metrics.h"
+#include "OutboundScheduler.h"
 #include "Order.h"
+#include "ReplayDriver.h"
 #include "SMA.h"
 #include <chrono>
 #include <csignal>
 #include <cstdlib>
 #include <iostream>
 #include <spdlog/spdlog.h>
+#include <sys/stat.h>
 #include <thread>
 
 using namespace std;
@@ -30,93 +36,31 @@ constexpr int      SOCKETID = 7497;
 constexpr int      CLIENTID = 112;
 constexpr unsigned MAX_ATTEMPTS = 10;
 constexpr unsigned SLEEP_TIME = 3;
+/// Interval of the harvested bars used to warm up the indicators on start
+constexpr const char* WARM_START_INTERVAL = "1min";
+/// Cash the account starts a replay with
+constexpr double REPLAY_CASH = 100000;
+
+/// Journal to record the session to, empty when not recording
+string journalPath;
 
 bool inter = false;
-void sigint( int sigint ) { inter = true; }
-
-array<string, 120> StateArray = {
-    // TradeManager Contribution
-    "CONNECT",             // attempting a new connection
-    "CONNECTSUCCESS",      // used just after a successful connection
-    "CONNECTFAIL",         // a connection attempt has just failed
-    "DISCONNECTED",        // disconnected after initialization
-    "INIT",                // A new connection has just been established and the trading bot
-                           // needs to be initialized
-    "INITSUCCESS",         // Trading bot is fully and successfully initialized and
-                           // ready to trade
-    "INITFAIL",            // Something went wrong in the initialization function; leads to
-                           // immediate disconnect and termination of the program
-    "ACTIVETRADING",       // The trading bot is actively processing data and placing
-                           // trades
-    "PASSIVETRADING",      // The trading bot is actively processing data but not
-                           // placing orders
-    "ACCOUNTID",           // Waiting to get account ID string. Required to initialize
-                           // account
-    "ACCOUNTIDSUCCESS",    // Successfully received account ID string from TWS
-    "ACCOUNTINIT",         // ClientAccount is being initialized by TWS
-    "ACCOUNTINITSUCCESS",  // ClientAccount has just been fully and successfully
-                           // initialized
-    "ACCOUNTCLOSE",        // ClientAccount is closing its subscriptions
-    "ACCOUNTCLOSESUCCESS", // ClientAccount has successfully closed its account
-                           // subscriptions
-    "ACCOUNTCLOSEFAIL",    // An error occurred when trying to close account
-                           // subscriptions
-    "DATAINIT", "DATAINITSUCCESS", "DATAHARVEST", "DATAHARVEST_TIMEOUT_0",
-    "DATAHARVEST_TIMEOUT_1", "DATAHARVEST_TIMEOUT_2", "DATAHARVEST_LIVE",
-    "DATAHARVEST_DONE", "DATA_NEXT", "TRADING", "ORDERING",
-    // IB API
-    "TICKDATAOPERATION", "TICKDATAOPERATION_ACK",
-    "TICKOPTIONCOMPUTATIONOPERATION", "TICKOPTIONCOMPUTATIONOPERATION_ACK",
-    "DELAYEDTICKDATAOPERATION", "DELAYEDTICKDATAOPERATION_ACK",
-    "MARKETDEPTHOPERATION", "MARKETDEPTHOPERATION_ACK", "REALTIMEBARS",
-    "REALTIMEBARS_ACK", "MARKETDATATYPE", "MARKETDATATYPE_ACK",
-    "HISTORICALDATAREQUESTS", "HISTORICALDATAREQUESTS_ACK", "OPTIONSOPERATIONS",
-    "OPTIONSOPERATIONS_ACK", "CONTRACTOPERATION", "CONTRACTOPERATION_ACK",
-    "MARKETSCANNERS", "MARKETSCANNERS_ACK", "FUNDAMENTALS", "FUNDAMENTALS_ACK",
-    "BULLETINS", "BULLETINS_ACK", "ACCOUNTOPERATIONS", "ACCOUNTOPERATIONS_ACK",
-    "ORDEROPERATIONS", "ORDEROPERATIONS_ACK", "OCASAMPLES", "OCASAMPLES_ACK",
-    "CONDITIONSAMPLES", "CONDITIONSAMPLES_ACK", "BRACKETSAMPLES",
-    "BRACKETSAMPLES_ACK", "HEDGESAMPLES", "HEDGESAMPLES_ACK", "TESTALGOSAMPLES",
-    "TESTALGOSAMPLES_ACK", "FAORDERSAMPLES", "FAORDERSAMPLES_ACK",
-    "FAOPERATIONS", "FAOPERATIONS_ACK", "DISPLAYGROUPS", "DISPLAYGROUPS_ACK",
-    "MISCELANEOUS", "MISCELANEOUS_ACK", "CANCELORDER", "CANCELORDER_ACK",
-    "FAMILYCODES", "FAMILYCODES_ACK", "SYMBOLSAMPLES", "SYMBOLSAMPLES_ACK",
-    "REQMKTDEPTHEXCHANGES", "REQMKTDEPTHEXCHANGES_ACK", "REQNEWSTICKS",
-    "REQNEWSTICKS_ACK", "REQSMARTCOMPONENTS", "REQSMARTCOMPONENTS_ACK",
-    "NEWSPROVIDERS", "NEWSPROVIDERS_ACK", "REQNEWSARTICLE",
-    "REQNEWSARTICLE_ACK", "REQHISTORICALNEWS", "REQHISTORICALNEWS_ACK",
-    "REQHEADTIMESTAMP", "REQHEADTIMESTAMP_ACK", "REQHISTOGRAMDATA",
-    "REQHISTOGRAMDATA_ACK", "REROUTECFD", "REROUTECFD_ACK", "MARKETRULE",
-    "MARKETRULE_ACK", "PNL", "PNL_ACK", "PNLSINGLE", "PNLSINGLE_ACK", "CONTFUT",
-    "CONTFUT_ACK", "PING", "PING_ACK", "REQHISTORICALTICKS",
-    "REQHISTORICALTICKS_ACK", "REQTICKBYTICKDATA", "REQTICKBYTICKDATA_ACK",
-    "WHATIFSAMPLES", "WHATIFSAMPLES_ACK", "IDLE",
-    // TradeManager contribution
-    "INT" };
-
-namespace ClientSpace
+void sigint( int sigint )
 {
-    map<int, string> StateMap;
-    void             initStateMap()
-    {
-        int indexer = 0;
-        for( auto& ind : StateArray )
-        {
-            StateMap[indexer] = ind;
-            indexer++;
-        }
-    }
-} // namespace ClientSpace
+    FlightRecorder::dump();
+    inter = true;
+}
 
 using namespace ClientSpace;
 vector<pair<Contract, Order>> trades;
 
-void ClientBrain::processMessages()
+void ClientBrain::processState()
 {
     if( inter )
     {
         *p_State = INT;
     }
+    beginPass();
     switch( *p_State )
     {
         case DISCONNECTED:
@@ -130,8 +74,10 @@ void ClientBrain::processMessages()
 
         case INIT:
             // waiting on callbacks from Account, Data class
+            Data->checkLookups();
             if( Account->valid && Data->valid )
             {
+                Data->loadHistory( HISTORY_ROOT, WARM_START_INTERVAL );
                 cout << "Bot successfully initialized with account info: " << endl;
                 for( auto* const pos : Account->positions )
                 {
@@ -139,6 +85,15 @@ void ClientBrain::processMessages()
                          << "," << pos->getAvgPrice() << "," << pos->getPositionSize()
                          << endl;
                 }
+                if( !journalPath.empty() )
+                {
+                    auto newJournal = make_shared<Journal>();
+                    if( newJournal->open( journalPath ) )
+                    {
+                        spdlog::info( "Recording the session to " + journalPath );
+                        record( newJournal );
+                    }
+                }
                 *p_State = INITSUCCESS;
             }
             break;
@@ -155,6 +110,8 @@ void ClientBrain::processMessages()
             Strategy->ProcessNextTick( static_pointer_cast<BTAccount>( Account ),
                                        static_pointer_cast<BTBroker>( Broker ), Data,
                                        trades );
+            // nothing to order, wait for the next update
+            *p_State = DATA_NEXT;
             for( const auto& trade : trades )
             {
                 spdlog::info( "Setting up a trade for symbol " + trade.first.symbol +
@@ -175,7 +132,7 @@ void ClientBrain::processMessages()
             break;
 
         case DATA_NEXT:
-            if( Data->updated() )
+            if( scheduler.due( *Data ) )
             {
                 *p_State = TRADING;
             }
@@ -187,12 +144,29 @@ void ClientBrain::processMessages()
 
         case INT:
             spdlog::critical( "Process interrupted. Exiting..." );
+            spdlog::info( "Time spent in each state:\n" + stateTimer.summary() );
+            Data->writeTicks();
+            Data->closeRealTimeBars();
+            p_Outbound->pump();
+            if( journal )
+            {
+                journal->close();
+            }
             disconnect();
             exit( INT );
     }
-    spdlog::info( "Current state is " + StateMap[*p_State] );
-    std::this_thread::sleep_for( std::chrono::milliseconds( MAINLOOPDELAY ) );
-    m_osSignal.waitForSignal();
+}
+
+void ClientBrain::processMessages()
+{
+    processState();
+    spdlog::info( string( "Current state is " ) + stateName( *p_State ) );
+    idle( MAINLOOPDELAY );
+    // requests still queued are sent by the next pass, it must not block on the socket
+    if( p_Outbound->waiting() == 0 )
+    {
+        m_osSignal.waitForSignal();
+    }
     // global error status
     errno = 0;
     p_Reader->processMsgs();
@@ -202,10 +176,54 @@ void ClientBrain::processMessages()
 constexpr int fast = 50;
 constexpr int slow = 250;
 
+/// Replays a journal, or the bars of a history store directory, through the strategy
+int replay( ClientBrain& client, const string& source, const string& interval )
+{
+    struct stat info
+    {
+    };
+    ReplayDriver driver( client );
+    bool loaded = stat( source.c_str(), &info ) == 0 && S_ISDIR( info.st_mode )
+                      ? driver.loadHistory( source, interval )
+                      : driver.loadJournal( source );
+    if( !loaded )
+    {
+        spdlog::critical( "Nothing to replay from " + source );
+        return 1;
+    }
+    driver.setCash( REPLAY_CASH );
+    driver.run( [&client]() { client.processState(); } );
+    return 0;
+}
+
+/// Prints the events of a flight recorder dump, oldest first
+int flight( const string& path )
+{
+    auto records = vector<FlightRecord>();
+    if( !FlightRecorder::load( path, records ) )
+    {
+        spdlog::critical( "Could not read the flight records in " + path );
+        return 1;
+    }
+    for( const auto& record : records )
+    {
+        cout << FlightRecorder::describe( record ) << "\n";
+    }
+    return 0;
+}
+
+/// Usage: Trader [record <journal> | replay <journal | history root> [interval]] [--eval <mode>]
+///        Trader flight [dump]
+///
+/// The evaluation mode is one of tick, bar:<seconds>, timer:<ms> or coalesce:<ms>
 int main( int argc, char** argv )
 {
+    if( argc > 1 && string( argv[1] ) == "flight" )
+    {
+        return flight( argc > 2 ? argv[2] : FLIGHT_PATH );
+    }
+    FlightRecorder::install( FLIGHT_PATH );
     signal( SIGINT, sigint );
-    ClientSpace::initStateMap();
     unsigned attempt = 0;
     trades = vector<pair<Contract, Order>>();
     auto indicators = vector<BTIndicator*>();
@@ -215,7 +233,30 @@ int main( int argc, char** argv )
     indicators.push_back( SMAS.get() );
     auto Strategy = make_shared<HPSMA>();
     auto Data = make_shared<ClientData>( indicators );
+    Data->streamDepth( MAXIMUM_DEPTH_BOOKS );
     auto client = ClientBrain( Data, Strategy );
+    if( argc > 2 && string( argv[argc - 2] ) == "--eval" )
+    {
+        auto scheduler = EvalScheduler();
+        if( !EvalScheduler::parse( argv[argc - 1], scheduler ) )
+        {
+            spdlog::critical( "Unknown evaluation mode " + string( argv[argc - 1] ) +
+                              ", expected tick, bar:<seconds>, timer:<ms> or coalesce:<ms>" );
+            return 1;
+        }
+        client.evaluate( scheduler );
+        argc -= 2;
+    }
+    if( argc > 2 && string( argv[1] ) == "replay" )
+    {
+        return replay( client, argv[2], argc > 3 ? argv[3] : WARM_START_INTERVAL );
+    }
+    if( argc > 2 && string( argv[1] ) == "record" )
+    {
+        journalPath = argv[2];
+    }
+    MetricsServer metricsServer( Metrics::global() );
+    metricsServer.start( METRICS_PORT );
     for( ;; )
     {
         ++attempt;
@@ -232,6 +273,7 @@ int main( int argc, char** argv )
         if( inter )
         {
             spdlog::critical( "Process interrupted. Exiting..." );
+            spdlog::info( "Time spent in each state:\n" + client.stateTimes().summary() );
             exit( ClientSpace::INT );
         }
         std::this_thread::sleep_for( std::chrono::seconds( SLEEP_TIME ) );
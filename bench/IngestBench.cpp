@@ -0,0 +1,265 @@
+#include "ClientBrain.h"
+#include "ClientData.h"
+#include "DataStruct.h"
+#include "HalvedPositionSMA.h"
+#include "SMA.h"
+#include "bar.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// Ticks fed to every benchmark
+constexpr size_t BENCH_TICKS = 1000000;
+/// Symbol counts run when none are given on the command line
+constexpr size_t DEFAULT_SYMBOLS[] = { 10, 100, 1000 };
+/// First vector id of the synthetic lines
+constexpr long FIRST_LINE = 1000;
+/// SMA lengths of the Trader
+constexpr int FAST_SMA = 50;
+constexpr int SLOW_SMA = 250;
+
+bool inter = false;
+
+/// Every allocation made by the process, the client library included
+atomic<size_t> allocations( 0 );
+
+void* operator new( size_t size )
+{
+    allocations.fetch_add( 1, memory_order_relaxed );
+    if( void* p = malloc( size == 0 ? 1 : size ) )
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete( void* p ) noexcept { free( p ); }
+
+void operator delete( void* p, size_t ) noexcept { free( p ); }
+
+/// One synthetic tick, the field is the IB tick type
+struct Tick
+{
+    long   id;
+    int    field;
+    double value;
+};
+
+/// Holds the indicators and lines a benchmark needs, rebuilt for every run
+struct Fixture
+{
+    explicit Fixture( size_t symbols, const string& secType )
+    {
+        fast = make_unique<SMA>( FAST_SMA );
+        slow = make_unique<SMA>( SLOW_SMA );
+        indicators = vector<BTIndicator*> { fast.get(), slow.get() };
+        Data = make_shared<ClientData>( indicators );
+        for( size_t i = 0; i < symbols; i++ )
+        {
+            auto con = Contract();
+            con.conId = (long)( 100000 + i );
+            con.symbol = "SYM" + to_string( i );
+            con.secType = secType;
+            con.exchange = "SMART";
+            con.currency = "USD";
+            if( secType == "OPT" )
+            {
+                con.lastTradeDateOrContractMonth = "20301220";
+                con.strike = 100;
+                con.right = "C";
+            }
+            Data->openLine( con, FIRST_LINE + (long)i );
+        }
+        snaps = vector<SnapStruct>( symbols );
+        options = vector<OptionStruct>( symbols );
+    }
+    unique_ptr<SMA>        fast;
+    unique_ptr<SMA>        slow;
+    vector<BTIndicator*>   indicators;
+    shared_ptr<ClientData> Data;
+    vector<SnapStruct>     snaps;
+    vector<OptionStruct>   options;
+};
+
+/// Quote and trade ticks in the order TWS sends them, a price followed by its size
+vector<Tick> ticks( size_t symbols )
+{
+    mt19937_64 rng( symbols );
+    auto       out = vector<Tick>();
+    auto       price = vector<double>( symbols, 100.0 );
+    out.reserve( BENCH_TICKS );
+    while( out.size() < BENCH_TICKS )
+    {
+        auto i = rng() % symbols;
+        auto id = FIRST_LINE + (long)i;
+        // bid, ask or last, each followed by the matching size
+        static const int priceFields[] = { 1, 2, 4 };
+        static const int sizeFields[] = { 0, 3, 5 };
+        auto side = rng() % 3;
+        price[i] += ( (double)( rng() % 3 ) - 1 ) * 0.01;
+        out.push_back( Tick { id, priceFields[side], price[i] } );
+        out.push_back( Tick { id, sizeFields[side], (double)( 1 + rng() % 50 ) } );
+    }
+    return out;
+}
+
+/// IB formatted bar times, one second apart
+vector<Bar> bars( size_t symbols )
+{
+    mt19937_64 rng( symbols );
+    auto       out = vector<Bar>( BENCH_TICKS );
+    time_t     start = 1600000000;
+    for( size_t n = 0; n < out.size(); n++ )
+    {
+        char   buf[32];
+        time_t t = start + (time_t)( n / symbols );
+        strftime( buf, sizeof( buf ), "%Y%m%d %H:%M:%S", gmtime( &t ) );
+        double open = 100 + (double)( rng() % 100 ) * 0.01;
+        out[n] = Bar { buf, open + 0.05, open - 0.05, open, open + 0.01, open, (long long)( rng() % 1000 ), 1 };
+    }
+    return out;
+}
+
+void report( const char* name, size_t symbols, size_t count, double seconds, size_t allocs )
+{
+    printf( "%-32s %6zu symbols %10.1f ns/tick %8.2f allocs/tick\n", name, symbols,
+            seconds * 1e9 / (double)count, (double)allocs / (double)count );
+}
+
+/// Times a loop over every tick and counts the allocations it makes
+template <typename Body>
+void measure( const char* name, size_t symbols, size_t count, Body body )
+{
+    auto before = allocations.load();
+    auto start = chrono::steady_clock::now();
+    body();
+    auto seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    report( name, symbols, count, seconds, allocations.load() - before );
+}
+
+void benchSymbols( size_t symbols )
+{
+    auto stream = ticks( symbols );
+    {
+        // the full callback path, through the EWrapper interface the EReader uses
+        auto     fixture = Fixture( symbols, "STK" );
+        auto     strategy = make_shared<HPSMA>();
+        auto     brain = ClientBrain( fixture.Data, strategy );
+        EWrapper& wrapper = brain;
+        measure( "ClientBrain tickPrice/tickSize", symbols, stream.size(), [&]() {
+            for( const auto& tick : stream )
+            {
+                if( tick.field == 1 || tick.field == 2 || tick.field == 4 )
+                {
+                    wrapper.tickPrice( tick.id, (TickType)tick.field, tick.value, TickAttrib() );
+                }
+                else
+                {
+                    wrapper.tickSize( tick.id, (TickType)tick.field, (int)tick.value );
+                }
+            }
+        } );
+    }
+    {
+        auto fixture = Fixture( symbols, "STK" );
+        measure( "ClientData updatePrice/updateSize", symbols, stream.size(), [&]() {
+            for( const auto& tick : stream )
+            {
+                auto& snap = fixture.snaps[tick.id - FIRST_LINE];
+                if( tick.field == 1 || tick.field == 2 || tick.field == 4 )
+                {
+                    fixture.Data->updatePrice( tick.id, snap, tick.value, tick.field );
+                }
+                else
+                {
+                    fixture.Data->updateSize( tick.id, snap, (int)tick.value, tick.field );
+                }
+            }
+        } );
+    }
+    {
+        // every size completes its snapshot, so each call is one addPoint and updateTimeLine
+        auto fixture = Fixture( symbols, "STK" );
+        for( auto& snap : fixture.snaps )
+        {
+            snap.bidPrice = 100;
+            snap.askPrice = 100.01;
+        }
+        measure( "addPoint + updateTimeLine", symbols, stream.size() / 2, [&]() {
+            for( const auto& tick : stream )
+            {
+                if( tick.field == 0 || tick.field == 3 || tick.field == 5 )
+                {
+                    auto& snap = fixture.snaps[tick.id - FIRST_LINE];
+                    snap.bidSize = (int)tick.value;
+                    snap.askSize = (int)tick.value;
+                    fixture.Data->updateSize( tick.id, snap, (int)tick.value, tick.field );
+                }
+            }
+        } );
+    }
+    {
+        // the TWS computations, which the local chain pricer replaces by default
+        auto fixture = Fixture( symbols, "OPT" );
+        fixture.Data->priceOptions( false );
+        measure( "ClientData updateOptionGreeks", symbols, stream.size(), [&]() {
+            for( const auto& tick : stream )
+            {
+                auto& option = fixture.options[tick.id - FIRST_LINE];
+                // bid, ask and last computations in turn
+                int field = 10 + tick.field % 3;
+                fixture.Data->updateOptionGreeks( tick.id, option, 0.25, 0.5, tick.value, 0, 0.05,
+                                                  0.1, -0.02, field );
+            }
+        } );
+    }
+    {
+        auto candles = bars( symbols );
+        auto fixture = Fixture( symbols, "STK" );
+        // historical vectors also keep their bars for the history store
+        for( size_t i = 0; i < symbols; i++ )
+        {
+            auto con = Contract();
+            con.conId = (long)( 100000 + i );
+            fixture.Data->newHistVector( con, FIRST_LINE + (long)( symbols + i ), "1 secs" );
+        }
+        measure( "ClientData updateCandle", symbols, candles.size(), [&]() {
+            for( size_t n = 0; n < candles.size(); n++ )
+            {
+                fixture.Data->updateCandle( FIRST_LINE + (long)( symbols + n % symbols ), candles[n] );
+            }
+        } );
+    }
+}
+
+/// Baseline of the ClientData ingest path: ns and allocations per tick for
+/// every stage, with 10, 100 and 1000 symbols unless other counts are given
+int main( int argc, char* argv[] )
+{
+    spdlog::set_level( spdlog::level::warn );
+    auto counts = vector<size_t>();
+    for( int i = 1; i < argc; i++ )
+    {
+        counts.push_back( strtoul( argv[i], nullptr, 10 ) );
+    }
+    if( counts.empty() )
+    {
+        counts.assign( begin( DEFAULT_SYMBOLS ), end( DEFAULT_SYMBOLS ) );
+    }
+    for( auto symbols : counts )
+    {
+        if( symbols > 0 )
+        {
+            benchSymbols( symbols );
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include "HistoryStore.h"
+#include "SeriesCodec.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/// Rows of each synthetic stream
+constexpr size_t SYNTHETIC_ROWS = 2000000;
+/// Each decode is repeated until it has run at least this long
+constexpr double MIN_BENCH_SECONDS = 0.5;
+/// Seconds in a regular trading session, the synthetic streams skip the rest of the day
+constexpr int64_t SESSION_SECONDS = 23400;
+constexpr int64_t NANOS = 1000000000;
+
+struct Series
+{
+    string                  name;
+    SeriesKind              kind;
+    vector<vector<int64_t>> columns;
+    size_t                  rows() const { return columns[0].size(); }
+};
+
+int64_t asWord( double value )
+{
+    int64_t word;
+    memcpy( &word, &value, sizeof( word ) );
+    return word;
+}
+
+/// One second candles of a random walk in whole cents, like a 1 sec harvest of CandleStructs
+Series candles()
+{
+    mt19937_64 rng( 1 );
+    auto       s = Series { "synthetic 1sec candles", SeriesKind::Bars, vector<vector<int64_t>>( 6 ) };
+    int64_t    cents = 15000;
+    int64_t    t = 1600000000 + 9 * 3600 + 1800;
+    for( size_t i = 0; i < SYNTHETIC_ROWS; i++ )
+    {
+        if( i % SESSION_SECONDS == 0 && i > 0 )
+        {
+            t += 24 * 3600 - SESSION_SECONDS;
+        }
+        auto open = cents;
+        auto high = open + (int64_t)( rng() % 4 );
+        auto low = open - (int64_t)( rng() % 4 );
+        cents = low + (int64_t)( rng() % ( high - low + 1 ) );
+        s.columns[0].push_back( t++ * NANOS );
+        s.columns[1].push_back( asWord( open / 100.0 ) );
+        s.columns[2].push_back( asWord( high / 100.0 ) );
+        s.columns[3].push_back( asWord( low / 100.0 ) );
+        s.columns[4].push_back( asWord( cents / 100.0 ) );
+        s.columns[5].push_back( rng() % 3 == 0 ? 0 : (int64_t)( rng() % 40 ) );
+    }
+    return s;
+}
+
+/// Irregular quote updates with millisecond times, like the SnapStructs of a live stream
+Series snaps()
+{
+    mt19937_64                  rng( 2 );
+    exponential_distribution<>  gap( 1.0 / 250 );
+    auto                        s = Series { "synthetic snaps", SeriesKind::Snaps, vector<vector<int64_t>>( 5 ) };
+    int64_t                     bid = 15000;
+    int64_t                     bidSize = 5;
+    int64_t                     askSize = 5;
+    int64_t                     t = ( 1600000000LL + 9 * 3600 + 1800 ) * 1000;
+    for( size_t i = 0; i < SYNTHETIC_ROWS; i++ )
+    {
+        t += 1 + (int64_t)gap( rng );
+        // most updates only change one side's size
+        switch( rng() % 4 )
+        {
+            case 0:
+                bid += (int64_t)( rng() % 3 ) - 1;
+                break;
+            case 1:
+                bidSize = 1 + (int64_t)( rng() % 20 );
+                break;
+            default:
+                askSize = 1 + (int64_t)( rng() % 20 );
+                break;
+        }
+        s.columns[0].push_back( t * 1000000 );
+        s.columns[1].push_back( asWord( bid / 100.0 ) );
+        s.columns[2].push_back( asWord( ( bid + 1 ) / 100.0 ) );
+        s.columns[3].push_back( bidSize );
+        s.columns[4].push_back( askSize );
+    }
+    return s;
+}
+
+/// Every series of a harvested history store
+vector<Series> harvested( const string& root )
+{
+    auto found = vector<Series>();
+    auto store = HistoryStore( root );
+    DIR* dir = opendir( root.c_str() );
+    if( dir == nullptr )
+    {
+        fprintf( stderr, "Could not open history store %s\n", root.c_str() );
+        return found;
+    }
+    while( auto* entry = readdir( dir ) )
+    {
+        long conId = strtol( entry->d_name, nullptr, 10 );
+        if( conId == 0 )
+        {
+            continue;
+        }
+        for( const auto& interval : store.intervals( conId ) )
+        {
+            auto decoded = DecodedSeries();
+            if( store.load( conId, interval, decoded ) && decoded.rows() > 0 )
+            {
+                found.push_back( Series { to_string( conId ) + " " + interval, decoded.kind, move( decoded.columns ) } );
+            }
+        }
+    }
+    closedir( dir );
+    return found;
+}
+
+/// Reads the raw columns back from a file whose pages were dropped from the page cache
+double rawReadSeconds( const Series& s )
+{
+    char path[] = "/tmp/SeriesCodecBenchXXXXXX";
+    int  fd = mkstemp( path );
+    if( fd < 0 )
+    {
+        return 0;
+    }
+    unlink( path );
+    for( const auto& column : s.columns )
+    {
+        if( write( fd, column.data(), column.size() * sizeof( int64_t ) ) < 0 )
+        {
+            close( fd );
+            return 0;
+        }
+    }
+    fsync( fd );
+    posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+    auto buffer = vector<int64_t>( s.rows() );
+    auto start = chrono::steady_clock::now();
+    lseek( fd, 0, SEEK_SET );
+    for( size_t c = 0; c < s.columns.size(); c++ )
+    {
+        if( read( fd, buffer.data(), buffer.size() * sizeof( int64_t ) ) < 0 )
+        {
+            break;
+        }
+    }
+    auto seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    close( fd );
+    return seconds;
+}
+
+void bench( const Series& s )
+{
+    const auto& types = SeriesSchema::get( s.kind ).types;
+    auto        columns = vector<const int64_t*>();
+    for( const auto& column : s.columns )
+    {
+        columns.push_back( column.data() );
+    }
+    auto rawBytes = (double)( s.rows() * s.columns.size() * sizeof( int64_t ) );
+    auto blocks = vector<BlockInfo>();
+
+    auto start = chrono::steady_clock::now();
+    auto encoded = SeriesCodec::encode( types, columns, s.rows(), blocks );
+    auto encodeSeconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+
+    auto   decoded = DecodedSeries();
+    size_t runs = 0;
+    start = chrono::steady_clock::now();
+    double decodeSeconds = 0;
+    while( decodeSeconds < MIN_BENCH_SECONDS )
+    {
+        if( !SeriesCodec::decode( types, encoded.data(), blocks, decoded ) )
+        {
+            fprintf( stderr, "%s: decode failed\n", s.name.c_str() );
+            return;
+        }
+        runs++;
+        decodeSeconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    }
+    decodeSeconds /= (double)runs;
+    if( decoded.columns != s.columns )
+    {
+        fprintf( stderr, "%s: decoded rows differ from the input\n", s.name.c_str() );
+        return;
+    }
+    auto readSeconds = rawReadSeconds( s );
+    // bytes per value of each column, the time column is always encoded so measure the others against it
+    auto   timeOnly = SeriesCodec::encode( { types[0] }, { columns[0] }, s.rows(), blocks ).size();
+    string perColumn;
+    for( size_t c = 0; c < types.size(); c++ )
+    {
+        auto size = timeOnly;
+        if( c > 0 )
+        {
+            size = SeriesCodec::encode( { types[0], types[c] }, { columns[0], columns[c] }, s.rows(), blocks ).size() - timeOnly;
+        }
+        char buf[32];
+        snprintf( buf, sizeof( buf ), " %.2f", (double)size / (double)s.rows() );
+        perColumn += buf;
+    }
+    printf( "%-28s %10zu rows %8.2f ratio %9.1f MB/s encode %9.1f MB/s decode %9.1f MB/s raw read | bytes/value%s\n",
+            s.name.c_str(), s.rows(), rawBytes / (double)encoded.size(), rawBytes / encodeSeconds / 1e6,
+            rawBytes / decodeSeconds / 1e6, readSeconds > 0 ? rawBytes / readSeconds / 1e6 : 0.0, perColumn.c_str() );
+}
+
+/// Compression ratio and decode throughput of the history codec.
+/// With a history store root as argument every harvested series in it is measured,
+/// otherwise synthetic candle and snap streams are generated.
+int main( int argc, char* argv[] )
+{
+    auto series = vector<Series>();
+    if( argc > 1 )
+    {
+        series = harvested( argv[1] );
+    }
+    else
+    {
+        series.push_back( candles() );
+        series.push_back( snaps() );
+    }
+    for( const auto& s : series )
+    {
+        bench( s );
+    }
+    return 0;
+}
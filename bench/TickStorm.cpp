@@ -0,0 +1,317 @@
+#include "ClientBrain.h"
+#include "ClientData.h"
+#include "HalvedPositionSMA.h"
+#include "SMA.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/// Offered tick rates, per second, stepped through when none are given
+constexpr double DEFAULT_RATES[] = { 1e5, 2.5e5, 5e5, 1e6, 2e6, 4e6 };
+constexpr size_t DEFAULT_SYMBOLS = 500;
+constexpr double DEFAULT_SECONDS = 5;
+/// Weights of bid, ask, last and option computation ticks
+constexpr const char* DEFAULT_MIX = "3:3:2:2";
+/// The producer paces itself in slices of this many microseconds
+constexpr int SLICE_US = 1000;
+/// One tick in this many has its latency recorded
+constexpr size_t LATENCY_SAMPLE = 16;
+/// First vector id of the stock lines, the option lines follow them
+constexpr long FIRST_LINE = 1000;
+/// SMA lengths of the Trader
+constexpr int FAST_SMA = 50;
+constexpr int SLOW_SMA = 250;
+
+bool inter = false;
+
+enum class StormKind
+{
+    Price,
+    Size,
+    Option
+};
+
+/// One generated tick, stamped when the producer queued it
+struct StormTick
+{
+    int64_t   queued;
+    long      id;
+    StormKind kind;
+    int       field;
+    double    value;
+};
+
+/// Stands in for the EReader message queue: the producer appends under the
+/// lock and the consumer takes everything queued so far in one swap
+struct StormQueue
+{
+    mutex             lock;
+    vector<StormTick> ticks;
+};
+
+struct StepResult
+{
+    double          offered;
+    size_t          produced;
+    size_t          consumed;
+    /// Ticks still queued when the producer stopped
+    size_t          backlog;
+    double          seconds;
+    size_t          maxDepth;
+    double          meanDepth;
+    vector<int64_t> latencies;
+    long            rssGrowth;
+};
+
+int64_t nowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+/// Resident set size in kB
+long rssKb()
+{
+    long  pages = 0;
+    long  resident = 0;
+    FILE* statm = fopen( "/proc/self/statm", "r" );
+    if( statm != nullptr )
+    {
+        if( fscanf( statm, "%ld %ld", &pages, &resident ) != 2 )
+        {
+            resident = 0;
+        }
+        fclose( statm );
+    }
+    return resident * ( sysconf( _SC_PAGESIZE ) / 1024 );
+}
+
+/// Generates ticks at the offered rate until the time is up
+void produce( StormQueue& queue, double rate, double seconds, size_t symbols, const vector<int>& mix,
+              atomic<size_t>& produced, atomic<bool>& done )
+{
+    mt19937_64 rng( 42 );
+    auto       price = vector<double>( symbols, 100.0 );
+    auto       weights = discrete_distribution<int>( mix.begin(), mix.end() );
+    auto       batch = vector<StormTick>();
+    auto       start = chrono::steady_clock::now();
+    size_t     sent = 0;
+    for( ;; )
+    {
+        auto elapsed = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+        if( elapsed >= seconds )
+        {
+            break;
+        }
+        // catch up to where the rate says we should be, a slow consumer never slows the producer
+        auto due = (size_t)( elapsed * rate );
+        auto stamp = nowNs();
+        batch.clear();
+        while( sent < due )
+        {
+            auto i = rng() % symbols;
+            auto kind = weights( rng );
+            if( kind == 3 )
+            {
+                // bid, ask and last option computations in turn
+                batch.push_back( StormTick { stamp, FIRST_LINE + (long)( symbols + i ), StormKind::Option,
+                                             10 + (int)( sent % 3 ), price[i] * 0.05 } );
+                sent++;
+                continue;
+            }
+            static const int priceFields[] = { 1, 2, 4 };
+            static const int sizeFields[] = { 0, 3, 5 };
+            price[i] += ( (double)( rng() % 3 ) - 1 ) * 0.01;
+            batch.push_back( StormTick { stamp, FIRST_LINE + (long)i, StormKind::Price, priceFields[kind], price[i] } );
+            batch.push_back(
+                StormTick { stamp, FIRST_LINE + (long)i, StormKind::Size, sizeFields[kind], (double)( 1 + rng() % 50 ) } );
+            sent += 2;
+        }
+        if( !batch.empty() )
+        {
+            lock_guard<mutex> guard( queue.lock );
+            queue.ticks.insert( queue.ticks.end(), batch.begin(), batch.end() );
+        }
+        produced.store( sent, memory_order_relaxed );
+        this_thread::sleep_for( chrono::microseconds( SLICE_US ) );
+    }
+    done.store( true );
+}
+
+/// Runs one rate step: a producer thread offers ticks while this thread drains them
+/// through the ClientBrain callbacks, the way processMsgs would
+StepResult storm( EWrapper& wrapper, ClientData& data, double rate, double seconds, size_t symbols,
+                  const vector<int>& mix )
+{
+    auto result = StepResult();
+    result.offered = rate;
+    result.maxDepth = 0;
+    result.backlog = 0;
+    result.latencies.reserve( (size_t)( rate * seconds ) / LATENCY_SAMPLE + 1 );
+    auto           queue = StormQueue();
+    auto           taken = vector<StormTick>();
+    atomic<size_t> produced( 0 );
+    atomic<bool>   done( false );
+    size_t         consumed = 0;
+    size_t         drains = 0;
+    bool           stopped = false;
+    double         depthSum = 0;
+    auto           rss = rssKb();
+    auto           start = chrono::steady_clock::now();
+    auto           producer = thread( produce, ref( queue ), rate, seconds, symbols, cref( mix ), ref( produced ), ref( done ) );
+    for( ;; )
+    {
+        bool finished = done.load();
+        if( finished && !stopped )
+        {
+            stopped = true;
+            result.backlog = max( produced.load(), consumed ) - consumed;
+        }
+        {
+            lock_guard<mutex> guard( queue.lock );
+            taken.swap( queue.ticks );
+        }
+        if( taken.empty() )
+        {
+            if( finished )
+            {
+                break;
+            }
+            this_thread::yield();
+            continue;
+        }
+        result.maxDepth = max( result.maxDepth, taken.size() );
+        depthSum += (double)taken.size();
+        drains++;
+        for( const auto& tick : taken )
+        {
+            switch( tick.kind )
+            {
+                case StormKind::Price:
+                    wrapper.tickPrice( tick.id, (TickType)tick.field, tick.value, TickAttrib() );
+                    break;
+                case StormKind::Size:
+                    wrapper.tickSize( tick.id, (TickType)tick.field, (int)tick.value );
+                    break;
+                case StormKind::Option:
+                    wrapper.tickOptionComputation( tick.id, (TickType)tick.field, 0.25, 0.5, tick.value, 0, 0.05,
+                                                   0.1, -0.02, 0 );
+                    break;
+            }
+            if( consumed++ % LATENCY_SAMPLE == 0 )
+            {
+                result.latencies.push_back( nowNs() - tick.queued );
+            }
+        }
+        // what DATA_NEXT does once per pass of the main loop
+        data.updated();
+        taken.clear();
+    }
+    producer.join();
+    result.seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    result.produced = produced.load();
+    result.consumed = consumed;
+    result.meanDepth = drains > 0 ? depthSum / (double)drains : 0;
+    result.rssGrowth = rssKb() - rss;
+    return result;
+}
+
+double percentile( vector<int64_t>& values, double p )
+{
+    if( values.empty() )
+    {
+        return 0;
+    }
+    auto n = (size_t)( p * (double)( values.size() - 1 ) );
+    nth_element( values.begin(), values.begin() + (long)n, values.end() );
+    return (double)values[n] / 1000.0;
+}
+
+vector<int> parseMix( const string& text )
+{
+    auto out = vector<int>();
+    auto fields = istringstream( text );
+    for( string field; getline( fields, field, ':' ); )
+    {
+        out.push_back( max( 0, atoi( field.c_str() ) ) );
+    }
+    if( out.size() != 4 || ( out[0] + out[1] + out[2] + out[3] ) == 0 )
+    {
+        spdlog::critical( "Could not read the mix " + text + ", expected bid:ask:last:greeks weights" );
+        out.clear();
+    }
+    return out;
+}
+
+/// Usage: TickStorm [symbols] [seconds per step] [bid:ask:last:greeks] [rates...]
+///
+/// Offers each tick rate to the ingest path in turn and reports what it kept
+/// up with. The saturation point is the first rate where the consumed rate
+/// falls behind the offered one and the queue depth and latency run away.
+int main( int argc, char* argv[] )
+{
+    spdlog::set_level( spdlog::level::warn );
+    size_t symbols = argc > 1 ? strtoul( argv[1], nullptr, 10 ) : DEFAULT_SYMBOLS;
+    double seconds = argc > 2 ? atof( argv[2] ) : DEFAULT_SECONDS;
+    auto   mix = parseMix( argc > 3 ? argv[3] : DEFAULT_MIX );
+    auto   rates = vector<double>();
+    for( int i = 4; i < argc; i++ )
+    {
+        rates.push_back( atof( argv[i] ) );
+    }
+    if( rates.empty() )
+    {
+        rates.assign( begin( DEFAULT_RATES ), end( DEFAULT_RATES ) );
+    }
+    if( symbols == 0 || seconds <= 0 || mix.empty() )
+    {
+        return 1;
+    }
+
+    auto fast = make_unique<SMA>( FAST_SMA );
+    auto slow = make_unique<SMA>( SLOW_SMA );
+    auto indicators = vector<BTIndicator*> { fast.get(), slow.get() };
+    auto Data = make_shared<ClientData>( indicators );
+    for( size_t i = 0; i < symbols; i++ )
+    {
+        auto con = Contract();
+        con.conId = (long)( 100000 + i );
+        con.symbol = "SYM" + to_string( i );
+        con.secType = "STK";
+        con.exchange = "SMART";
+        con.currency = "USD";
+        Data->openLine( con, FIRST_LINE + (long)i );
+        con.conId += (long)symbols;
+        con.secType = "OPT";
+        con.lastTradeDateOrContractMonth = "20301220";
+        con.strike = 100;
+        con.right = "C";
+        Data->openLine( con, FIRST_LINE + (long)( symbols + i ) );
+    }
+    auto      brain = ClientBrain( Data, make_shared<HPSMA>() );
+    EWrapper& wrapper = brain;
+
+    printf( "%zu symbols, %.1f s per step, mix %s\n", symbols, seconds, argc > 3 ? argv[3] : DEFAULT_MIX );
+    printf( "%12s %12s %10s %10s %10s %10s %10s %10s %10s\n", "offered/s", "consumed/s", "backlog", "max depth",
+            "mean depth", "p50 us", "p99 us", "p99.9 us", "rss +MB" );
+    for( auto rate : rates )
+    {
+        auto r = storm( wrapper, *Data, rate, seconds, symbols, mix );
+        printf( "%12.0f %12.0f %10zu %10zu %10.0f %10.1f %10.1f %10.1f %10.1f\n", r.offered,
+                (double)r.consumed / r.seconds, r.backlog, r.maxDepth, r.meanDepth,
+                percentile( r.latencies, 0.5 ), percentile( r.latencies, 0.99 ),
+                percentile( r.latencies, 0.999 ), (double)r.rssGrowth / 1024.0 );
+        fflush( stdout );
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "TimeParser.h"
+#include "TimeStamp.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// Bar times parsed by every benchmark unless a count is given
+constexpr size_t BENCH_TIMES = 1000000;
+/// Length of the synthetic bars, in seconds
+constexpr int BAR_SECONDS = 5;
+
+/// Every allocation made by the process
+atomic<size_t> allocations( 0 );
+
+void* operator new( size_t size )
+{
+    allocations.fetch_add( 1, memory_order_relaxed );
+    if( void* p = malloc( size == 0 ? 1 : size ) )
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete( void* p ) noexcept { free( p ); }
+
+void operator delete( void* p, size_t ) noexcept { free( p ); }
+
+/// The parse HistoryStore::barTime did before TimeParser
+int64_t legacyBarTime( const string& text )
+{
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    if( text.size() != 8 && text.find( ' ' ) == string::npos )
+    {
+        return strtoll( text.c_str(), nullptr, 10 ) * 1000000000;
+    }
+    if( sscanf( text.c_str(), "%4d%2d%2d %d:%d:%d", &year, &month, &day, &hour, &minute, &second ) < 3 )
+    {
+        return 0;
+    }
+    struct tm parts
+    {
+    };
+    parts.tm_year = year - 1900;
+    parts.tm_mon = month - 1;
+    parts.tm_mday = day;
+    parts.tm_hour = hour;
+    parts.tm_min = minute;
+    parts.tm_sec = second;
+    parts.tm_isdst = -1;
+    return (int64_t)mktime( &parts ) * 1000000000;
+}
+
+/// Consecutive bar times in the IB format, spread over as many days as they need.
+/// With a zero step every time gets a day of its own
+vector<string> barTimes( size_t count, int step, const char* separator )
+{
+    auto   out = vector<string>( count );
+    time_t start = 1600000000;
+    char   buf[32];
+    for( size_t i = 0; i < count; i++ )
+    {
+        time_t t = step > 0 ? start + (time_t)i * step : start + (time_t)i * 86400 + (time_t)( i % 86400 );
+        struct tm parts
+        {
+        };
+        localtime_r( &t, &parts );
+        strftime( buf, sizeof( buf ), separator[0] == ' ' && separator[1] == ' ' ? "%Y%m%d  %H:%M:%S" : "%Y%m%d %H:%M:%S",
+                  &parts );
+        out[i] = buf;
+    }
+    return out;
+}
+
+/// Times a parse over every string, printing ns and allocations per time
+template <typename Parse>
+int64_t measure( const char* name, const vector<string>& times, Parse parse )
+{
+    int64_t sum = 0;
+    auto    before = allocations.load();
+    auto    start = chrono::steady_clock::now();
+    for( const auto& text : times )
+    {
+        sum += parse( text );
+    }
+    auto seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+    printf( "%-36s %10.1f ns/time %8.2f allocs/time\n", name, seconds * 1e9 / (double)times.size(),
+            (double)( allocations.load() - before ) / (double)times.size() );
+    return sum;
+}
+
+/// Checks that TimeParser agrees with the legacy parse on every time
+void compare( const char* name, const vector<string>& times )
+{
+    auto   parser = TimeParser();
+    size_t wrong = 0;
+    for( const auto& text : times )
+    {
+        wrong += parser.parse( text ) != legacyBarTime( text );
+    }
+    printf( "%-36s %zu of %zu times differ from the legacy parse\n", name, wrong, times.size() );
+}
+
+/// Legacy, TimeStamp and TimeParser bar time parsing: ns and allocations per time
+int main( int argc, char* argv[] )
+{
+    auto count = argc > 1 ? strtoul( argv[1], nullptr, 10 ) : BENCH_TIMES;
+    auto bars = barTimes( count, BAR_SECONDS, " " );
+    auto executions = barTimes( count, BAR_SECONDS, "  " );
+    auto scattered = barTimes( count, 0, " " );
+    volatile int64_t sink = 0;
+
+    sink += measure( "sscanf + mktime", bars, legacyBarTime );
+    sink += measure( "TimeStamp( bar.time )", bars, []( const string& text ) {
+        auto stamp = TimeStamp( text );
+        return (int64_t)sizeof( stamp );
+    } );
+    auto parser = TimeParser();
+    sink += measure( "TimeParser, 5 sec bars", bars, [&parser]( const string& text ) { return parser.parse( text ); } );
+    sink += measure( "TimeParser, execution times", executions,
+                     [&parser]( const string& text ) { return parser.parse( text ); } );
+    sink += measure( "TimeParser, a new date every time", scattered,
+                     [&parser]( const string& text ) { return parser.parse( text ); } );
+    compare( "5 sec bars", bars );
+    compare( "a new date every time", scattered );
+    return 0;
+}